@@ -0,0 +1,125 @@
+#include "codec.h"
+#include "timing.h"
+
+#include <stdio.h>   // printf(...)
+#include <math.h>    // sin(...), log10(...)
+#include <stdlib.h>  // malloc(...), free(...)
+#include <string.h>
+
+#define SAMPLE_RATE 48000
+#define CHANNELS 2
+#define FRAMES_PER_PACKET 480  // 10ms
+#define PACKETS 20000          // 200s of audio
+#define PI 3.14159265358979323846
+
+// Encode then decode PACKETS frames of a two tone test signal with `codec`,
+// reporting throughput relative to real time and the reconstruction SNR.
+void bench_codec(const codec_t *codec, const int16_t *pcm) {
+    uint32_t packet_samples = FRAMES_PER_PACKET * CHANNELS;
+    uint32_t encoded_size = codec->encoded_size(FRAMES_PER_PACKET, CHANNELS);
+    uint8_t *encoded = malloc((uint64_t) encoded_size * PACKETS);
+    int16_t *decoded = malloc(sizeof(int16_t) * packet_samples * PACKETS);
+    codec_state enc_state;
+    codec_state dec_state;
+
+    sc_codec_state_init(&enc_state);
+    sc_codec_state_init(&dec_state);
+
+    uint64_t start = sc_time_now_ns();
+    for (uint32_t i = 0; i < PACKETS; i++) {
+        codec->encode(&enc_state, pcm + i * packet_samples, FRAMES_PER_PACKET, CHANNELS,
+            encoded + i * encoded_size);
+    }
+    uint64_t encode_ns = sc_time_now_ns() - start;
+
+    start = sc_time_now_ns();
+    for (uint32_t i = 0; i < PACKETS; i++) {
+        codec->decode(&dec_state, encoded + i * encoded_size, encoded_size, CHANNELS,
+            decoded + i * packet_samples);
+    }
+    uint64_t decode_ns = sc_time_now_ns() - start;
+
+    double signal = 0;
+    double noise = 0;
+    for (uint64_t i = 0; i < (uint64_t) packet_samples * PACKETS; i++) {
+        double diff = (double) pcm[i] - decoded[i];
+        signal += (double) pcm[i] * pcm[i];
+        noise += diff * diff;
+    }
+
+    double audio_ns = (double) PACKETS * FRAMES_PER_PACKET * NS_PER_SEC / SAMPLE_RATE;
+    double pcm_kbps = (double) SAMPLE_RATE * CHANNELS * 16 / 1000;
+    double kbps = (double) encoded_size * 8 * SAMPLE_RATE / FRAMES_PER_PACKET / 1000;
+    printf("{\"codec\": \"%s\", \"kbps\": %.1f, \"ratio\": %.2f, \"encode_x_realtime\": %.0f, "
+        "\"decode_x_realtime\": %.0f, \"encode_core_pct\": %.3f, \"decode_core_pct\": %.3f, \"snr_db\": %.1f}\n",
+        codec->name, kbps, pcm_kbps / kbps, audio_ns / encode_ns, audio_ns / decode_ns,
+        100.0 * encode_ns / audio_ns, 100.0 * decode_ns / audio_ns,
+        noise > 0 ? 10 * log10(signal / noise) : INFINITY);
+
+    free(encoded);
+    free(decoded);
+}
+
+// Malformed frames a decoder must reject or decode within bounds, as they can arrive from
+// the network. Each entry is one frame of CHANNELS channels.
+typedef struct {
+    const char *name;
+    uint8_t     bytes[16];
+    uint32_t    len;
+} malformed_frame;
+
+static const malformed_frame malformed[] = {
+    // Channel headers only, pad bit set: no nibble to drop
+    { "adpcm_padded_header_only", { 0, 0, 0, 1, 0, 0, 0, 0 }, 8 },
+    { "adpcm_short_header", { 0, 0, 0, 0, 0, 0 }, 6 },
+    { "empty", { 0 }, 0 }
+};
+
+#define GUARD_SAMPLES 64
+#define GUARD_VALUE 0x5A5A
+
+// Decode every malformed frame with `codec`, checking the decoder writes no more frames
+// than the input could hold and nothing past them.
+void check_malformed(const codec_t *codec) {
+    int16_t pcm[FRAMES_PER_PACKET * CHANNELS + GUARD_SAMPLES];
+    uint32_t passed = 0;
+    uint32_t count = sizeof(malformed) / sizeof(malformed[0]);
+
+    for (uint32_t i = 0; i < count; i++) {
+        codec_state state;
+        sc_codec_state_init(&state);
+        for (uint32_t j = 0; j < sizeof(pcm) / sizeof(pcm[0]); j++) {
+            pcm[j] = (int16_t) GUARD_VALUE;
+        }
+        uint32_t frames = codec->decode(&state, malformed[i].bytes, malformed[i].len, CHANNELS, pcm);
+        uint8_t ok = frames <= malformed[i].len * 2 / CHANNELS + 1;
+        for (uint32_t j = frames * CHANNELS; j < sizeof(pcm) / sizeof(pcm[0]); j++) {
+            ok = ok && pcm[j] == (int16_t) GUARD_VALUE;
+        }
+        if (ok) {
+            passed++;
+        } else {
+            printf("{\"codec\": \"%s\", \"malformed\": \"%s\", \"frames\": %u, \"ok\": false}\n",
+                codec->name, malformed[i].name, frames);
+        }
+    }
+    printf("{\"codec\": \"%s\", \"malformed_passed\": %u, \"malformed_total\": %u}\n", codec->name,
+        passed, count);
+}
+
+int main(void) {
+    uint64_t samples = (uint64_t) FRAMES_PER_PACKET * CHANNELS * PACKETS;
+    int16_t *pcm = malloc(sizeof(int16_t) * samples);
+
+    for (uint64_t i = 0; i < samples / CHANNELS; i++) {
+        double t = (double) i / SAMPLE_RATE;
+        pcm[i * CHANNELS] = (int16_t) (12000 * sin(2 * PI * 440 * t) + 4000 * sin(2 * PI * 3000 * t));
+        pcm[i * CHANNELS + 1] = (int16_t) (10000 * sin(2 * PI * 660 * t));
+    }
+
+    bench_codec(sc_codec_get(CODEC_PCM_S16), pcm);
+    bench_codec(sc_codec_get(CODEC_IMA_ADPCM), pcm);
+    check_malformed(sc_codec_get(CODEC_PCM_S16));
+    check_malformed(sc_codec_get(CODEC_IMA_ADPCM));
+    free(pcm);
+}
@@ -0,0 +1,116 @@
+#include "dsp.h"
+#include "timing.h"
+
+#include <stdio.h>   // printf(...)
+#include <stdlib.h>  // malloc(...), free(...), rand(...)
+#include <string.h>  // memcmp(...), memcpy(...)
+
+#define SAMPLES (48000 * 2)  // 1s of 48 kHz stereo
+#define ROUNDS 200
+
+static const char *isa_names[] = { "scalar", "sse2", "avx2", "neon" };
+
+typedef struct {
+    float   *f32_in;
+    float   *f32_mix;
+    int16_t *s16_in;
+    uint8_t *s24_in;
+    // Outputs, compared byte for byte against the scalar reference
+    float   *f32_out;
+    int16_t *s16_out;
+    uint8_t *s24_out;
+    float   *left;
+    float   *right;
+    float   *stereo_out;
+} buffers;
+
+// Run every kernel once over the inputs, writing all outputs
+void run_kernels(buffers *b) {
+    float *channels[2] = { b->left, b->right };
+    const float *const_channels[2] = { b->left, b->right };
+
+    sc_dsp_s16_to_f32(b->s16_in, b->f32_out, SAMPLES);
+    sc_dsp_f32_to_s16(b->f32_in, b->s16_out, SAMPLES);
+    sc_dsp_s24_to_f32(b->s24_in, b->f32_out + SAMPLES, SAMPLES);
+    sc_dsp_f32_to_s24(b->f32_in, b->s24_out, SAMPLES);
+    sc_dsp_deinterleave_f32(b->f32_in, channels, 2, SAMPLES / 2);
+    sc_dsp_gain_f32(b->left, 0.7f, SAMPLES / 2);
+    sc_dsp_mix_f32(b->right, b->f32_mix, 0.35f, SAMPLES / 2);
+    sc_dsp_interleave_f32(const_channels, b->stereo_out, 2, SAMPLES / 2);
+}
+
+// Time `call` over ROUNDS runs, storing nanoseconds per sample in `result`
+#define TIME_KERNEL(result, call) { \
+    uint64_t start = sc_time_now_ns(); \
+    for (uint32_t r = 0; r < ROUNDS; r++) { call; } \
+    result = (double) (sc_time_now_ns() - start) / ROUNDS / SAMPLES; \
+}
+
+int main(void) {
+    buffers ref;
+    buffers out;
+    buffers *all[2] = { &ref, &out };
+    uint8_t all_exact = true;
+
+    for (int i = 0; i < 2; i++) {
+        all[i]->f32_out = malloc(sizeof(float) * SAMPLES * 2);
+        all[i]->s16_out = malloc(sizeof(int16_t) * SAMPLES);
+        all[i]->s24_out = malloc(3 * SAMPLES);
+        all[i]->left = malloc(sizeof(float) * SAMPLES / 2);
+        all[i]->right = malloc(sizeof(float) * SAMPLES / 2);
+        all[i]->stereo_out = malloc(sizeof(float) * SAMPLES);
+    }
+    ref.f32_in = malloc(sizeof(float) * SAMPLES);
+    ref.f32_mix = malloc(sizeof(float) * SAMPLES / 2);
+    ref.s16_in = malloc(sizeof(int16_t) * SAMPLES);
+    ref.s24_in = malloc(3 * SAMPLES);
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        // Slightly beyond full scale to exercise clipping. Every 97th sample is an exact
+        // rounding tie once scaled to 16 bit (n + 0.5) to exercise ties to even.
+        if (i % 97 == 0) {
+            ref.f32_in[i] = ((float) (i % 1000) + 0.5f) / 32768.0f;
+        } else {
+            ref.f32_in[i] = ((float) rand() / RAND_MAX) * 2.4f - 1.2f;
+        }
+        ref.s16_in[i] = (int16_t) rand();
+        ref.s24_in[3 * i] = (uint8_t) rand();
+        ref.s24_in[3 * i + 1] = (uint8_t) rand();
+        ref.s24_in[3 * i + 2] = (uint8_t) rand();
+    }
+    for (uint32_t i = 0; i < SAMPLES / 2; i++) {
+        ref.f32_mix[i] = ((float) rand() / RAND_MAX) * 2.0f - 1.0f;
+    }
+    out.f32_in = ref.f32_in;
+    out.f32_mix = ref.f32_mix;
+    out.s16_in = ref.s16_in;
+    out.s24_in = ref.s24_in;
+
+    sc_dsp_set_isa(DSP_ISA_SCALAR);
+    run_kernels(&ref);
+
+    for (int isa = DSP_ISA_SCALAR; isa <= DSP_ISA_NEON; isa++) {
+        if (!sc_dsp_set_isa((dsp_isa) isa)) {
+            continue;
+        }
+        run_kernels(&out);
+        uint8_t exact = memcmp(ref.f32_out, out.f32_out, sizeof(float) * SAMPLES * 2) == 0
+            && memcmp(ref.s16_out, out.s16_out, sizeof(int16_t) * SAMPLES) == 0
+            && memcmp(ref.s24_out, out.s24_out, 3 * SAMPLES) == 0
+            && memcmp(ref.left, out.left, sizeof(float) * SAMPLES / 2) == 0
+            && memcmp(ref.right, out.right, sizeof(float) * SAMPLES / 2) == 0
+            && memcmp(ref.stereo_out, out.stereo_out, sizeof(float) * SAMPLES) == 0;
+        all_exact &= exact;
+
+        float *channels[2] = { out.left, out.right };
+        double s16_to_f32, f32_to_s16, deinterleave, gain, mix;
+        TIME_KERNEL(s16_to_f32, sc_dsp_s16_to_f32(out.s16_in, out.f32_out, SAMPLES));
+        TIME_KERNEL(f32_to_s16, sc_dsp_f32_to_s16(out.f32_in, out.s16_out, SAMPLES));
+        TIME_KERNEL(deinterleave, sc_dsp_deinterleave_f32(out.f32_in, channels, 2, SAMPLES / 2));
+        TIME_KERNEL(gain, sc_dsp_gain_f32(out.f32_out, 1.0f, SAMPLES));
+        TIME_KERNEL(mix, sc_dsp_mix_f32(out.f32_out, out.f32_in, 0.5f, SAMPLES));
+        printf("{\"isa\": \"%s\", \"bit_exact\": %s, \"ns_per_sample\": {\"s16_to_f32\": %.3f, "
+            "\"f32_to_s16\": %.3f, \"deinterleave\": %.3f, \"gain\": %.3f, \"mix\": %.3f}}\n",
+            isa_names[isa], exact ? "true" : "false", s16_to_f32, f32_to_s16, deinterleave, gain, mix);
+    }
+    return all_exact ? 0 : 1;
+}
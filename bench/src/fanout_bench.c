@@ -0,0 +1,104 @@
+#define _GNU_SOURCE  // clock_gettime(...), CLOCK_THREAD_CPUTIME_ID
+
+#include "fanout.h"
+#include "networking.h"
+#include "timing.h"
+
+#include <stdio.h>       // printf(...)
+#include <string.h>      // memset(...)
+#include <time.h>        // clock_gettime(...)
+#include <unistd.h>      // close(...)
+#include <arpa/inet.h>   // htonl(...), ntohs(...)
+#include <sys/socket.h>
+
+#define BENCH_GROUP "239.255.77.1"
+#define BATCH 8                  // Datagrams per send, as a packetizer emits for one frame
+#define COPIES_PER_RUN 200000    // Datagram copies timed per configuration
+#define STREAM_PACKETS_PER_SEC 131.0  // 48 kHz stereo 16-bit PCM in full size datagrams
+
+static const uint32_t subscriber_counts[] = { 1, 16, 128, 512 };
+static const char *mode_names[] = { "sendto", "sendmmsg", "sendmmsg_gso" };
+
+uint64_t thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * NS_PER_SEC + (uint64_t) ts.tv_nsec;
+}
+
+// Baseline: one sendto per datagram per subscriber
+void send_naive(fanout_t *fanout, int32_t fd, datagram_t **dgrams, uint32_t *lens) {
+    for (uint32_t s = 0; s < fanout->count; s++) {
+        for (uint32_t i = 0; i < BATCH; i++) {
+            sendto(fd, dgrams[i], lens[i], 0, (struct sockaddr *) &fanout->subscribers[s].addr,
+                sizeof(struct sockaddr_in));
+        }
+    }
+}
+
+int main(void) {
+    static fanout_t fanout;
+    static int32_t receivers[512];
+    datagram_t dgrams[BATCH];
+    datagram_t request;
+    datagram_t *dgram_ptrs[BATCH];
+    uint32_t lens[BATCH];
+
+    int32_t fd = socket(AF_INET, SOCK_DGRAM, 0);
+    for (uint32_t i = 0; i < BATCH; i++) {
+        memset(&dgrams[i], 0, sizeof(datagram_t));
+        dgrams[i].header.kind = SERVER_AUDIO;
+        dgrams[i].header.sequence = i;
+        dgram_ptrs[i] = &dgrams[i];
+        lens[i] = DATAGRAM_MAX_SIZE;
+    }
+
+    for (uint32_t c = 0; c < sizeof(subscriber_counts) / sizeof(uint32_t); c++) {
+        uint32_t count = subscriber_counts[c];
+        uint32_t rounds = COPIES_PER_RUN / (BATCH * count);
+        rounds = rounds ? rounds : 1;
+
+        for (uint32_t mode = 0; mode < 3; mode++) {
+            // Subscribers are real loopback sockets that are never read: the kernel does
+            // all the per-receiver work, then drops once their buffers fill. Each subscribes
+            // as a client would, through a CLIENT_SUBSCRIBE from its own address.
+            sc_fanout_init(&fanout, 3600 * NS_PER_SEC);
+            fanout.gso_enabled = mode == 2;
+            for (uint32_t s = 0; s < count; s++) {
+                struct sockaddr_in addr;
+                socklen_t addr_len = sizeof(struct sockaddr_in);
+                memset(&addr, 0, sizeof(struct sockaddr_in));
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                receivers[s] = socket(AF_INET, SOCK_DGRAM, 0);
+                bind(receivers[s], (struct sockaddr *) &addr, addr_len);
+                getsockname(receivers[s], (struct sockaddr *) &addr, &addr_len);
+                sc_fanout_build_request(&request, CLIENT_SUBSCRIBE, BENCH_GROUP, ntohs(addr.sin_port));
+                sc_fanout_handle_request(&fanout, &request, &addr, sc_time_now_ns());
+            }
+            fanout.last_expire_ns = sc_time_now_ns();
+
+            uint64_t start = thread_cpu_ns();
+            for (uint32_t r = 0; r < rounds; r++) {
+                if (mode == 0) {
+                    send_naive(&fanout, fd, dgram_ptrs, lens);
+                } else {
+                    sc_fanout_send(&fanout, fd, dgram_ptrs, lens, BATCH);
+                }
+            }
+            double ns_per_copy = (double) (thread_cpu_ns() - start) / ((double) rounds * BATCH * count);
+
+            printf("{\"mode\": \"%s\", \"subscribers\": %u, \"cpu_ns_per_packet_copy\": %.0f, "
+                "\"core_pct_per_subscriber\": %.4f, \"gso_active\": %s}\n",
+                mode_names[mode], count, ns_per_copy,
+                ns_per_copy * STREAM_PACKETS_PER_SEC / NS_PER_SEC * 100.0,
+                mode == 2 && fanout.gso_enabled ? "true" : "false");
+
+            for (uint32_t s = 0; s < count; s++) {
+                close(receivers[s]);
+            }
+            sc_fanout_destroy(&fanout);
+        }
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,252 @@
+#define _GNU_SOURCE  // clock_nanosleep(...), IP_MULTICAST_ALL
+
+#include "networking.h"
+#include "fanout.h"
+#include "pacing.h"
+#include "codec.h"
+#include "timing.h"
+
+#include <stdio.h>       // printf(...)
+#include <stdlib.h>      // malloc(...), free(...), qsort(...)
+#include <string.h>      // memset(...)
+#include <time.h>        // clock_nanosleep(...)
+#include <unistd.h>      // close(...), usleep(...)
+#include <pthread.h>
+#include <arpa/inet.h>   // inet_addr(...), htonl(...), ntohs(...)
+#include <sys/socket.h>
+
+#define BENCH_GROUP "239.255.77.1"
+#define RUN_NS (NS_PER_SEC / 2)
+#define DRAIN_USEC 100000
+#define CLIENTS_MAX 16
+#define RECEIVE_BATCH 32
+
+static const uint32_t payload_sizes[] = { 64, 512, DATAGRAM_PAYLOAD_MAX_SIZE };
+static const uint32_t packet_rates[] = { 1000, 10000, 50000 };
+static const uint32_t client_counts[] = { 1, 4, 16 };
+static const char *mode_names[] = { "multicast", "unicast" };
+
+// Bursty frames into a shallow receive queue, standing in for a cheap AP: each frame's
+// datagrams are sent back to back, or spread over the frame interval by the pacer
+#define SHALLOW_RCVBUF (16 * 1024)
+#define SHALLOW_PAYLOAD 1200
+#define SHALLOW_RATE 8000
+static const uint32_t frame_bursts[] = { 4, 16, 32 };
+
+#define COUNT_OF(array) (sizeof(array) / sizeof((array)[0]))
+
+typedef struct {
+    pthread_t    thread;
+    connection_t conn;
+    uint64_t    *latencies;     // One-way latency of each received datagram
+    uint64_t     capacity;
+    uint64_t     received;
+    uint64_t     bytes;
+    uint64_t     reordered;     // Arrived after a higher sequence
+    uint64_t     duplicates;
+    uint8_t     *seen;          // Per sequence, for loss and duplicate accounting
+    uint32_t     highest;
+    uint8_t      any;
+    uint8_t      running;
+} client;
+
+int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// Loopback receiver. Multicast receivers share the group port; unicast ones get their own.
+int32_t open_receiver(uint8_t multicast, int32_t rcvbuf, struct sockaddr_in *bound) {
+    int32_t fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int32_t one = 1;
+    int32_t zero = 0;
+    socklen_t addr_len = sizeof(struct sockaddr_in);
+    struct timeval wake = { 0, 20000 };
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(int32_t));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(int32_t));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wake, sizeof(struct timeval));
+    memset(bound, 0, sizeof(struct sockaddr_in));
+    bound->sin_family = AF_INET;
+    bound->sin_addr.s_addr = htonl(multicast ? INADDR_ANY : INADDR_LOOPBACK);
+    bound->sin_port = multicast ? htons(MULTICAST_TEMP_PORT) : 0;
+    bind(fd, (struct sockaddr *) bound, addr_len);
+    getsockname(fd, (struct sockaddr *) bound, &addr_len);
+    if (multicast) {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = inet_addr(BENCH_GROUP);
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(struct ip_mreq));
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_ALL, &zero, sizeof(int32_t));
+    }
+    return fd;
+}
+
+void *client_main(void *arg) {
+    client *c = (client *) arg;
+    static __thread datagram_t dgrams[RECEIVE_BATCH];
+    uint32_t lens[RECEIVE_BATCH];
+
+    while (__atomic_load_n(&c->running, __ATOMIC_ACQUIRE)) {
+        uint32_t count = sc_network_receive_batch(&c->conn, dgrams, lens, RECEIVE_BATCH, false);
+        uint64_t now = sc_time_now_ns();
+        for (uint32_t i = 0; i < count; i++) {
+            if (lens[i] == 0) {
+                continue;
+            }
+            uint32_t seq = dgrams[i].header.sequence;
+            if (seq >= c->capacity) {
+                continue;
+            }
+            if (c->seen[seq]) {
+                c->duplicates++;
+                continue;
+            }
+            c->seen[seq] = true;
+            if (c->any && seq < c->highest) {
+                c->reordered++;
+            } else {
+                c->highest = seq;
+                c->any = true;
+            }
+            c->latencies[c->received++] = now - dgrams[i].header.timestamp;
+            c->bytes += lens[i];
+        }
+    }
+    return NULL;
+}
+
+// Send `total` datagrams of `payload` bytes at `rate` per second on an absolute schedule,
+// `burst` at a time. Returns the elapsed nanoseconds.
+uint64_t run_sender(connection_t *conn, uint32_t payload, uint32_t rate, uint32_t burst, uint64_t total) {
+    datagram_t dgram;
+    uint64_t interval = NS_PER_SEC / rate;
+    uint64_t start = sc_time_now_ns();
+    struct timespec next;
+
+    memset(&dgram, 0, sizeof(datagram_t));
+    dgram.header.kind = SERVER_AUDIO;
+    for (uint64_t i = 0; i < total; i++) {
+        uint64_t due = start + i / burst * burst * interval;
+        if (i % burst == 0 && sc_time_now_ns() < due) {
+            next.tv_sec = due / NS_PER_SEC;
+            next.tv_nsec = due % NS_PER_SEC;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+        dgram.header.sequence = (uint32_t) i;
+        dgram.header.timestamp = sc_time_now_ns();
+        sc_network_send(conn, &dgram, sizeof(datagram_header) + payload);
+    }
+    return sc_time_now_ns() - start;
+}
+
+// `pacing` is a pacing_mode, or -1 to send each burst at once.
+void run_config(uint8_t multicast, uint32_t payload, uint32_t rate, uint32_t client_count,
+    uint32_t burst, int32_t pacing, int32_t rcvbuf) {
+    static client clients[CLIENTS_MAX];
+    static fanout_t fanout;
+    static pacer_t pacer;
+    connection_t server;
+    uint64_t total = (uint64_t) rate * RUN_NS / NS_PER_SEC;
+
+    sc_socket_channel_init(&server, BENCH_GROUP, CODEC_PCM_S16, AUDIO_DEFAULT_SAMPLE_RATE, AUDIO_DEFAULT_CHANNELS);
+    if (pacing >= 0) {
+        sc_pacer_init(&pacer, server.socket_audio_fd, (pacing_mode) pacing, NS_PER_SEC / rate);
+        server.pacer = &pacer;
+        pacing = pacer.mode;  // Report what the kernel allowed
+    }
+    if (!multicast) {
+        sc_fanout_init(&fanout, 3600 * NS_PER_SEC);
+        server.fanout = &fanout;
+    }
+    for (uint32_t i = 0; i < client_count; i++) {
+        client *c = &clients[i];
+        struct sockaddr_in bound;
+        memset(c, 0, sizeof(client));
+        c->conn.socket_audio_fd = open_receiver(multicast, rcvbuf, &bound);
+        c->capacity = total;
+        c->latencies = malloc(sizeof(uint64_t) * total);
+        c->seen = calloc(total, 1);
+        c->running = true;
+        if (!multicast) {
+            datagram_t request;
+            sc_fanout_build_request(&request, CLIENT_SUBSCRIBE, BENCH_GROUP, ntohs(bound.sin_port));
+            sc_fanout_handle_request(&fanout, &request, &bound, sc_time_now_ns());
+        }
+        pthread_create(&c->thread, NULL, client_main, c);
+    }
+    fanout.last_expire_ns = sc_time_now_ns();
+
+    uint64_t elapsed = run_sender(&server, payload, rate, burst, total);
+    usleep(DRAIN_USEC);
+
+    // Latency percentiles over all clients' samples together
+    uint64_t received = 0;
+    uint64_t bytes = 0;
+    uint64_t reordered = 0;
+    uint64_t duplicates = 0;
+    for (uint32_t i = 0; i < client_count; i++) {
+        __atomic_store_n(&clients[i].running, false, __ATOMIC_RELEASE);
+        pthread_join(clients[i].thread, NULL);
+        received += clients[i].received;
+    }
+    uint64_t *all = malloc(sizeof(uint64_t) * (received ? received : 1));
+    uint64_t filled = 0;
+    for (uint32_t i = 0; i < client_count; i++) {
+        client *c = &clients[i];
+        memcpy(&all[filled], c->latencies, sizeof(uint64_t) * c->received);
+        filled += c->received;
+        bytes += c->bytes;
+        reordered += c->reordered;
+        duplicates += c->duplicates;
+        close(c->conn.socket_audio_fd);
+        free(c->latencies);
+        free(c->seen);
+    }
+    qsort(all, received, sizeof(uint64_t), compare_u64);
+    double p50 = received ? all[received / 2] / 1000.0 : 0.0;
+    double p99 = received ? all[received * 99 / 100] / 1000.0 : 0.0;
+    double p999 = received ? all[received * 999 / 1000] / 1000.0 : 0.0;
+    double seconds = (double) elapsed / NS_PER_SEC;
+    uint64_t expected = total * client_count;
+
+    printf("{\"mode\": \"%s\", \"payload_bytes\": %u, \"target_pps\": %u, \"clients\": %u, "
+        "\"burst\": %u, \"pacing\": \"%s\", \"rcvbuf\": %d, "
+        "\"sent_pps\": %.0f, \"recv_pps_per_client\": %.0f, \"recv_bytes_per_sec_per_client\": %.0f, "
+        "\"latency_us\": {\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f}, "
+        "\"loss\": %.6f, \"reordered\": %llu, \"duplicates\": %llu}\n",
+        mode_names[!multicast], payload, rate, client_count,
+        burst, pacing < 0 ? "none" : pacing == PACING_TXTIME ? "txtime" : "sleep", rcvbuf,
+        total / seconds, received / seconds / client_count, bytes / seconds / client_count,
+        p50, p99, p999,
+        expected ? 1.0 - (double) received / expected : 0.0,
+        (unsigned long long) reordered, (unsigned long long) duplicates);
+    fflush(stdout);
+
+    free(all);
+    if (!multicast) {
+        server.fanout = NULL;
+        sc_fanout_destroy(&fanout);
+    }
+    sc_socket_close(&server);
+}
+
+int main(void) {
+    for (uint8_t mode = 0; mode < 2; mode++) {
+        for (uint32_t p = 0; p < COUNT_OF(payload_sizes); p++) {
+            for (uint32_t r = 0; r < COUNT_OF(packet_rates); r++) {
+                for (uint32_t c = 0; c < COUNT_OF(client_counts); c++) {
+                    run_config(mode == 0, payload_sizes[p], packet_rates[r], client_counts[c],
+                        1, -1, 4 * 1024 * 1024);
+                }
+            }
+        }
+    }
+    for (uint32_t b = 0; b < COUNT_OF(frame_bursts); b++) {
+        run_config(true, SHALLOW_PAYLOAD, SHALLOW_RATE, 1, frame_bursts[b], -1, SHALLOW_RCVBUF);
+        run_config(true, SHALLOW_PAYLOAD, SHALLOW_RATE, 1, frame_bursts[b], PACING_TXTIME, SHALLOW_RCVBUF);
+        run_config(true, SHALLOW_PAYLOAD, SHALLOW_RATE, 1, frame_bursts[b], PACING_SLEEP, SHALLOW_RCVBUF);
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+#define _GNU_SOURCE  // rand_r(...)
+
+#include "trace.h"
+#include "jitter_buffer.h"
+#include "datagram.h"
+#include "codec.h"
+#include "timing.h"
+
+#include <stdio.h>   // printf(...), remove(...)
+#include <stdlib.h>  // rand_r(...)
+#include <string.h>  // memset(...)
+
+#define TRACE_PATH "/tmp/sc_replay_bench.trace"
+#define CHANNELS 2
+#define FRAMES_PER_PACKET 480              // 10ms at 48 kHz
+#define FRAME_INTERVAL_NS (10 * 1000 * 1000ULL)
+#define PACKETS 100000                     // ~17 minutes of audio
+#define PASSES 10                          // Replays of the trace per measurement
+#define JITTER_NS (4 * 1000 * 1000)        // Arrival jitter is uniform in [0, JITTER_NS)
+#define LOSS_PER_MILLE 10
+#define REORDER_PER_MILLE 20               // Datagrams swapped with the one after them
+
+// Client pipeline fed by the replay: reorder and buffer in a jitter buffer played out on the
+// (recorded) arrival clock, then decode each frame.
+typedef struct {
+    jitter_buffer_t jb;
+    const codec_t  *codec;
+    codec_state     state;
+    uint64_t        playout_ns;  // Arrival time the next frame is due
+    uint64_t        checksum;    // Over all decoded PCM, to compare replays
+    uint8_t         decode;      // false to measure buffering alone
+    int16_t         pcm[FRAMES_PER_PACKET * CHANNELS];
+} pipeline;
+
+void pipeline_init(pipeline *p, uint8_t decode) {
+    sc_jitter_buffer_init(&p->jb, 2, 16, FRAME_INTERVAL_NS);
+    p->codec = sc_codec_get(CODEC_IMA_ADPCM);
+    sc_codec_state_init(&p->state);
+    p->playout_ns = 0;
+    p->checksum = 0;
+    p->decode = decode;
+}
+
+void pipeline_feed(void *ctx, datagram_t *dgram, uint32_t len, uint64_t arrival_ns, uint8_t aux) {
+    pipeline *p = (pipeline *) ctx;
+    datagram_t frame;
+    uint32_t frame_len;
+
+    (void) aux;
+    if (p->playout_ns == 0) {
+        p->playout_ns = arrival_ns;
+    }
+    // Play out every frame due before this arrival
+    for (; p->playout_ns <= arrival_ns; p->playout_ns += FRAME_INTERVAL_NS) {
+        if (sc_jitter_buffer_pop(&p->jb, &frame, &frame_len) != JITTER_POP_FRAME || !p->decode) {
+            continue;
+        }
+        uint32_t frames = p->codec->decode(&p->state, frame.payload.audio, frame.header.payload_len, CHANNELS,
+            p->pcm);
+        for (uint32_t i = 0; i < frames * CHANNELS; i += 61) {
+            p->checksum = p->checksum * 31 + (uint16_t) p->pcm[i];
+        }
+    }
+    sc_jitter_buffer_push(&p->jb, dgram, len, arrival_ns);
+}
+
+// Count what the replay delivers, to measure the trace reader alone
+void count_only(void *ctx, datagram_t *dgram, uint32_t len, uint64_t arrival_ns, uint8_t aux) {
+    (void) dgram;
+    (void) len;
+    (void) arrival_ns;
+    (void) aux;
+    (*(uint64_t *) ctx)++;
+}
+
+// Record a synthetic SERVER_AUDIO stream as a client would have received it: jittered,
+// lossy and occasionally reordered.
+// Returns the number of datagrams recorded.
+uint64_t record_stream(void) {
+    const codec_t *codec = sc_codec_get(CODEC_IMA_ADPCM);
+    codec_state state;
+    trace_recorder_t rec;
+    int16_t pcm[FRAMES_PER_PACKET * CHANNELS];
+    datagram_t dgrams[2];
+    uint32_t lens[2];
+    uint64_t arrivals[2];
+    uint32_t held = 0;
+    uint32_t seed = 1;
+    uint64_t recorded = 0;
+
+    if (!sc_trace_recorder_open(&rec, TRACE_PATH)) {
+        return 0;
+    }
+    sc_codec_state_init(&state);
+    for (uint32_t i = 0; i < FRAMES_PER_PACKET * CHANNELS; i++) {
+        pcm[i] = (int16_t) ((rand_r(&seed) % 16000) - 8000);
+    }
+    for (uint32_t sequence = 0; sequence < PACKETS; sequence++) {
+        datagram_t *dgram = &dgrams[held];
+        uint64_t sent_ns = (uint64_t) sequence * FRAME_INTERVAL_NS;
+        datagram_header header = { .kind = SERVER_AUDIO, .sequence = sequence, .timestamp = sent_ns };
+        uint32_t payload_len = codec->encode(&state, pcm, FRAMES_PER_PACKET, CHANNELS, dgram->payload.audio);
+
+        if ((uint32_t) (rand_r(&seed) % 1000) < LOSS_PER_MILLE) {
+            continue;
+        }
+        sc_datagram_header_encode(&header, payload_len, &dgram->header);
+        lens[held] = sizeof(datagram_header) + payload_len;
+        arrivals[held] = sent_ns + rand_r(&seed) % JITTER_NS;
+        held++;
+        if (held == 1 && (uint32_t) (rand_r(&seed) % 1000) < REORDER_PER_MILLE) {
+            continue;  // Recorded after the next datagram
+        }
+        for (uint32_t i = held; i > 0; i--) {
+            uint64_t arrival_ns = arrivals[i - 1] > arrivals[held - 1] ? arrivals[i - 1] : arrivals[held - 1];
+            recorded += sc_trace_record(&rec, &dgrams[i - 1], lens[i - 1], arrival_ns, false);
+        }
+        held = 0;
+    }
+    sc_trace_recorder_close(&rec);
+    return recorded;
+}
+
+// Replay the trace PASSES times through a fresh pipeline each time.
+// Returns the nanoseconds taken. `deterministic` is cleared unless every pass produced the
+// same audio and jitter buffer statistics, which are stored in `stats`.
+uint64_t replay_pipeline(trace_reader_t *reader, uint8_t decode, jitter_buffer_stats *stats,
+    uint8_t *deterministic) {
+    static pipeline p;
+    uint64_t checksum = 0;
+
+    uint64_t start = sc_time_now_ns();
+    for (uint32_t pass = 0; pass < PASSES; pass++) {
+        sc_trace_reader_rewind(reader);
+        pipeline_init(&p, decode);
+        sc_trace_replay(reader, false, pipeline_feed, &p);
+        if (pass == 0) {
+            checksum = p.checksum;
+            *stats = p.jb.stats;
+        }
+        if (p.checksum != checksum || memcmp(stats, &p.jb.stats, sizeof(jitter_buffer_stats)) != 0) {
+            *deterministic = false;
+        }
+    }
+    return sc_time_now_ns() - start;
+}
+
+int main(void) {
+    trace_reader_t reader;
+    jitter_buffer_stats stats;
+    uint8_t deterministic = true;
+    uint64_t count = 0;
+
+    uint64_t recorded = record_stream();
+    if (recorded == 0 || !sc_trace_reader_open(&reader, TRACE_PATH)) {
+        return 1;
+    }
+
+    uint64_t start = sc_time_now_ns();
+    for (uint32_t pass = 0; pass < PASSES; pass++) {
+        sc_trace_reader_rewind(&reader);
+        sc_trace_replay(&reader, false, count_only, &count);
+    }
+    uint64_t read_ns = sc_time_now_ns() - start;
+
+    uint64_t buffer_ns = replay_pipeline(&reader, false, &stats, &deterministic);
+    uint64_t pipeline_ns = replay_pipeline(&reader, true, &stats, &deterministic);
+
+    printf("{\"recorded\": %llu, \"trace_bytes\": %llu, \"read_mpps\": %.2f, \"buffer_mpps\": %.2f, "
+        "\"decode_mpps\": %.2f, \"played\": %llu, \"missing\": %llu, \"late\": %llu, \"deterministic\": %s}\n",
+        (unsigned long long) recorded, (unsigned long long) reader.size, (double) count * 1000 / read_ns,
+        (double) recorded * PASSES * 1000 / buffer_ns, (double) recorded * PASSES * 1000 / pipeline_ns,
+        (unsigned long long) stats.played, (unsigned long long) stats.missing, (unsigned long long) stats.late,
+        deterministic ? "true" : "false");
+
+    sc_trace_reader_close(&reader);
+    remove(TRACE_PATH);
+}
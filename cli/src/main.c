@@ -2,63 +2,980 @@
 #include "logger.h"
 #include "assert.h"
 #include "networking.h"
+#include "event_loop.h"
+#include "timing.h"
+#include "retransmit.h"
+#include "fast_join.h"
+#include "low_latency.h"
+#include "trace.h"
+#include "pcm_source.h"
+#include "packetizer.h"
+#include "codec.h"
+#include "mixer.h"
+#include "fec.h"
+#include "rate_control.h"
+#include "clock_sync.h"
+#include "fanout.h"
+#include "server.h"
+
+#include <stdio.h>   // fopen(...), fwrite(...)
+#include <stdlib.h>  // atoi(...), atexit(...)
+#include <string.h>  // strcmp(...)
+
+// Demo timings
+#define ADVERTISE_INTERVAL_NS (1 * NS_PER_SEC)
+#define AUDIO_INTERVAL_NS     (20 * 1000 * 1000ULL)
+#define AUDIO_FRAME_NS        (5 * 1000 * 1000ULL)  // Input audio per frame, mixed as one frame
+#define SERVER_RUN_NS         (5 * NS_PER_SEC)
+
+// Fast join: recent frames a joining client asks for, and how the server paces them
+#define JOIN_FRAMES           FAST_JOIN_FRAMES_MAX
+#define JOIN_CHUNK            8
+#define JOIN_INTERVAL_NS      (1000 * 1000ULL)
+
+// Servers seen by the client, to rejoin on restart without waiting for an advertisement
+#define KNOWN_SERVERS_PATH    ".sc_known_servers"
+#define KNOWN_SERVERS_MAX_AGE (24 * 3600 * NS_PER_SEC)
+
+// Raw PCM input layout unless the file is a WAV
+#define INPUT_DEFAULT_RATE     48000
+#define INPUT_DEFAULT_CHANNELS 2
+
+// `--mix` client: ducked streams drop by 12 dB
+#define MIX_DUCK_GAIN 0.25f
+
+// Rate control: mixing clients report every interval and a server streaming input adapts
+// to them, between its codec and ADPCM, with FEC groups of 2 to 8 datagrams. Clients buffer
+// a whole group to recover from it, so larger groups would cost more than 40 ms of delay.
+#define REPORT_INTERVAL_NS    (1 * NS_PER_SEC)
+#define REPORT_TIMEOUT_NS     (5 * NS_PER_SEC)
+#define RATE_FEC_GROUP_MIN    2
+#define RATE_FEC_GROUP_MAX    8
+
+// Repair: mixing clients NACK the gaps in their jitter buffers every interval, again after
+// the retry if still missing, and the server answers a datagram's NACKs from many clients
+// within the suppression window with one re-multicast
+#define NACK_INTERVAL_NS      (10 * 1000 * 1000ULL)
+#define NACK_RETRY_NS         (30 * 1000 * 1000ULL)
+#define REPAIR_SUPPRESS_NS    (20 * 1000 * 1000ULL)
+
+// Unicast fan-out: subscribed clients keep their subscription alive every interval and
+// the server drops those silent for the expiry
+#define KEEPALIVE_INTERVAL_NS (1 * NS_PER_SEC)
+#define FANOUT_EXPIRY_NS      (5 * NS_PER_SEC)
+
+// Clients probe the server clock while joined and, once synchronized, play each frame this
+// long after the server stamped it, so every client plays it at the same instant. Covers
+// the server's send interval, a whole FEC group and network jitter.
+#define CLOCK_PROBE_INTERVAL_NS (250 * 1000 * 1000ULL)
+#define SYNC_PLAYOUT_DELAY_NS   (60 * 1000 * 1000ULL)
+
+// `multi` server: channels of test tones, a sawtooth at a pitch of its own on each group,
+// hosted by one multi-threaded server
+#define MULTI_CHANNELS_DEFAULT 3
+#define MULTI_GROUP_FORMAT     "239.255.1.%u"
+#define MULTI_TONE_HZ          220
+
+// `--low-latency` client profile: a receive queue of 16 frames, RT priority, no pinning
+#define LOW_LATENCY_DEPTH       16
+#define LOW_LATENCY_RT_PRIORITY 10
+
+typedef struct demo_state demo_state;
+
+// `multi` server: one channel's test tone
+typedef struct {
+    connection_t  *conn;        // The server's channel, sent to by the packetizer
+    packetizer_t   packetizer;
+    const codec_t *codec;
+    codec_state    codec_state;
+    uint8_t        channels;
+    uint32_t       frames;      // PCM frames per audio frame
+    uint32_t       phase;       // Position in the sawtooth cycle, the whole range is one cycle
+    uint32_t       phase_step;  // Phase advance per PCM frame
+    uint64_t       start_ns;    // Stamp of the first frame
+    uint64_t       sent;        // Frames sent
+} tone_channel;
+
+// Client: one more stream played through the mixer alongside the first
+typedef struct {
+    connection_t conn;
+    demo_state  *state;
+    int32_t      index;  // Mixer stream
+    report_builder_t report;
+    nack_tracker_t nack;
+    uint8_t      join_pending;  // Join burst to request on the group's first datagram
+} client_stream;
+
+struct demo_state {
+    connection_t *conn;
+    event_loop_t *loop;
+    datagram_t    audio;
+    uint32_t      audio_sequence;  // Audio has its own sequence space, separate from ads
+    uint8_t       joined;
+    uint8_t       confirmed;       // Client: joined group checked against the server's advertisement
+    uint8_t       join_pending;    // Client: join burst to request on the group's first datagram
+    uint8_t       remembered;      // Client: server saved to the known servers file this run
+    uint8_t       subscribe;       // Client: receive the joined channel by unicast fan-out, not multicast
+    retransmit_cache_t *history;   // Server: recent audio for join bursts
+    fast_join_t   fast_join;
+    int32_t       join_timer;      // Server: burst pacing timer while bursts are active, else -1
+    pcm_source_t *source;          // Server: audio input, NULL to send the demo datagram
+    packetizer_t  packetizer;
+    const codec_t *codec;
+    codec_state   codec_state;
+    uint32_t      frame_frames;    // Server: PCM frames encoded per audio frame
+    rate_controller_t *rate;       // Server: adapts the input's stream to client reports, NULL without input
+    fec_encoder_t fec;
+    mixer_t      *mixer;           // Client: mixes the joined streams, NULL to only log audio
+    uint32_t      mix_streams;     // Client: channels to join and mix
+    uint8_t       mixing;          // Client: streams set up from an advertisement
+    client_stream streams[MIXER_STREAMS_MAX];
+    FILE         *mix_output;      // Client: raw 16 bit PCM of the mix, NULL to discard it
+    report_builder_t report;       // Client: reception of the joined stream while mixing
+    nack_tracker_t nack;           // Client: repairs requested for the joined stream while mixing
+    clock_sync_t  clock;           // Client: estimate of the server clock
+    int32_t       mix_timer;       // Client: mix timer, aligned to the server's frames once synchronized
+    uint64_t      frame_timestamp; // Client: server stamp of the latest joined stream frame, 0 before any
+};
+
+void dump_stats(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    connection_stats snapshot;
+    sc_connection_stats_snapshot(state->conn, &snapshot);
+    sc_stats_log(state->conn->is_server ? "server" : "client", &snapshot);
+}
+
+void server_emit_audio(datagram_t *dgram, uint32_t len, void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    if (!sc_network_send(state->conn, dgram, len)) {
+        LOG_WARN("Server: failed to send audio");
+        return;
+    }
+    sc_retransmit_cache_store(state->history, dgram, len);
+    if (state->rate) {
+        uint32_t parity_len;
+        datagram_t *parity = sc_fec_encoder_add(&state->fec, dgram, len, &parity_len);
+        if (parity && !sc_network_send(state->conn, parity, parity_len)) {
+            LOG_WARN("Server: failed to send FEC");
+        }
+    }
+}
+
+// Encode and send whatever input audio is due, stopping once it runs out
+void server_send_input(demo_state *state) {
+    uint8_t encoded[AUDIO_FRAME_MAX_BYTES];
+    const int16_t *pcm;
+    uint32_t due = sc_pcm_source_due(state->source, sc_time_now_ns());
+
+    while (due >= state->frame_frames) {
+        // Stamped with when the frame was due rather than sent, as clients schedule playout by it
+        sc_packetizer_set_timestamp(&state->packetizer, sc_pcm_source_due_ns(state->source));
+        uint32_t frames = sc_pcm_source_read(state->source, state->frame_frames, &pcm);
+        if (frames == 0) {
+            break;  // Pipe behind: the audio stays due
+        }
+        uint32_t len = state->codec->encode(&state->codec_state, pcm, frames, state->source->params.channels,
+            encoded);
+        sc_packetizer_push(&state->packetizer, encoded, len);
+        due -= frames;
+    }
+    if (state->source->eof) {
+        sc_packetizer_flush(&state->packetizer);
+        LOG_INFO("Server: input finished after %llu frames (%llu underruns)",
+            (unsigned long long) state->source->stats.frames, (unsigned long long) state->source->stats.underruns);
+        sc_event_loop_stop(state->loop);
+    }
+}
+
+void server_send_audio(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    if (state->source) {
+        server_send_input(state);
+        return;
+    }
+    state->audio.header.sequence = state->audio_sequence++;
+    state->audio.header.timestamp = sc_time_now_ns();
+    if (!sc_network_send(state->conn, &state->audio, sizeof(datagram_t))) {
+        LOG_WARN("Server: failed to send audio");
+        return;
+    }
+    sc_retransmit_cache_store(state->history, &state->audio, sizeof(datagram_t));
+}
+
+void tone_emit(datagram_t *dgram, uint32_t len, void *ctx) {
+    tone_channel *tone = (tone_channel *) ctx;
+    if (!sc_network_send(tone->conn, dgram, len)) {
+        LOG_WARN("Server: failed to send tone to group %.*s", INET_ADDRSTRLEN, tone->conn->group_addr);
+    }
+}
+
+// Channel source of the `multi` server: encode and send the next frame of the tone,
+// stamped with its media time
+void tone_send(connection_t *channel, void *ctx) {
+    tone_channel *tone = (tone_channel *) ctx;
+    int16_t pcm[MIXER_FRAMES_MAX * CODEC_CHANNELS_MAX];
+    uint8_t encoded[AUDIO_FRAME_MAX_BYTES];
+    (void) channel;
+
+    for (uint32_t i = 0; i < tone->frames; i++) {
+        int16_t sample = (int16_t) (((int32_t) (tone->phase >> 16) - 32768) / 4);  // -12 dB
+        for (uint8_t c = 0; c < tone->channels; c++) {
+            pcm[i * tone->channels + c] = sample;
+        }
+        tone->phase += tone->phase_step;
+    }
+    sc_packetizer_set_timestamp(&tone->packetizer, tone->start_ns + tone->sent * AUDIO_FRAME_NS);
+    uint32_t len = tone->codec->encode(&tone->codec_state, pcm, tone->frames, tone->channels, encoded);
+    sc_packetizer_push(&tone->packetizer, encoded, len);
+    tone->sent++;
+}
+
+void multi_advertise(void *ctx) {
+    sc_server_advertise((server_t *) ctx);
+}
+
+// Adapt codec, packet size and FEC of the input's stream to the latest client reports
+void server_adapt_rate(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    if (!sc_rate_controller_update(state->rate, sc_time_now_ns())) {
+        return;
+    }
+    const rate_settings *settings = &state->rate->settings;
+    const codec_t *codec = sc_codec_get(settings->codec);
+    if (codec && codec != state->codec) {
+        state->codec = codec;
+        state->conn->codec = settings->codec;
+        sc_codec_state_init(&state->codec_state);
+        // Clients switch decoders on the advertisement
+        sc_network_server_advertise(state->conn);
+    }
+    sc_packetizer_reconfigure(&state->packetizer,
+        state->codec->encoded_size(state->frame_frames, state->source->params.channels), settings->packet_size);
+    if (settings->fec_group != state->fec.group_size) {
+        sc_fec_encoder_init(&state->fec, settings->fec_group);
+    }
+}
+
+void server_send_join_bursts(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    sc_fast_join_poll(&state->fast_join, state->history, state->conn, sc_time_now_ns());
+    if (!sc_fast_join_active(&state->fast_join)) {
+        sc_event_loop_remove(state->loop, state->join_timer);
+        state->join_timer = -1;
+    }
+}
+
+void server_on_aux(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    datagram_t recv;
+    struct sockaddr_in src;
+    uint64_t arrival_ns;
+    while (sc_network_receive_timed(state->conn, &recv, true, &src, &arrival_ns)) {
+        if (recv.header.kind == CLIENT_TIME_REQUEST) {
+            sc_clock_sync_respond(state->conn, &recv, &src, arrival_ns);
+            continue;
+        }
+        if ((recv.header.kind == CLIENT_SUBSCRIBE || recv.header.kind == CLIENT_KEEPALIVE
+            || recv.header.kind == CLIENT_UNSUBSCRIBE) && state->conn->fanout) {
+            const subscription *sub = (const subscription *) recv.payload.audio;
+            if (recv.header.payload_len >= sizeof(subscription)
+                && strncmp(sub->group_addr, state->conn->group_addr, INET_ADDRSTRLEN) == 0
+                && sc_fanout_handle_request(state->conn->fanout, &recv, &src, sc_time_now_ns())
+                && recv.header.kind != CLIENT_KEEPALIVE) {
+                LOG_INFO("Server: %u unicast subscribers", state->conn->fanout->count);
+            }
+            continue;
+        }
+        if (recv.header.kind == CLIENT_NACK) {
+            sc_retransmit_cache_handle_nack(state->history, state->conn, &recv, sc_time_now_ns());
+            continue;
+        }
+        if (recv.header.kind == CLIENT_REPORT && state->rate) {
+            sc_rate_controller_handle_report(state->rate, &recv, &src, sc_time_now_ns());
+            continue;
+        }
+        if (recv.header.kind != CLIENT_JOIN
+            || !sc_fast_join_handle_request(&state->fast_join, state->history, &recv, &src, sc_time_now_ns())) {
+            continue;
+        }
+        LOG_INFO("Server: sending join burst");
+        if (state->join_timer < 0) {
+            state->join_timer = sc_event_loop_add_timer(state->loop, JOIN_INTERVAL_NS,
+                server_send_join_bursts, state);
+        }
+        server_send_join_bursts(state);
+    }
+}
+
+void server_stop(void *ctx) {
+    sc_event_loop_stop(((demo_state *) ctx)->loop);
+}
+
+// Ask the server for a burst of recent audio of `conn`'s joined group to fill the buffer
+// at once, sent to where unicast for the group reaches `conn`. `received` is the first
+// datagram received from the group, which the server requires as proof of membership.
+void client_join(connection_t *conn, const datagram_t *received) {
+    datagram_t request;
+    uint16_t port = sc_network_unicast_port(conn);
+    if (port == 0) {
+        return;
+    }
+    uint32_t len = sc_fast_join_build_request(&request, conn->group_addr, port, JOIN_FRAMES, received);
+    if (!sc_network_send(conn, &request, len)) {
+        LOG_WARN("Client: failed to request join burst");
+    }
+}
+
+// Receive channel 0 of `ad` by unicast fan-out instead of joining its group, for networks
+// that block multicast. The server sends it to the port unicast for the group reaches.
+// Returns true if the subscription was sent, false otherwise.
+uint8_t client_subscribe(demo_state *state, const advertisement *ad) {
+    const advertised_channel *channel = &ad->channels[0];
+    datagram_t request;
+    uint16_t port = sc_network_unicast_port(state->conn);
+    if (port == 0) {
+        return false;
+    }
+    memcpy(state->conn->group_addr, channel->group_addr, INET_ADDRSTRLEN);
+    state->conn->group_addr[INET_ADDRSTRLEN - 1] = '\0';
+    state->conn->codec = channel->codec;
+    state->conn->sample_rate = channel->sample_rate;
+    state->conn->channels = channel->channels;
+    uint32_t len = sc_fanout_build_request(&request, CLIENT_SUBSCRIBE, state->conn->group_addr, port);
+    if (!sc_network_send(state->conn, &request, len)) {
+        LOG_WARN("Client: failed to subscribe");
+        return false;
+    }
+    return true;
+}
+
+// Keep the unicast subscription alive (re-subscribing if the server restarted)
+void client_keepalive(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    datagram_t request;
+    if (!state->joined) {
+        return;
+    }
+    uint32_t len = sc_fanout_build_request(&request, CLIENT_KEEPALIVE, state->conn->group_addr,
+        sc_network_unicast_port(state->conn));
+    if (!sc_network_send(state->conn, &request, len)) {
+        LOG_WARN("Client: failed to send keepalive");
+    }
+}
+
+// Receive the audio of `conn` from its group (or unicast socket if `aux`), mixer stream
+// `index` once mixing. Requests the join burst if `join_pending`.
+void client_receive_audio(demo_state *state, connection_t *conn, uint8_t aux, int32_t index,
+    uint8_t *join_pending) {
+    datagram_t recv;
+    struct sockaddr_in src;
+    uint64_t arrival_ns;
+    while (sc_network_receive_timed(conn, &recv, aux, &src, &arrival_ns)) {
+        if (conn == state->conn && recv.header.kind == SERVER_AUDIO) {
+            state->frame_timestamp = recv.header.timestamp;
+        }
+        if (*join_pending && !aux && recv.header.kind == SERVER_AUDIO) {
+            client_join(conn, &recv);
+            *join_pending = false;
+        }
+        if (state->mixing) {
+            sc_mixer_push(state->mixer, index, &recv, sizeof(datagram_header) + recv.header.payload_len,
+                arrival_ns);
+        }
+    }
+}
+
+void client_on_audio(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    client_receive_audio(state, state->conn, false, 0, &state->join_pending);
+}
+
+void client_on_stream_audio(void *ctx) {
+    client_stream *stream = (client_stream *) ctx;
+    client_receive_audio(stream->state, &stream->conn, false, stream->index, &stream->join_pending);
+}
+
+void client_on_stream_unicast(void *ctx) {
+    client_stream *stream = (client_stream *) ctx;
+    client_receive_audio(stream->state, &stream->conn, true, stream->index, &stream->join_pending);
+}
+
+// Mix the next frame of every stream, writing it out if asked to
+void client_mix(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    int16_t out[MIXER_FRAMES_MAX * CODEC_CHANNELS_MAX];
+    if (!state->mixing) {
+        return;
+    }
+    // Synchronized: play what the server stamped a playout delay ago, as every client does
+    uint64_t due_ns = state->clock.synced
+        ? sc_clock_sync_local_to_server(&state->clock, sc_time_now_ns()) - SYNC_PLAYOUT_DELAY_NS : 0;
+    sc_mixer_mix_due(state->mixer, out, due_ns);
+    if (state->mix_output) {
+        fwrite(out, sizeof(int16_t), state->mixer->frames * state->mixer->channels, state->mix_output);
+    }
+}
+
+// Probe the server clock while joined
+void client_probe_clock(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    datagram_t request;
+    if (!state->joined) {
+        return;
+    }
+    uint32_t len = sc_clock_sync_build_request(&state->clock, &request);
+    if (!sc_network_send(state->conn, &request, len)) {
+        LOG_WARN("Client: failed to probe the server clock");
+    }
+}
+
+// Fold in a time response, publishing the offset and moving the mix timer into phase with
+// the server's frames (offset by the playout delay) so each mix finds its frame due
+void client_sync_clock(demo_state *state, const datagram_t *response, uint64_t arrival_ns) {
+    uint8_t was_synced = state->clock.synced;
+    if (!sc_clock_sync_handle_response(&state->clock, response, arrival_ns)) {
+        return;
+    }
+    if (!was_synced) {
+        LOG_INFO("Client: synchronized to the server clock (offset %lld ns)", (long long) state->clock.offset_ns);
+    }
+    sc_stats_set_clock_offset(&state->conn->stats, state->clock.offset_ns);
+    for (uint32_t i = 1; i < MIXER_STREAMS_MAX; i++) {
+        if (state->streams[i].state) {
+            sc_stats_set_clock_offset(&state->streams[i].conn.stats, state->clock.offset_ns);
+        }
+    }
+    if (state->mix_timer < 0 || state->frame_timestamp == 0) {
+        return;
+    }
+    uint64_t server_now = sc_clock_sync_local_to_server(&state->clock, sc_time_now_ns());
+    int64_t since = (int64_t) (server_now - state->frame_timestamp - SYNC_PLAYOUT_DELAY_NS);
+    int64_t frames = since >= 0 ? since / (int64_t) AUDIO_FRAME_NS + 1 : since / (int64_t) AUDIO_FRAME_NS;
+    uint64_t next_tick = state->frame_timestamp + SYNC_PLAYOUT_DELAY_NS + (uint64_t) (frames * (int64_t) AUDIO_FRAME_NS);
+    sc_event_loop_align_timer(state->loop, state->mix_timer,
+        sc_clock_sync_server_to_local(&state->clock, next_tick));
+}
+
+// Request repair of the gaps in every mixed stream's jitter buffer
+void client_request_repairs(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    datagram_t nack;
+    if (!state->mixing) {
+        return;
+    }
+    uint64_t now_ns = sc_time_now_ns();
+    uint32_t len = sc_nack_build(&state->nack, &state->mixer->streams[0].jb, state->conn->group_addr, &nack,
+        now_ns);
+    if (len > 0) {
+        sc_network_send(state->conn, &nack, len);
+    }
+    for (uint32_t i = 1; i < MIXER_STREAMS_MAX; i++) {
+        client_stream *stream = &state->streams[i];
+        if (!stream->state) {
+            continue;
+        }
+        len = sc_nack_build(&stream->nack, &state->mixer->streams[stream->index].jb, stream->conn.group_addr,
+            &nack, now_ns);
+        if (len > 0) {
+            sc_network_send(&stream->conn, &nack, len);
+        }
+    }
+}
+
+// Report reception of every mixed stream, so a server can adapt its rate
+void client_report(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    datagram_t report;
+    if (!state->mixing) {
+        return;
+    }
+    uint32_t len = sc_receiver_report_build(&state->report, &state->mixer->streams[0].jb, state->conn->group_addr,
+        &report);
+    sc_network_send(state->conn, &report, len);
+    for (uint32_t i = 1; i < MIXER_STREAMS_MAX; i++) {
+        client_stream *stream = &state->streams[i];
+        if (!stream->state) {
+            continue;
+        }
+        len = sc_receiver_report_build(&stream->report, &state->mixer->streams[stream->index].jb,
+            stream->conn.group_addr, &report);
+        sc_network_send(&stream->conn, &report, len);
+    }
+}
+
+// Follow codec changes advertised for `conn`'s group, mixer stream `index` once mixing
+void client_follow_codec(demo_state *state, connection_t *conn, int32_t index, const advertisement *ad) {
+    for (uint8_t i = 0; i < ad->channel_count; i++) {
+        const advertised_channel *channel = &ad->channels[i];
+        if (strncmp(channel->group_addr, conn->group_addr, INET_ADDRSTRLEN) != 0 || channel->codec == conn->codec) {
+            continue;
+        }
+        LOG_INFO("Client: group %.*s switched to codec %d", INET_ADDRSTRLEN, conn->group_addr, channel->codec);
+        conn->codec = channel->codec;
+        if (state->mixing) {
+            sc_mixer_set_codec(state->mixer, index, channel->codec);
+        }
+    }
+}
+
+// Subscribe to the first `mix_streams` channels of `ad`, the joined channel included, mixed
+// in the joined channel's layout. Channels listed later duck those before them (e.g. a
+// paging channel over music).
+void client_start_mixing(demo_state *state, const advertisement *ad) {
+    uint32_t count = ad->channel_count < state->mix_streams ? ad->channel_count : state->mix_streams;
+    const advertised_channel *joined = &ad->channels[0];
+    if (!sc_mixer_init(state->mixer, joined->sample_rate, joined->channels, AUDIO_FRAME_NS, MIX_DUCK_GAIN)
+        || sc_mixer_add_stream(state->mixer, joined->codec, joined->sample_rate, joined->channels, 1.0f, 0) < 0) {
+        LOG_WARN("Client: cannot mix the joined channel, mixing disabled");
+        state->mixer = NULL;
+        return;
+    }
+    sc_report_builder_init(&state->report);
+    sc_nack_tracker_init(&state->nack, NACK_RETRY_NS);
+    for (uint32_t i = 1; i < count; i++) {
+        client_stream *stream = &state->streams[i];
+        if (!sc_socket_client_stream_init(&stream->conn, state->conn, ad, (uint8_t) i)) {
+            continue;
+        }
+        stream->index = sc_mixer_add_stream(state->mixer, ad->channels[i].codec, ad->channels[i].sample_rate,
+            ad->channels[i].channels, 1.0f, (uint8_t) i);
+        if (stream->index < 0) {
+            sc_socket_close(&stream->conn);
+            continue;
+        }
+        stream->state = state;
+        sc_report_builder_init(&stream->report);
+        sc_nack_tracker_init(&stream->nack, NACK_RETRY_NS);
+        sc_event_loop_add_fd(state->loop, sc_network_event_fd(&stream->conn, false), client_on_stream_audio, stream);
+        sc_event_loop_add_fd(state->loop, sc_network_event_fd(&stream->conn, true), client_on_stream_unicast, stream);
+        stream->join_pending = true;
+        LOG_INFO("Client mixing group %.*s", INET_ADDRSTRLEN, stream->conn.group_addr);
+    }
+    state->mixing = true;
+}
+
+void client_on_aux(void *ctx) {
+    demo_state *state = (demo_state *) ctx;
+    datagram_t recv;
+    struct sockaddr_in src;
+    uint64_t arrival_ns;
+    while (sc_network_receive_timed(state->conn, &recv, true, &src, &arrival_ns)) {
+        if (recv.header.kind == SERVER_TIME_RESPONSE) {
+            client_sync_clock(state, &recv, arrival_ns);
+            continue;
+        }
+        // A group rejoined from the known servers file may no longer be the one served
+        if (recv.header.kind == SERVER_AD && state->joined && !state->confirmed
+            && recv.payload.ad.channel_count > 0) {
+            if (strncmp(recv.payload.ad.channels[0].group_addr, state->conn->group_addr, INET_ADDRSTRLEN) == 0) {
+                state->confirmed = true;
+            } else {
+                LOG_INFO("Client: known group %.*s no longer advertised, rejoining", INET_ADDRSTRLEN,
+                    state->conn->group_addr);
+                sc_socket_client_leave(state->conn);
+                state->joined = false;
+            }
+        }
+        if (recv.header.kind == SERVER_AD && !state->joined) {
+            LOG_DEBUG("advertised channels: %d, first group: %.*s", recv.payload.ad.channel_count,
+                INET_ADDRSTRLEN, recv.payload.ad.channels[0].group_addr);
+            LOG_DEBUG("received from: %.*s", INET_ADDRSTRLEN, state->conn->other_addr);
+            if (state->subscribe && client_subscribe(state, &recv.payload.ad)) {
+                LOG_INFO("Client subscribed to group %.*s", INET_ADDRSTRLEN, state->conn->group_addr);
+                state->joined = true;
+                state->confirmed = true;
+                state->join_pending = true;
+            } else if (!state->subscribe && sc_socket_client_join_channel(state->conn, &recv.payload.ad, 0)) {
+                LOG_INFO("Client joined multicast group");
+                state->joined = true;
+                state->confirmed = true;
+                state->join_pending = true;
+            }
+        }
+        if (recv.header.kind == SERVER_AD && state->joined) {
+            client_follow_codec(state, state->conn, 0, &recv.payload.ad);
+            for (uint32_t i = 1; i < MIXER_STREAMS_MAX; i++) {
+                if (state->streams[i].state) {
+                    client_follow_codec(state, &state->streams[i].conn, state->streams[i].index, &recv.payload.ad);
+                }
+            }
+        }
+        if (recv.header.kind == SERVER_AD && state->joined && !state->remembered) {
+            known_servers_t known;
+            sc_known_servers_load(&known, KNOWN_SERVERS_PATH, KNOWN_SERVERS_MAX_AGE);
+            sc_known_servers_remember(&known, state->conn->other_addr, state->conn->group_addr,
+                state->conn->codec);
+            state->remembered = sc_known_servers_save(&known, KNOWN_SERVERS_PATH);
+        }
+        if (recv.header.kind == SERVER_AD && state->joined && state->mixer && !state->mixing) {
+            client_start_mixing(state, &recv.payload.ad);
+        }
+        else if (recv.header.kind == SERVER_CLOSE && state->joined) {
+            LOG_INFO("Server closed group %.*s", INET_ADDRSTRLEN, recv.payload.group_addr);
+            sc_event_loop_stop(state->loop);
+        }
+    }
+}
 
 int main(int argc, char *argv[]) {
+    // Log from a background writer so the event loop never blocks on output, and flush it
+    // whichever way main returns
+    sc_logger_start();
+    atexit(sc_logger_stop);
     if (argc == 1) {
         LOG_FATAL("no args");
+        return 1;
     }
     connection_t conn;
+    event_loop_t loop;
+    demo_state state = {
+        .conn = &conn,
+        .loop = &loop,
+        .audio = {
+            .header = { .kind = SERVER_AUDIO },
+            .payload = { { 0 } }
+        },
+        .audio_sequence = 0,
+        .joined = false,
+        .confirmed = false,
+        .join_pending = false,
+        .remembered = false,
+        .subscribe = false,
+        .history = NULL,
+        .join_timer = -1,
+        .source = NULL,
+        .mixer = NULL,
+        .mixing = false,
+        .mix_output = NULL,
+        .rate = NULL,
+        .mix_timer = -1,
+        .frame_timestamp = 0
+    };
+    sc_clock_sync_init(&state.clock);
+    if (!sc_event_loop_init(&loop)) {
+        LOG_FATAL("failed to create event loop");
+        return 1;
+    }
+    // `--stats [seconds]` dumps connection stats periodically, `--uring` uses io_uring,
+    // `--low-latency` tunes the client for kernel arrival times and prompt wakeups,
+    // `--record <path>` traces everything the client receives for offline replay.
+    // `--input <path|->` streams the server's audio from a WAV/raw PCM file or stdin, raw
+    // input described by `--rate <hz>`, `--channels <n>` and `--format <s16|s24|f32>`,
+    // and `--loop` repeats a file forever.
+    // `--fanout` has the server send its channel by unicast to subscribed clients instead of
+    // multicast, `--subscribe` has the client subscribe rather than join the group.
+    // `multi` hosts `--groups <n>` channels of test tones from one multi-threaded server, in
+    // the layout given by `--rate` and `--channels`.
+    // `--mix <n>` has the client play the first n advertised channels together,
+    // `--output <path>` writing the mix as raw 16 bit PCM in the joined channel's layout.
+    // Mixing clients report their reception, to which servers streaming input adapt, and
+    // NACK their losses for the server to repair.
+    uint64_t stats_interval_ns = 0;
+    uint8_t use_uring = false;
+    uint8_t low_latency = false;
+    uint8_t use_fanout = false;
+    const char *record_path = NULL;
+    const char *input_path = NULL;
+    uint32_t mix_streams = 0;
+    uint32_t multi_channels = MULTI_CHANNELS_DEFAULT;
+    const char *output_path = NULL;
+    uint8_t input_loop = false;
+    pcm_params input = {
+        .sample_rate = INPUT_DEFAULT_RATE,
+        .channels = INPUT_DEFAULT_CHANNELS,
+        .format = PCM_FORMAT_S16
+    };
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            int seconds = i + 1 < argc ? atoi(argv[i + 1]) : 0;
+            stats_interval_ns = (seconds > 0 ? seconds : 1) * NS_PER_SEC;
+        }
+        if (strcmp(argv[i], "--uring") == 0) {
+            use_uring = true;
+        }
+        if (strcmp(argv[i], "--fanout") == 0) {
+            use_fanout = true;
+        }
+        if (strcmp(argv[i], "--subscribe") == 0) {
+            state.subscribe = true;
+        }
+        if (strcmp(argv[i], "--low-latency") == 0) {
+            low_latency = true;
+        }
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--mix") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            mix_streams = (uint32_t) atoi(argv[i + 1]);
+            mix_streams = mix_streams < MIXER_STREAMS_MAX ? mix_streams : MIXER_STREAMS_MAX;
+        }
+        if (strcmp(argv[i], "--groups") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            multi_channels = (uint32_t) atoi(argv[i + 1]);
+            multi_channels = multi_channels < SERVER_CHANNELS_MAX ? multi_channels : SERVER_CHANNELS_MAX;
+        }
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--loop") == 0) {
+            input_loop = true;
+        }
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            input.sample_rate = (uint32_t) atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--channels") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            input.channels = (uint8_t) atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            if (strcmp(argv[i + 1], "s24") == 0) {
+                input.format = PCM_FORMAT_S24;
+            } else if (strcmp(argv[i + 1], "f32") == 0) {
+                input.format = PCM_FORMAT_F32;
+            } else if (strcmp(argv[i + 1], "s16") != 0) {
+                LOG_FATAL("unknown --format %s (s16, s24 or f32)", argv[i + 1]);
+                sc_event_loop_close(&loop);
+                return 1;
+            }
+        }
+    }
     if (argv[1][0] == 's') {
-        sc_socket_server_init(&conn);
-
-        datagram_t data = {
-            .header = {
-                .kind = SERVER_AUDIO,
-                .sequence = 11,
-                .timestamp = {
-                    1111111111, 111111
-                }
-            },
-            .payload = { 0 }
-        };
+        if (!sc_socket_server_init(&conn)) {
+            LOG_FATAL("failed to open server sockets");
+            sc_event_loop_close(&loop);
+            return 1;
+        }
+        if (use_uring) {
+            sc_socket_uring_init(&conn, false);
+        }
+        static fanout_t fanout;
+        if (use_fanout) {
+            if (!sc_fanout_init(&fanout, FANOUT_EXPIRY_NS)) {
+                LOG_FATAL("failed to set up unicast fan-out");
+                sc_event_loop_close(&loop);
+                sc_socket_close(&conn);
+                return 1;
+            }
+            conn.fanout = &fanout;
+        }
+        static retransmit_cache_t history;
+        sc_retransmit_cache_init(&history, REPAIR_SUPPRESS_NS);
+        state.history = &history;
+        sc_fast_join_init(&state.fast_join, conn.group_addr, JOIN_CHUNK, JOIN_INTERVAL_NS);
+        sc_event_loop_add_fd(&loop, sc_network_event_fd(&conn, true), server_on_aux, &state);
+
+        static pcm_source_t source;
+        if (input_path) {
+            if (!sc_pcm_source_open(&source, input_path, &input, input_loop)) {
+                LOG_FATAL("failed to open input %s", input_path);
+                sc_event_loop_close(&loop);
+                sc_socket_close(&conn);
+                return 1;
+            }
+            state.source = &source;
+            conn.sample_rate = source.params.sample_rate;
+            conn.channels = source.params.channels;
+            state.codec = sc_codec_get(conn.codec);
+            sc_codec_state_init(&state.codec_state);
+            // Split further if need be so every frame fits one FEC protected datagram, as clients mix them
+            state.frame_frames = (uint32_t) (source.params.sample_rate * AUDIO_FRAME_NS / NS_PER_SEC);
+            while (state.codec->encoded_size(state.frame_frames, source.params.channels)
+                > AUDIO_FRAGMENT_CAPACITY(FEC_PROTECTED_DATAGRAM_MAX)) {
+                state.frame_frames /= 2;
+            }
+            uint32_t frame_bytes = state.codec->encoded_size(state.frame_frames, source.params.channels);
+            sc_packetizer_init(&state.packetizer, frame_bytes, FEC_PROTECTED_DATAGRAM_MAX, server_emit_audio,
+                &state);
+
+            // Packets never shrink below a whole frame, which mixing clients need
+            static rate_controller_t rate;
+            rate_bounds bounds = {
+                .min_packet_size = sizeof(datagram_header) + sizeof(audio_fragment_header) + frame_bytes,
+                .max_packet_size = FEC_PROTECTED_DATAGRAM_MAX,
+                .min_fec_group = RATE_FEC_GROUP_MIN,
+                .max_fec_group = RATE_FEC_GROUP_MAX,
+                .high_codec = conn.codec,
+                .low_codec = CODEC_IMA_ADPCM,
+                .congested_jitter_us = 0
+            };
+            sc_rate_controller_init(&rate, conn.group_addr, &bounds, REPORT_TIMEOUT_NS);
+            state.rate = &rate;
+            sc_fec_encoder_init(&state.fec, rate.settings.fec_group);
+            sc_event_loop_add_timer(&loop, REPORT_INTERVAL_NS, server_adapt_rate, &state);
+            sc_pcm_source_start(&source, sc_time_now_ns());
+        }
 
         LOG_DEBUG("Server: Advertising");
-        for (int i = 0; i < 1; i++) {
-            sc_network_server_advertise(&conn);
-            LOG_DEBUG("Advertised");
-            // sleep(1);
-            sc_network_send(&conn, &data, sizeof(datagram_t));
-            LOG_DEBUG("Sent");
-            LOG_DEBUG("len: %d", sizeof(datagram_t));
+        sc_network_server_advertise(&conn);
+        sc_event_loop_add_advertiser(&loop, &conn, ADVERTISE_INTERVAL_NS);
+        sc_event_loop_add_timer(&loop, AUDIO_INTERVAL_NS, server_send_audio, &state);
+        if (!input_path) {
+            sc_event_loop_add_timer(&loop, SERVER_RUN_NS, server_stop, &state);
+        }
+        if (stats_interval_ns) {
+            sc_event_loop_add_timer(&loop, stats_interval_ns, dump_stats, &state);
         }
+        sc_event_loop_run(&loop);
+        if (conn.fanout) {
+            LOG_INFO("Server: fanned out %llu datagram copies to %llu subscribers (%llu expired)",
+                (unsigned long long) fanout.stats.sent, (unsigned long long) fanout.stats.subscribed,
+                (unsigned long long) fanout.stats.expired);
+            conn.fanout = NULL;
+            sc_fanout_destroy(&fanout);
+        }
+        LOG_INFO("Server: repaired %llu datagrams (%llu requested, %llu suppressed, %llu unavailable)",
+            (unsigned long long) history.stats.repaired, (unsigned long long) history.stats.requested,
+            (unsigned long long) history.stats.suppressed, (unsigned long long) history.stats.unavailable);
+    }
+    if (argv[1][0] == 'm') {
+        uint32_t frames = (uint32_t) (input.sample_rate * AUDIO_FRAME_NS / NS_PER_SEC);
+        const codec_t *codec = sc_codec_get(CODEC_PCM_S16);
+        // Every frame in one datagram, as mixing clients need
+        if (input.channels > CODEC_CHANNELS_MAX || frames == 0 || frames > MIXER_FRAMES_MAX
+            || codec->encoded_size(frames, input.channels) > AUDIO_FRAGMENT_CAPACITY(FEC_PROTECTED_DATAGRAM_MAX)) {
+            LOG_FATAL("unsupported tone layout (%u Hz, %d channels)", input.sample_rate, input.channels);
+            sc_event_loop_close(&loop);
+            return 1;
+        }
+        server_t *server = sc_server_create(0);
+        if (!server) {
+            LOG_FATAL("failed to create server");
+            sc_event_loop_close(&loop);
+            return 1;
+        }
+        static tone_channel tones[SERVER_CHANNELS_MAX];
+        uint64_t start_ns = sc_time_now_ns();
+        for (uint32_t i = 0; i < multi_channels; i++) {
+            tone_channel *tone = &tones[i];
+            char group[INET_ADDRSTRLEN];
+            snprintf(group, INET_ADDRSTRLEN, MULTI_GROUP_FORMAT, i + 1);
+            int32_t index = sc_server_add_channel(server, group, CODEC_PCM_S16, input.sample_rate, input.channels,
+                AUDIO_FRAME_NS, tone_send, tone);
+            if (index < 0) {
+                break;
+            }
+            tone->conn = &server->channels[index].conn;
+            tone->codec = codec;
+            sc_codec_state_init(&tone->codec_state);
+            tone->channels = input.channels;
+            tone->frames = frames;
+            tone->phase_step = (uint32_t) (((uint64_t) MULTI_TONE_HZ * (i + 1) << 32) / input.sample_rate);
+            tone->start_ns = start_ns;
+            sc_packetizer_init(&tone->packetizer, codec->encoded_size(frames, input.channels),
+                FEC_PROTECTED_DATAGRAM_MAX, tone_emit, tone);
+        }
+        if (!sc_server_start(server)) {
+            LOG_FATAL("failed to start server");
+            sc_server_destroy(server);
+            sc_event_loop_close(&loop);
+            return 1;
+        }
+        sc_server_advertise(server);
+        sc_event_loop_add_timer(&loop, ADVERTISE_INTERVAL_NS, multi_advertise, server);
+        sc_event_loop_add_timer(&loop, SERVER_RUN_NS, server_stop, &state);
+        sc_event_loop_run(&loop);
+        sc_server_destroy(server);
+        sc_event_loop_close(&loop);
+        return 0;
     }
     if (argv[1][0] == 'c') {
-        datagram_t recv;
+        // Opened first, so a bad path fails before anything else is set up
+        if (mix_streams > 0 && output_path && !(state.mix_output = fopen(output_path, "wb"))) {
+            LOG_FATAL("failed to open output %s", output_path);
+            sc_event_loop_close(&loop);
+            return 1;
+        }
         sc_socket_client_init(&conn);
-        LOG_DEBUG("Client: Receiving datagram");
-        sc_network_receive(&conn, &recv, true);
-        LOG_DEBUG("header: { %d, %d, { %d, %d } }", recv.header.kind,
-            recv.header.sequence, recv.header.timestamp.tv_sec,
-            recv.header.timestamp.tv_usec);
-        if (recv.header.kind == SERVER_AD) {
-            LOG_DEBUG("advertised group: %.*s", INET_ADDRSTRLEN, recv.payload.group_addr);
-            LOG_DEBUG("received from: %.*s", INET_ADDRSTRLEN, conn.other_addr);
-            if (sc_socket_client_join(&conn, recv.payload.group_addr)) {
-                LOG_INFO("Client joined multicast group");
+        if (low_latency) {
+            low_latency_profile profile = {
+                .buffer_depth = LOW_LATENCY_DEPTH,
+                .busy_poll_us = 0,
+                .rt_priority = LOW_LATENCY_RT_PRIORITY,
+                .cpu = -1
+            };
+            sc_low_latency_socket(&conn, &profile);
+            sc_low_latency_thread(&profile);
+        }
+        if (use_uring) {
+            sc_socket_uring_init(&conn, false);
+        }
+        static trace_recorder_t recorder;
+        if (record_path && sc_trace_recorder_open(&recorder, record_path)) {
+            conn.trace = &recorder;
+        }
+
+        // Rejoin the most recently seen server straight away; its first ad confirms the group
+        known_servers_t known;
+        sc_known_servers_load(&known, KNOWN_SERVERS_PATH, KNOWN_SERVERS_MAX_AGE);
+        // Subscribers wait for an advertisement instead, it carries the channel's layout
+        if (known.count > 0 && !state.subscribe) {
+            memcpy(conn.other_addr, known.servers[0].server_addr, INET_ADDRSTRLEN);
+            conn.codec = known.servers[0].codec;
+            if (sc_socket_client_join(&conn, known.servers[0].group_addr)) {
+                LOG_INFO("Client rejoined known group %.*s", INET_ADDRSTRLEN, conn.group_addr);
+                state.joined = true;
+                state.join_pending = true;
+            }
+        }
+        static mixer_t mixer;
+        if (mix_streams > 0) {
+            state.mixer = &mixer;
+            state.mix_streams = mix_streams;
+            state.mix_timer = sc_event_loop_add_timer(&loop, AUDIO_FRAME_NS, client_mix, &state);
+            sc_event_loop_add_timer(&loop, REPORT_INTERVAL_NS, client_report, &state);
+            sc_event_loop_add_timer(&loop, NACK_INTERVAL_NS, client_request_repairs, &state);
+        }
+        sc_event_loop_add_timer(&loop, CLOCK_PROBE_INTERVAL_NS, client_probe_clock, &state);
+        if (state.subscribe) {
+            sc_event_loop_add_timer(&loop, KEEPALIVE_INTERVAL_NS, client_keepalive, &state);
+        }
+        LOG_DEBUG("Client: Waiting for server");
+        sc_event_loop_add_fd(&loop, sc_network_event_fd(&conn, true), client_on_aux, &state);
+        sc_event_loop_add_fd(&loop, sc_network_event_fd(&conn, false), client_on_audio, &state);
+        if (stats_interval_ns) {
+            sc_event_loop_add_timer(&loop, stats_interval_ns, dump_stats, &state);
+        }
+        sc_event_loop_run(&loop);
+
+        if (state.joined && state.subscribe) {
+            datagram_t request;
+            uint32_t len = sc_fanout_build_request(&request, CLIENT_UNSUBSCRIBE, conn.group_addr,
+                sc_network_unicast_port(&conn));
+            if (sc_network_send(&conn, &request, len)) {
+                LOG_INFO("Client unsubscribed");
             }
-            sc_network_receive(&conn, &recv, false);
-            LOG_DEBUG("header: { %d, %d, { %d, %d } }", recv.header.kind,
-                recv.header.sequence, recv.header.timestamp.tv_sec,
-                recv.header.timestamp.tv_usec);
-            
-            if (sc_socket_client_leave(&conn)) {
-                LOG_INFO("Client left multicast group");
+        } else if (state.joined && sc_socket_client_leave(&conn)) {
+            LOG_INFO("Client left multicast group");
+        }
+        for (uint32_t i = 0; state.mixing && i < mixer.count; i++) {
+            LOG_INFO("Client stream %u: played %llu, concealed %llu", i,
+                (unsigned long long) mixer.streams[i].stats.played,
+                (unsigned long long) mixer.streams[i].stats.concealed);
+        }
+        for (uint32_t i = 1; state.mixing && i < MIXER_STREAMS_MAX; i++) {
+            if (state.streams[i].state) {
+                sc_socket_client_leave(&state.streams[i].conn);
+                sc_socket_close(&state.streams[i].conn);
             }
         }
-        else if (recv.header.kind == SERVER_AUDIO) {
-            LOG_DEBUG("Audio received");
+        if (state.mix_output) {
+            fclose(state.mix_output);
         }
+        if (conn.trace) {
+            LOG_INFO("Client recorded %llu datagrams to %s", (unsigned long long) recorder.header->records,
+                record_path);
+            sc_trace_recorder_close(&recorder);
+            conn.trace = NULL;
+        }
+    }
+    if (stats_interval_ns) {
+        dump_stats(&state);
+    }
+    if (state.source) {
+        sc_pcm_source_close(state.source);
     }
+    sc_event_loop_close(&loop);
     LOG_DEBUG("Closing socket");
     sc_socket_close(&conn);
 
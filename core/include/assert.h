@@ -6,6 +6,12 @@
 
 CORE_API void _assert_report_fail(const char* expr, const char *msg, const char* file_name, int32_t line);
 
+/*
+ * A compile time assertion on the constant `expr`, at file scope. `name` identifies it in
+ * the error: a false `expr` declares an array of negative size. (C99 has no _Static_assert.)
+ */
+#define CORE_STATIC_ASSERT(expr, name) typedef char _static_assert_##name[(expr) ? 1 : -1]
+
 /*
  * An assertion on `expr`. 
  * 
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+// A datagram buffer owned by a buffer_pool_t
+typedef struct {
+    datagram_t dgram;
+    uint32_t   len;    // Bytes of `dgram` filled
+    uint32_t   index;  // Position within the owning pool's slab
+} pooled_datagram;
+
+// Fixed-size pool of datagram buffers, allocated once up front.
+//
+// Free buffers are tracked as indices in a lock-free single-producer/single-consumer
+// queue, so one thread may acquire (e.g. a receive thread) while another releases
+// (e.g. a consumer) with no locking or allocation on the hot path.
+typedef struct {
+    // Acquirer owned
+    uint32_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint32_t cached_tail;
+    pooled_datagram *spare;  // Acquired then handed back unused, reused by the next acquire
+
+    // Releaser owned
+    uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    uint32_t capacity __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint32_t        *free_indices;  // `capacity` entries
+    pooled_datagram *slab;          // `capacity` buffers
+} buffer_pool_t;
+
+// Allocate a pool of `capacity` buffers. `capacity` must be a power of two.
+// Returns NULL on allocation failure.
+CORE_API buffer_pool_t *sc_buffer_pool_create(uint32_t capacity);
+
+CORE_API void sc_buffer_pool_destroy(buffer_pool_t *pool);
+
+// Take ownership of a free buffer. Returns NULL if all buffers are in use.
+CORE_API pooled_datagram *sc_buffer_pool_acquire(buffer_pool_t *pool);
+
+// Return ownership of a buffer acquired from `pool`.
+CORE_API void sc_buffer_pool_release(buffer_pool_t *pool, pooled_datagram *buffer);
+
+// Acquiring thread: hand back the buffer just acquired, left unused (e.g. nothing was
+// received into it). It is kept for the next sc_buffer_pool_acquire rather than released,
+// so the acquirer never becomes a second producer on the free queue.
+CORE_API void sc_buffer_pool_unacquire(buffer_pool_t *pool, pooled_datagram *buffer);
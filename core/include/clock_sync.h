@@ -0,0 +1,67 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+#include <netinet/in.h>  // struct sockaddr_in
+
+// Probe results kept for estimating offset and drift. Must be a power of two.
+#define CLOCK_SYNC_SAMPLES 32
+
+// Probes within this much of the smallest round trip seen are trusted. Longer round
+// trips were queued somewhere and carry an asymmetric, and so biased, offset.
+#define CLOCK_SYNC_DELAY_SLACK_NS 200000ULL
+
+// Payload of CLIENT_TIME_REQUEST and SERVER_TIME_RESPONSE, in network byte order.
+// Times are CLOCK_MONOTONIC nanoseconds of the clock named.
+typedef struct __attribute__((__packed__)) {
+    uint64_t client_send;     // t1, client clock
+    uint64_t server_receive;  // t2, server clock (response only)
+    uint64_t server_send;     // t3, server clock (response only)
+} time_probe;
+
+typedef struct {
+    uint64_t local_ns;   // Client time the probe completed (t4)
+    int64_t  offset_ns;  // Server clock minus client clock
+    uint64_t delay_ns;   // Network round trip, excluding server processing
+} clock_sample;
+
+// Client side NTP-style estimate of the server clock
+typedef struct {
+    clock_sample samples[CLOCK_SYNC_SAMPLES];
+    uint32_t count;              // Samples held (<= CLOCK_SYNC_SAMPLES)
+    uint32_t next;               // Slot the next sample is written to
+    uint64_t reference_local_ns; // Client time `offset_ns` applies at
+    int64_t  offset_ns;          // Server minus client clock at `reference_local_ns`
+    double   drift;              // Rate the offset changes per client nanosecond
+    uint8_t  synced;             // true once an estimate exists
+    uint64_t probe_send_ns;      // t1 of the probe awaiting its response, 0 if none
+} clock_sync_t;
+
+CORE_API void sc_clock_sync_init(clock_sync_t *cs);
+
+// Build a CLIENT_TIME_REQUEST in `dest`, to send to the server over the aux channel
+// with sc_network_send. Only the response to the latest request built is accepted.
+// Returns the datagram size.
+CORE_API uint32_t sc_clock_sync_build_request(clock_sync_t *cs, datagram_t *dest);
+
+// Server: answer a CLIENT_TIME_REQUEST received from `src` at `receive_ns`
+// (sc_time_now_ns, taken as close to the receive as possible).
+// Returns true if the response was sent, false otherwise.
+CORE_API uint8_t sc_clock_sync_respond(connection_t *conn, const datagram_t *request,
+    struct sockaddr_in *src, uint64_t receive_ns);
+
+// Client: fold in a SERVER_TIME_RESPONSE received at `receive_ns`, re-estimating
+// offset and drift from the trusted (lowest delay) probes. A response not echoing the
+// outstanding request (late, duplicated or forged) is ignored, as its round trip would
+// look shorter than it was and skew every estimate after it.
+// Returns true if the response was valid, false otherwise.
+CORE_API uint8_t sc_clock_sync_handle_response(clock_sync_t *cs, const datagram_t *response,
+    uint64_t receive_ns);
+
+// Client time at which the server clock reads `server_ns`. Used to schedule playout of
+// a frame stamped by the server so every client starts it at the same instant.
+CORE_API uint64_t sc_clock_sync_server_to_local(clock_sync_t *cs, uint64_t server_ns);
+
+// Server clock reading at client time `local_ns`.
+CORE_API uint64_t sc_clock_sync_local_to_server(clock_sync_t *cs, uint64_t local_ns);
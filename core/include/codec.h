@@ -0,0 +1,46 @@
+#pragma once
+
+#include "defines.h"
+
+// Most interleaved channels a codec handles
+#define CODEC_CHANNELS_MAX 8
+
+// Codecs that can be registered at once (built-in included)
+#define CODEC_REGISTRY_MAX 8
+
+typedef enum {
+    // 16 bit PCM in network byte order (uncompressed)
+    CODEC_PCM_S16 = 0,
+    // IMA-ADPCM, 4 bits per sample (~4:1 against 16 bit PCM)
+    CODEC_IMA_ADPCM = 1
+} codec_id;
+
+// Per-stream state carried between frames by a codec
+typedef struct {
+    int16_t predictor[CODEC_CHANNELS_MAX];
+    uint8_t step_index[CODEC_CHANNELS_MAX];
+} codec_state;
+
+// A codec between capture and packetization. Each encoded frame is self contained,
+// so a lost datagram never corrupts the frames after it.
+typedef struct {
+    uint8_t     id;  // codec_id, as advertised in SERVER_AD
+    const char *name;
+    // Encoded size in bytes of `frames` frames of `channels` interleaved samples
+    uint32_t (*encoded_size)(uint32_t frames, uint8_t channels);
+    // Encode `frames` interleaved frames from `pcm` into `dest`. Returns bytes written.
+    uint32_t (*encode)(codec_state *state, const int16_t *pcm, uint32_t frames, uint8_t channels,
+        uint8_t *dest);
+    // Decode `len` bytes from `src` into interleaved `pcm`. Returns frames written.
+    uint32_t (*decode)(codec_state *state, const uint8_t *src, uint32_t len, uint8_t channels,
+        int16_t *pcm);
+} codec_t;
+
+// Make `codec` available to sc_codec_get, replacing any codec with the same id.
+// Returns true if successful, false if the registry is full.
+CORE_API uint8_t sc_codec_register(const codec_t *codec);
+
+// Codec registered for `id` (codec_id), or NULL if unsupported.
+CORE_API const codec_t *sc_codec_get(uint8_t id);
+
+CORE_API void sc_codec_state_init(codec_state *state);
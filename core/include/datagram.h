@@ -0,0 +1,23 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+// 64 bit counterpart of htonl(...)/ntohl(...). Resolved at compile time.
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HTONLL(x) __builtin_bswap64(x)
+#else
+#define HTONLL(x) (x)
+#endif
+
+// Encode `src` into network byte order at `dest`, stamping the current DATAGRAM_VERSION
+// and `payload_len`. `src` and `dest` may not overlap.
+CORE_API void sc_datagram_header_encode(const datagram_header *src, uint16_t payload_len,
+    datagram_header *dest);
+
+// Decode a header received in network byte order to host byte order, in place.
+CORE_API void sc_datagram_header_decode(datagram_header *header);
+
+// Decode the header of a `len` byte datagram received in wire format, in place.
+// Returns true if it is a well-formed datagram of this version, false otherwise.
+CORE_API uint8_t sc_datagram_decode(datagram_t *dgram, uint32_t len);
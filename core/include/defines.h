@@ -12,3 +12,6 @@
 #else
 #define CORE_API
 #endif
+
+// Alignment used to keep data written by different threads on separate cache lines
+#define CACHE_LINE_SIZE 64
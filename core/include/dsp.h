@@ -0,0 +1,43 @@
+#pragma once
+
+#include "defines.h"
+
+// Instruction sets the DSP kernels are implemented for
+typedef enum {
+    DSP_ISA_SCALAR = 0,  // Portable reference implementation
+    DSP_ISA_SSE2 = 1,
+    DSP_ISA_AVX2 = 2,
+    DSP_ISA_NEON = 3
+} dsp_isa;
+
+// Float samples are in [-1.0, 1.0). All kernels produce bit-identical results on every
+// instruction set: conversions round to nearest (ties to even) and saturate, and no
+// fused multiply-adds are used. Samples must be finite.
+
+// Select the fastest instruction set the running CPU supports. Called implicitly by the
+// first kernel call if not called beforehand.
+CORE_API void sc_dsp_init(void);
+
+// Force kernels onto `isa` (e.g. the scalar reference for comparison).
+// Returns true if `isa` is supported on this CPU and build, false otherwise (unchanged).
+CORE_API uint8_t sc_dsp_set_isa(dsp_isa isa);
+
+// Instruction set currently in use.
+CORE_API dsp_isa sc_dsp_get_isa(void);
+
+// Format conversion. `count` is the number of samples.
+CORE_API void sc_dsp_s16_to_f32(const int16_t *src, float *dest, uint32_t count);
+CORE_API void sc_dsp_f32_to_s16(const float *src, int16_t *dest, uint32_t count);
+// Packed little endian 24 bit samples (3 bytes each)
+CORE_API void sc_dsp_s24_to_f32(const uint8_t *src, float *dest, uint32_t count);
+CORE_API void sc_dsp_f32_to_s24(const float *src, uint8_t *dest, uint32_t count);
+
+// Split `frames` interleaved frames of `channels` channels into one buffer per channel.
+CORE_API void sc_dsp_deinterleave_f32(const float *src, float **dest, uint8_t channels, uint32_t frames);
+// Inverse of sc_dsp_deinterleave_f32.
+CORE_API void sc_dsp_interleave_f32(const float **src, float *dest, uint8_t channels, uint32_t frames);
+
+// buffer[i] *= gain
+CORE_API void sc_dsp_gain_f32(float *buffer, float gain, uint32_t count);
+// dest[i] += src[i] * gain
+CORE_API void sc_dsp_mix_f32(float *dest, const float *src, float gain, uint32_t count);
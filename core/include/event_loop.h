@@ -0,0 +1,61 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+// Sources (sockets and timers) one loop can watch
+#define EVENT_LOOP_SOURCES_MAX 32
+
+// Called when a watched socket is readable (drain it until EAGAIN; sockets are made
+// non-blocking) or a timer fires.
+typedef void (*event_callback)(void *ctx);
+
+typedef struct {
+    int32_t        fd;
+    uint8_t        is_timer;
+    uint8_t        in_use;
+    event_callback callback;
+    void          *ctx;
+} event_source;
+
+// Single-threaded epoll/timerfd event loop (Linux). Idle loops sleep in epoll_wait,
+// using no CPU until a datagram arrives or a timer is due.
+typedef struct {
+    int32_t      epoll_fd;
+    int32_t      wake_fd;  // eventfd used by sc_event_loop_stop to interrupt epoll_wait
+    uint8_t      stopped;  // Sticky: a stop requested before run still makes run return
+    event_source sources[EVENT_LOOP_SOURCES_MAX];
+} event_loop_t;
+
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_event_loop_init(event_loop_t *loop);
+
+// Close the loop and any timers it created. Watched sockets are left open.
+CORE_API void sc_event_loop_close(event_loop_t *loop);
+
+// Watch `fd` for incoming data, switching it to non-blocking mode.
+// Returns a source id for sc_event_loop_remove, or -1 on failure.
+CORE_API int32_t sc_event_loop_add_fd(event_loop_t *loop, int32_t fd, event_callback callback, void *ctx);
+
+// Call `callback` every `interval_ns`, first after one interval.
+// Returns a source id for sc_event_loop_remove, or -1 on failure.
+CORE_API int32_t sc_event_loop_add_timer(event_loop_t *loop, uint64_t interval_ns, event_callback callback,
+    void *ctx);
+
+// Re-arm timer `id` to fire next at `at_ns` (sc_time_now_ns clock), then every interval
+// as before, e.g. to put its ticks in phase with a remote schedule.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_event_loop_align_timer(event_loop_t *loop, int32_t id, uint64_t at_ns);
+
+// Stop watching a source (closing it if it is a timer).
+CORE_API void sc_event_loop_remove(event_loop_t *loop, int32_t id);
+
+// Broadcast `conn`'s advertisement every `interval_ns`.
+// Returns a source id for sc_event_loop_remove, or -1 on failure.
+CORE_API int32_t sc_event_loop_add_advertiser(event_loop_t *loop, connection_t *conn, uint64_t interval_ns);
+
+// Dispatch callbacks until sc_event_loop_stop is called, returning at once if it already was.
+CORE_API void sc_event_loop_run(event_loop_t *loop);
+
+// Make sc_event_loop_run return. Safe to call from callbacks and from other threads.
+CORE_API void sc_event_loop_stop(event_loop_t *loop);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+#include <netinet/in.h>  // struct sockaddr_in
+#include <pthread.h>
+
+// Unicast receivers one fan-out can serve
+#define FANOUT_SUBSCRIBERS_MAX 1024
+
+// Datagrams coalesced into one UDP_SEGMENT (GSO) send. 32 * DATAGRAM_MAX_SIZE stays
+// under the 64 KiB a single UDP send can carry.
+#define FANOUT_GSO_SEGMENTS_MAX 32
+
+// Payload of CLIENT_SUBSCRIBE, CLIENT_KEEPALIVE and CLIENT_UNSUBSCRIBE
+typedef struct __attribute__((__packed__)) {
+    char     group_addr[INET_ADDRSTRLEN];  // Channel (group) to receive by unicast
+    uint16_t port;                         // Client port to send audio to, network order
+} subscription;
+
+typedef struct {
+    struct sockaddr_in addr;          // Where audio is sent
+    uint64_t           last_seen_ns;  // Last subscribe or keepalive
+} subscriber;
+
+typedef struct {
+    uint64_t subscribed;    // Subscribers added
+    uint64_t expired;       // Subscribers dropped for missed keepalives
+    uint64_t sent;          // Datagram copies sent (one per datagram per subscriber)
+    uint64_t send_errors;   // Datagram copies the kernel rejected
+    uint64_t gso_sends;     // Sends that carried several datagrams as UDP segments
+} fanout_stats;
+
+// Server side unicast replacement for a multicast group. Set as `conn->fanout` and
+// group datagrams sent from `conn` go to every subscriber instead of the group.
+// Subscribers are kept packed so a send walks a contiguous array.
+// Safe to use from one sending thread and one request handling thread.
+typedef struct fanout {
+    pthread_mutex_t lock;
+    subscriber      subscribers[FANOUT_SUBSCRIBERS_MAX];
+    uint32_t        count;
+    uint64_t        expiry_ns;       // Subscribers silent for longer are dropped
+    uint64_t        last_expire_ns;
+    uint8_t         gso_enabled;     // Cleared if the kernel refuses UDP_SEGMENT
+    fanout_stats    stats;
+} fanout_t;
+
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_fanout_init(fanout_t *fanout, uint64_t expiry_ns);
+
+CORE_API void sc_fanout_destroy(fanout_t *fanout);
+
+// Client: build a CLIENT_SUBSCRIBE, CLIENT_KEEPALIVE or CLIENT_UNSUBSCRIBE for `group`,
+// asking for audio on `port`, to send to the server with sc_network_send.
+// Returns the datagram size.
+CORE_API uint32_t sc_fanout_build_request(datagram_t *dest, uint8_t kind, const char *group, uint16_t port);
+
+// Server: apply a subscription request received from `src` at `now_ns`. Audio goes to
+// the source address at the port asked for. Subscribing again acts as a keepalive.
+// Returns true if the request was valid, false otherwise.
+CORE_API uint8_t sc_fanout_handle_request(fanout_t *fanout, const datagram_t *request,
+    struct sockaddr_in *src, uint64_t now_ns);
+
+// Drop subscribers not heard from within the expiry.
+// Returns the number dropped.
+CORE_API uint32_t sc_fanout_expire(fanout_t *fanout, uint64_t now_ns);
+
+// Send `count` datagrams to every subscriber from `socket_fd`, with one sendmmsg per
+// NETWORK_BATCH_MAX subscribers. Equal sized runs of datagrams go to each subscriber as
+// one UDP_SEGMENT send, so the per-subscriber cost is one message, not one per datagram.
+// Expired subscribers are dropped first.
+// Returns the number of datagram copies sent.
+CORE_API uint32_t sc_fanout_send(fanout_t *fanout, int32_t socket_fd, datagram_t **dgrams, uint32_t *lens,
+    uint32_t count);
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+#include "retransmit.h"
+
+#include <netinet/in.h>  // struct sockaddr_in
+
+// Joining clients served at once; further joins wait for a free slot
+#define FAST_JOIN_BURSTS_MAX 16
+
+// Most datagrams one burst sends, about what a deep jitter buffer holds. Keeps the reply
+// to a single small request bounded.
+#define FAST_JOIN_FRAMES_MAX 16
+
+// Sources remembered for rate limiting, and how often each may be answered
+#define FAST_JOIN_SOURCES_MAX 64
+#define FAST_JOIN_SOURCE_INTERVAL_NS (1000 * 1000 * 1000ULL)
+
+// Servers remembered by a client between runs
+#define KNOWN_SERVERS_MAX 8
+
+// Payload of CLIENT_JOIN, sent by a client once it receives the group it joined. The
+// server cannot see who is in a multicast group, so the client proves it is by echoing a
+// datagram it received from the group, which only members (or the server) have seen.
+typedef struct __attribute__((__packed__)) {
+    char     group_addr[INET_ADDRSTRLEN];  // Group joined
+    uint16_t port;                         // Client port to send the burst to, network order
+    uint16_t frames;                       // Recent datagrams wanted, network order
+    uint32_t sequence;                     // Of a datagram received from the group, network order
+    uint64_t timestamp;                    // Of the same datagram, network order
+} join_request;
+
+// Recent audio being unicast to one joining client
+typedef struct {
+    struct sockaddr_in addr;
+    uint32_t next_sequence;  // Next cached datagram to send
+    uint32_t end_sequence;   // One past the last datagram of the burst
+    uint64_t next_send_ns;
+    uint8_t  active;
+} join_burst;
+
+// When a source was last answered, to rate limit it
+typedef struct {
+    struct in_addr addr;
+    uint64_t       answered_ns;
+} join_source;
+
+typedef struct {
+    uint64_t joins;        // Join requests answered with a burst
+    uint64_t sent;         // Burst datagrams sent
+    uint64_t missed;       // Burst datagrams overwritten in the cache before sending
+    uint64_t rejected;     // Join requests dropped (malformed, other group, no frames, nothing cached
+                           // or no free slot)
+    uint64_t unproven;     // Join requests echoing no datagram of the group still cached
+    uint64_t limited;      // Join requests from a source answered too recently
+} fast_join_stats;
+
+// Server side: answers CLIENT_JOIN with a unicast burst of the most recent audio from a
+// retransmit cache, so a new client's jitter buffer fills immediately instead of at the
+// live rate. Bursts are paced, `chunk` datagrams every `interval_ns`, so they do not
+// overrun the client's socket buffer or shallow switch queues.
+// As a burst is far larger than the request asking for it, only requests proving group
+// membership are answered, with at most FAST_JOIN_FRAMES_MAX datagrams, and at most once
+// per FAST_JOIN_SOURCE_INTERVAL_NS per source address.
+typedef struct {
+    join_burst      bursts[FAST_JOIN_BURSTS_MAX];
+    join_source     sources[FAST_JOIN_SOURCES_MAX];
+    char            group_addr[INET_ADDRSTRLEN];  // Group the cache holds
+    uint32_t        chunk;
+    uint64_t        interval_ns;
+    fast_join_stats stats;
+} fast_join_t;
+
+// A server a client has seen, for rejoining without waiting for an advertisement
+typedef struct {
+    char     server_addr[INET_ADDRSTRLEN];
+    char     group_addr[INET_ADDRSTRLEN];
+    uint8_t  codec;
+    uint64_t seen_wall_ns;  // CLOCK_REALTIME, so it stays meaningful across restarts
+} known_server;
+
+// Most recently seen first
+typedef struct {
+    known_server servers[KNOWN_SERVERS_MAX];
+    uint32_t     count;
+} known_servers_t;
+
+// Server: answer joins of `group`, whose audio the retransmit cache passed to the other
+// calls holds.
+CORE_API void sc_fast_join_init(fast_join_t *fj, const char *group, uint32_t chunk, uint64_t interval_ns);
+
+// Client: build a CLIENT_JOIN in `dest` asking for up to `frames` recent datagrams of
+// `group`, sent to `port`, to send to the server with sc_network_send. `received` is a
+// datagram just received from the group (header in host byte order), proving membership.
+// Returns the datagram size.
+CORE_API uint32_t sc_fast_join_build_request(datagram_t *dest, const char *group, uint16_t port,
+    uint16_t frames, const datagram_t *received);
+
+// Server: start a burst of the newest cached datagrams for a CLIENT_JOIN received from
+// `src`. The first chunk is sent by the next sc_fast_join_poll.
+// Returns true if a burst was started, false otherwise.
+CORE_API uint8_t sc_fast_join_handle_request(fast_join_t *fj, retransmit_cache_t *cache,
+    const datagram_t *request, struct sockaddr_in *src, uint64_t now_ns);
+
+// Server: send every burst chunk that is due from `conn`'s aux socket. Call at least
+// every `interval_ns` while sc_fast_join_active.
+// Returns the number of datagrams sent.
+CORE_API uint32_t sc_fast_join_poll(fast_join_t *fj, retransmit_cache_t *cache, connection_t *conn,
+    uint64_t now_ns);
+
+// Returns true if any burst is still being sent, false otherwise.
+CORE_API uint8_t sc_fast_join_active(fast_join_t *fj);
+
+// Client: load the known servers file at `path`, skipping entries older than
+// `max_age_ns`. A missing file leaves `ks` empty.
+// Returns true if the file was read, false otherwise.
+CORE_API uint8_t sc_known_servers_load(known_servers_t *ks, const char *path, uint64_t max_age_ns);
+
+// Client: atomically replace the known servers file at `path` with `ks`.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_known_servers_save(const known_servers_t *ks, const char *path);
+
+// Client: record `server` (e.g. `conn->other_addr` after an advertisement) as most recently
+// seen serving `group`, dropping the least recently seen if full.
+CORE_API void sc_known_servers_remember(known_servers_t *ks, const char *server, const char *group,
+    uint8_t codec);
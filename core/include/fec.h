@@ -0,0 +1,78 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+#include "jitter_buffer.h"
+
+// Most datagrams one parity datagram can protect
+#define FEC_GROUP_MAX 32
+
+// Parity datagrams the decoder holds while waiting to use them. Must be a power of two.
+#define FEC_DECODER_PENDING 8
+
+// Leads the payload of every SERVER_FEC datagram, in network byte order
+typedef struct __attribute__((__packed__)) {
+    uint32_t base_sequence;  // Sequence of the first protected SERVER_AUDIO datagram
+    uint8_t  group_size;     // Consecutive datagrams protected, from `base_sequence`
+    uint8_t  reserved;
+    uint16_t length_xor;     // XOR of the protected payload lengths
+    uint64_t timestamp_xor;  // XOR of the protected header timestamps
+} fec_header;
+
+// Largest SERVER_AUDIO payload that can be protected, leaving room for the fec_header
+#define FEC_PROTECTED_PAYLOAD_MAX (DATAGRAM_PAYLOAD_MAX_SIZE - sizeof(fec_header))
+
+// Largest SERVER_AUDIO datagram that can be protected. A packetizer feeding an encoder
+// must be given at most this as its `packet_size`.
+#define FEC_PROTECTED_DATAGRAM_MAX (sizeof(datagram_header) + FEC_PROTECTED_PAYLOAD_MAX)
+
+// Sender side XOR parity over groups of `group_size` consecutive audio datagrams.
+// Any one lost datagram per group can be rebuilt by clients with no round trip,
+// for 1 / `group_size` extra bandwidth.
+typedef struct {
+    uint8_t    group_size;
+    uint8_t    count;          // Datagrams folded into `parity` so far
+    uint32_t   next_sequence;  // Sequence expected next to continue the group
+    uint16_t   max_len;        // Longest payload in the group
+    datagram_t parity;
+} fec_encoder_t;
+
+typedef struct {
+    datagram_t dgram;
+    uint8_t    in_use;
+} fec_pending;
+
+typedef struct {
+    uint64_t recovered;    // Datagrams rebuilt from parity
+    uint64_t unrecovered;  // Groups given up on with more than one datagram missing
+} fec_stats;
+
+typedef struct {
+    fec_pending pending[FEC_DECODER_PENDING];
+    uint32_t    next_slot;
+    uint8_t     group_size;  // Of the latest parity received, 0 before any
+    fec_stats   stats;
+} fec_decoder_t;
+
+// Initialise an encoder protecting groups of `group_size` (2 to FEC_GROUP_MAX) datagrams.
+CORE_API void sc_fec_encoder_init(fec_encoder_t *enc, uint8_t group_size);
+
+// Fold an outgoing SERVER_AUDIO datagram of `len` bytes (payload no larger than
+// FEC_PROTECTED_PAYLOAD_MAX) into the current group. Datagrams must be added in sequence
+// order; a gap restarts the group.
+// Returns the SERVER_FEC datagram to send once a group completes, with its size in
+// `parity_len`, or NULL otherwise. It stays valid until the next call.
+CORE_API datagram_t *sc_fec_encoder_add(fec_encoder_t *enc, const datagram_t *dgram, uint32_t len,
+    uint32_t *parity_len);
+
+CORE_API void sc_fec_decoder_init(fec_decoder_t *dec);
+
+// Hold a received SERVER_FEC datagram until the group it protects can be checked.
+CORE_API void sc_fec_decoder_add_parity(fec_decoder_t *dec, const datagram_t *parity, uint32_t len);
+
+// Rebuild datagrams missing from `jb` using held parity, storing any recovered into `jb`.
+// Call after each parity or audio datagram is added. Group members already played out
+// are used while `jb` still holds them, but a missing one can only be rebuilt while it is
+// ahead of playout, so `jb` should be at least a group deep. Parity for groups already
+// played out is dropped. Returns the number of datagrams recovered.
+CORE_API uint32_t sc_fec_decoder_recover(fec_decoder_t *dec, jitter_buffer_t *jb);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+// Number of datagrams the buffer can hold ahead of playout. Must be a power of two.
+#define JITTER_BUFFER_CAPACITY 64
+
+// Sequence jump, either way, taken to mean the stream restarted (e.g. a server restart
+// beginning again at 0) rather than loss or a late datagram
+#define JITTER_BUFFER_RESYNC_DISTANCE (JITTER_BUFFER_CAPACITY * 2)
+
+// Consecutive datagrams needed at such a jump before resyncing to it, so a single stray
+// datagram (e.g. a corrupt header) does not throw the buffer away (RFC 3550 A.1 probation)
+#define JITTER_BUFFER_PROBATION 3
+
+// Shift applied to the jitter estimate per arrival (1/16 gain, as in RFC 3550)
+#define JITTER_BUFFER_JITTER_SHIFT 4
+
+typedef enum {
+    // Datagram stored for playout
+    JITTER_PUSH_OK = 0,
+    // Datagram with this sequence is already buffered
+    JITTER_PUSH_DUPLICATE = 1,
+    // Datagram arrived after its sequence was played out or skipped
+    JITTER_PUSH_LATE = 2,
+    // Datagram far from the stream's sequence, dropped while a restart is unconfirmed
+    JITTER_PUSH_STRAY = 3
+} jitter_push_result;
+
+typedef enum {
+    // `dest` holds the next frame for playout
+    JITTER_POP_FRAME = 0,
+    // The next frame never arrived. The caller should conceal it.
+    JITTER_POP_MISSING = 1,
+    // Buffer is (re)filling to its target depth. Nothing to play yet.
+    JITTER_POP_BUFFERING = 2
+} jitter_pop_result;
+
+typedef struct {
+    datagram_t dgram;
+    uint32_t   len;
+    uint8_t    occupied;
+} jitter_slot;
+
+typedef struct {
+    uint64_t received;    // Datagrams stored
+    uint64_t recovered;   // Datagrams stored after being rebuilt locally
+    uint64_t played;      // Frames popped for playout
+    uint64_t duplicates;  // Datagrams dropped as already buffered
+    uint64_t late;        // Datagrams dropped as arriving after their playout
+    uint64_t missing;     // Frames not received by their playout
+    uint64_t discarded;   // Buffered frames dropped to shrink excess playout delay
+    uint64_t underruns;   // Times the buffer ran dry while playing
+    uint64_t resyncs;     // Times playout restarted at a discontinuous sequence
+    uint64_t strays;      // Datagrams dropped as far from the sequence, pending probation
+} jitter_buffer_stats;
+
+typedef struct {
+    jitter_slot slots[JITTER_BUFFER_CAPACITY];
+    uint32_t next_sequence;      // Sequence of the next frame to play out
+    uint32_t highest_sequence;   // Newest sequence stored
+    uint32_t count;              // Occupied slots
+    uint32_t target_depth;       // Frames to hold before playing, adapted to jitter
+    uint32_t min_depth;
+    uint32_t max_depth;
+    uint64_t frame_interval_ns;  // Duration of audio carried by one datagram
+    int64_t  last_transit_ns;    // Previous (arrival - sender timestamp)
+    uint64_t jitter_ns;          // Smoothed inter-arrival jitter
+    uint8_t  started;            // false until the first datagram sets `next_sequence`
+    uint8_t  playing;            // false while (re)filling to `target_depth`
+    uint8_t  has_transit;        // false until `last_transit_ns` holds a transit of this stream
+    uint32_t probation_sequence; // Sequence continuing the run of far datagrams
+    uint32_t probation_count;    // Far datagrams in that run, 0 if none
+    jitter_buffer_stats stats;
+} jitter_buffer_t;
+
+// Initialise an empty jitter buffer. Playout depth adapts within [min_depth, max_depth]
+// frames (max_depth <= JITTER_BUFFER_CAPACITY), each frame lasting `frame_interval_ns`.
+CORE_API void sc_jitter_buffer_init(jitter_buffer_t *jb, uint32_t min_depth, uint32_t max_depth,
+    uint64_t frame_interval_ns);
+
+// Store a received datagram of `len` bytes, keyed on its header sequence.
+// `arrival_ns` is the local receive time (see sc_time_now_ns) used to measure jitter.
+CORE_API jitter_push_result sc_jitter_buffer_push(jitter_buffer_t *jb, const datagram_t *dgram,
+    uint32_t len, uint64_t arrival_ns);
+
+// Pop the next frame in sequence order for playout, copying it into `dest` and its size
+// into `len` when JITTER_POP_FRAME is returned.
+CORE_API jitter_pop_result sc_jitter_buffer_pop(jitter_buffer_t *jb, datagram_t *dest, uint32_t *len);
+
+// As sc_jitter_buffer_pop, but playing out by sender timestamp rather than buffered depth:
+// pops the frame stamped `due_ns` (sender clock, within half a frame interval), holding
+// frames stamped later and dropping those stamped earlier. Lets receivers whose clocks are
+// synchronized to the sender (see clock_sync.h) play the stream at the same instant.
+CORE_API jitter_pop_result sc_jitter_buffer_pop_due(jitter_buffer_t *jb, datagram_t *dest, uint32_t *len,
+    uint64_t due_ns);
+
+// Current playout delay held in the buffer, in nanoseconds.
+CORE_API uint64_t sc_jitter_buffer_delay_ns(jitter_buffer_t *jb);
+
+// Buffered datagram with `sequence` that has not yet been played out, or NULL if it has
+// not arrived (or was already played). `len` receives its size.
+CORE_API const datagram_t *sc_jitter_buffer_peek(jitter_buffer_t *jb, uint32_t sequence, uint32_t *len);
+
+// Datagram with `sequence` still held by the buffer, buffered or already played out but not
+// yet overwritten (up to JITTER_BUFFER_CAPACITY behind), or NULL. `len` receives its size.
+// Lets repair schemes such as FEC use datagrams that have already been played.
+CORE_API const datagram_t *sc_jitter_buffer_recent(jitter_buffer_t *jb, uint32_t sequence, uint32_t *len);
+
+// Raise or lower the least playout depth, clamped to the buffer's `max_depth` (e.g. so a
+// whole FEC group is buffered before its parity arrives).
+CORE_API void sc_jitter_buffer_set_min_depth(jitter_buffer_t *jb, uint32_t min_depth);
+
+// Returns true if `sequence` is still ahead of playout, so storing it would be useful.
+CORE_API uint8_t sc_jitter_buffer_pending(jitter_buffer_t *jb, uint32_t sequence);
+
+// Drop every buffered frame and refill from the sequence after the newest stored, so
+// datagrams already in flight are dropped as late (e.g. when the stream's codec changed
+// and they can no longer be decoded).
+CORE_API void sc_jitter_buffer_flush(jitter_buffer_t *jb);
+
+// Store a datagram rebuilt locally (e.g. by FEC) rather than received. As for
+// sc_jitter_buffer_push, without feeding the jitter estimate.
+CORE_API jitter_push_result sc_jitter_buffer_push_recovered(jitter_buffer_t *jb, const datagram_t *dgram,
+    uint32_t len);
@@ -15,11 +15,56 @@ typedef enum {
     LOG_LEVEL_DEBUG = 4,
 } log_level;
 
+// Most verbose level compiled in (numeric log_level). LOG_[LEVEL] macros above it expand
+// to nothing, arguments included. e.g. build with -D LOG_LEVEL_MAX=2 to keep only
+// fatal, error and warn logging.
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX 4
+#endif
+
+// Longest formatted message kept, longer messages are truncated
+#define LOG_RECORD_MAX 240
+
+// Records the background writer can have queued. Must be a power of two.
+#define LOG_QUEUE_CAPACITY 1024
+
 // To be used indirectly with the LOG_[LEVEL] macros (e.g. LOG_ERROR).
 CORE_API void _log_output(log_level level, const char* msg, ...);
 
+// Start a background thread writing log output. Until started (and after stopping),
+// logging writes synchronously from the calling thread.
+// Once started, LOG_[LEVEL] formats into a queue slot without allocating or blocking; if
+// the queue is full the record is dropped and counted. Fatal logs are always synchronous.
+CORE_API void sc_logger_start(void);
+
+// Write out all queued records and stop the background thread.
+CORE_API void sc_logger_stop(void);
+
+// Number of records dropped because the queue was full.
+CORE_API uint64_t sc_logger_dropped(void);
+
 #define LOG_FATAL(msg, ...) _log_output(LOG_LEVEL_FATAL, msg, ##__VA_ARGS__);
+
+#if LOG_LEVEL_MAX >= 1
 #define LOG_ERROR(msg, ...) _log_output(LOG_LEVEL_ERROR, msg, ##__VA_ARGS__);
+#else
+#define LOG_ERROR(msg, ...)
+#endif
+
+#if LOG_LEVEL_MAX >= 2
 #define LOG_WARN(msg, ...)  _log_output(LOG_LEVEL_WARN,  msg, ##__VA_ARGS__);
+#else
+#define LOG_WARN(msg, ...)
+#endif
+
+#if LOG_LEVEL_MAX >= 3
 #define LOG_INFO(msg, ...)  _log_output(LOG_LEVEL_INFO,  msg, ##__VA_ARGS__);
+#else
+#define LOG_INFO(msg, ...)
+#endif
+
+#if LOG_LEVEL_MAX >= 4
 #define LOG_DEBUG(msg, ...) _log_output(LOG_LEVEL_DEBUG, msg, ##__VA_ARGS__);
+#else
+#define LOG_DEBUG(msg, ...)
+#endif
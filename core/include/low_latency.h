@@ -0,0 +1,31 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+#include <time.h>        // struct timespec
+#include <sys/socket.h>  // struct msghdr, CMSG_SPACE
+
+// Space ancillary data needs to carry a kernel arrival timestamp
+#define ARRIVAL_CONTROL_SIZE CMSG_SPACE(sizeof(struct timespec))
+
+// Opt-in tuning for receivers that want the tightest playout buffers
+typedef struct {
+    uint32_t buffer_depth;  // Datagrams the receive queue should hold (sizes SO_RCVBUF), 0 to keep the default
+    uint32_t busy_poll_us;  // SO_BUSY_POLL time, 0 to sleep normally
+    int32_t  rt_priority;   // SCHED_FIFO priority for the receive thread, 0 to keep its policy
+    int32_t  cpu;           // Core to pin the receive thread to, -1 for any
+} low_latency_profile;
+
+// Apply `profile` to the client's sockets: kernel arrival timestamps (SO_TIMESTAMPNS) on
+// both, and the receive queue size and busy polling on the audio socket.
+// Returns true if every option was applied, false otherwise (applied options stay in effect).
+CORE_API uint8_t sc_low_latency_socket(connection_t *conn, const low_latency_profile *profile);
+
+// Apply `profile`'s scheduling to the calling thread, which should be the one receiving.
+// Returns true if every setting was applied, false otherwise (e.g. no permission for RT).
+CORE_API uint8_t sc_low_latency_thread(const low_latency_profile *profile);
+
+// Arrival time (CLOCK_MONOTONIC, see sc_time_now_ns) of a datagram received with `msg`:
+// the kernel timestamp if it carries one, otherwise the current time.
+CORE_API uint64_t sc_low_latency_arrival_ns(const struct msghdr *msg);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+#include "codec.h"
+#include "jitter_buffer.h"
+#include "fec.h"
+
+// Streams one mixer can combine
+#define MIXER_STREAMS_MAX 8
+
+// Most PCM frames per mix (and per stream frame)
+#define MIXER_FRAMES_MAX 2048
+
+// Playout depth range of each stream's jitter buffer, in frames
+#define MIXER_JITTER_MIN 2
+#define MIXER_JITTER_MAX 16
+
+// Gain changes (including ducking) are ramped across this many blocks of a mix
+#define MIXER_RAMP_STEPS 8
+
+// Mixes ducking is held for after the ducking stream goes quiet, so a lost frame or a
+// pause between words does not let the ducked streams swell back up
+#define MIXER_DUCK_HOLD 25
+
+typedef struct {
+    uint64_t played;       // Frames decoded and mixed
+    uint64_t concealed;    // Frames missing at playout, mixed as silence
+    uint64_t unsupported;  // Frames dropped as fragmented or larger than a mix
+} mixer_stream_stats;
+
+typedef struct {
+    jitter_buffer_t    jb;
+    fec_decoder_t      fec;           // Rebuilds lost frames from the stream's SERVER_FEC
+    const codec_t     *codec;
+    codec_state        codec_state;
+    float              gain;
+    float              applied_gain;  // Gain of the last mix, ramped towards the target
+    uint8_t            priority;      // Active streams duck every stream of lower priority
+    datagram_t         frame;         // Popped for the mix in progress
+    uint8_t            has_frame;
+    mixer_stream_stats stats;
+} mixer_stream;
+
+typedef struct {
+    uint64_t mixes;
+    uint64_t ducked;  // Mixes in which at least one stream was ducked
+} mixer_stats;
+
+// Client side mixer of several subscribed streams into one output. Each stream has its
+// own jitter buffer, FEC decoder and codec state. A mix pops one frame from every stream, decodes it
+// and sums the streams with per-stream gain, ducking streams below the highest priority
+// currently playing. Summing, gain and conversion run on the dsp kernels.
+// Every stream carries SERVER_AUDIO frames of `frames` PCM frames in the mixer's layout
+// (sample rate and channels), each whole in one datagram (as the packetizer emits when a
+// frame fits the packet size).
+typedef struct {
+    mixer_stream streams[MIXER_STREAMS_MAX];
+    uint32_t     count;
+    uint32_t     sample_rate;
+    uint8_t      channels;
+    uint32_t     frames;
+    uint64_t     frame_interval_ns;
+    float        duck_gain;      // Gain applied on top of a ducked stream's own
+    int32_t      duck_priority;  // Priority ducking the others, -1 if none
+    uint32_t     duck_hold;      // Mixes left before ducking follows a quieter priority
+    mixer_stats  stats;
+    float        mix[MIXER_FRAMES_MAX * CODEC_CHANNELS_MAX];
+    float        scratch[MIXER_FRAMES_MAX * CODEC_CHANNELS_MAX];
+    int16_t      pcm[MIXER_FRAMES_MAX * CODEC_CHANNELS_MAX];
+} mixer_t;
+
+// Initialise an empty mixer of audio at `sample_rate` with `channels` interleaved channels,
+// each mix lasting `frame_interval_ns` (at most MIXER_FRAMES_MAX frames). Ducked streams
+// are scaled by `duck_gain` (e.g. 0.25 for -12 dB).
+// Returns true if successful, false otherwise (layout unsupported).
+CORE_API uint8_t sc_mixer_init(mixer_t *mixer, uint32_t sample_rate, uint8_t channels, uint64_t frame_interval_ns,
+    float duck_gain);
+
+// Add a stream encoded with `codec` in the given layout, mixed at `gain` with ducking
+// `priority`. Streams whose layout differs from the mixer's are refused.
+// Returns the stream index if successful, -1 otherwise.
+CORE_API int32_t sc_mixer_add_stream(mixer_t *mixer, uint8_t codec, uint32_t sample_rate, uint8_t channels,
+    float gain, uint8_t priority);
+
+// Switch stream `index` to `codec` (e.g. re-advertised after the server adapted its rate),
+// dropping the frames buffered in the old codec and restarting the decoder.
+// Returns true if successful, false otherwise (unsupported codec).
+CORE_API uint8_t sc_mixer_set_codec(mixer_t *mixer, int32_t index, uint8_t codec);
+
+// Change the gain of stream `index`. The change is ramped over the next mix.
+CORE_API void sc_mixer_set_gain(mixer_t *mixer, int32_t index, float gain);
+
+// Store a datagram received for stream `index` (host order header, as returned by
+// sc_network_receive) that arrived at `arrival_ns`, rebuilding lost audio from SERVER_FEC.
+// Datagrams of other kinds are ignored.
+CORE_API void sc_mixer_push(mixer_t *mixer, int32_t index, const datagram_t *dgram, uint32_t len,
+    uint64_t arrival_ns);
+
+// Mix the next frame of every stream into `out` (`frames` interleaved frames), silence
+// if nothing is playing.
+// Returns the number of streams that contributed audio.
+CORE_API uint32_t sc_mixer_mix(mixer_t *mixer, int16_t *out);
+
+// As sc_mixer_mix, but mixing every stream's frame stamped `due_ns` on the sender's clock
+// (see sc_jitter_buffer_pop_due), so synchronized clients play in step. 0 mixes as
+// sc_mixer_mix.
+CORE_API uint32_t sc_mixer_mix_due(mixer_t *mixer, int16_t *out, uint64_t due_ns);
@@ -2,22 +2,53 @@
 
 #include "defines.h"
 #include "types.h"
+#include "buffer_pool.h"
 
 #define MULTICAST_TEMP_GROUP "224.0.0.1"
 #define MULTICAST_TEMP_PORT 6000
 #define BROADCAST_TEMP_PORT 6001
 #define UNICAST_TEMP_PORT 6002
 
+// Maximum number of datagrams moved by one batched send/receive call
+#define NETWORK_BATCH_MAX 64
+
 // Initialise server sockets
-CORE_API void sc_socket_server_init(connection_t *conn);
+// Returns true if successful, false otherwise (e.g. the server port is in use).
+CORE_API uint8_t sc_socket_server_init(connection_t *conn);
+
+// Initialise the multicast socket of one channel of a multi-channel server, sending to
+// `group` with its own sequence space. The channel has no aux socket of its own.
+CORE_API void sc_socket_channel_init(connection_t *conn, const char *group, uint8_t codec, uint32_t sample_rate,
+    uint8_t channels);
 
 // Initialise client aux socket
 CORE_API void sc_socket_client_init(connection_t *conn);
 
+// Initialise the multicast socket of one more stream for a client, joined to channel
+// `index` of advertisement `ad` with its own sequence space and stats, so a client can
+// play several groups at once (see mixer.h). The stream's aux socket is a unicast socket
+// on a port of its own (see sc_network_unicast_port), from which its requests are sent.
+// Returns true if successful, false otherwise (the stream is left closed).
+CORE_API uint8_t sc_socket_client_stream_init(connection_t *conn, const connection_t *client, const advertisement *ad,
+    uint8_t index);
+
+// Move an initialised connection onto the io_uring backend: receives stay armed in the
+// kernel and sends are queued, so a busy connection makes few syscalls per datagram.
+// With `sqpoll` a kernel thread submits sends (no syscall, but a busy core). Falls back
+// to plain socket calls if io_uring is unavailable. Paced and fan-out sends always use
+// socket calls. Event loops must watch sc_network_event_fd, not the sockets. Threads
+// using the connection must be stopped before it is closed.
+// Returns true if io_uring is in use, false otherwise.
+CORE_API uint8_t sc_socket_uring_init(connection_t *conn, uint8_t sqpoll);
+
 // Join a multicast group, storing the address in `conn` on success.
 // Returns true if successful, false otherwise.
 CORE_API uint8_t sc_socket_client_join(connection_t *conn, char multicast_group[INET_ADDRSTRLEN]);
 
+// Join channel `index` of a received advertisement, storing its group and codec in `conn`.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_socket_client_join_channel(connection_t *conn, const advertisement *ad, uint8_t index);
+
 // Leave a multicast group, clearing the stored group address from `conn` on success.
 // Returns true if successful, false otherwise.
 CORE_API uint8_t sc_socket_client_leave(connection_t *conn);
@@ -25,15 +56,75 @@ CORE_API uint8_t sc_socket_client_leave(connection_t *conn);
 // Shutdown server/client sockets
 CORE_API void sc_socket_close(connection_t *conn);
 
-// Broadcast server availability.
+// Broadcast server availability, advertising the group address and `conn->codec`.
 // Returns true if successful, false otherwise.
 CORE_API uint8_t sc_network_server_advertise(connection_t *conn);
 
+// Broadcast one advertisement listing `count` (<= ADVERTISEMENT_CHANNELS_MAX) channels.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_network_advertise_channels(connection_t *conn, const advertised_channel *channels, uint8_t count);
+
 // Send a datagram. Unicast, multicast, or broadcast based on `conn` and `dragm` header.
 // Returns true if successful, false otherwise.
 CORE_API uint8_t sc_network_send(connection_t *conn, datagram_t *dgram, uint32_t len);
 
-// Receive a datagram via multicast (audio) socket or aux socket per `aux` param.
-// If a SERVER_AD is received, the datagrams source IP address is stored in `conn`.
+// Receive a datagram via multicast (audio) socket or aux socket per `aux` param. Malformed
+// datagrams are counted as invalid and skipped, so false means none was received.
+// If a SERVER_AD is received, the datagrams source IP address and the codec of its first channel are stored in `conn`.
 // Returns true if successful, false otherwise.
 CORE_API uint8_t sc_network_receive(connection_t *conn, datagram_t *dest, uint8_t aux);
+
+// Receive a datagram as in sc_network_receive, also storing the sender's address in `src`.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_network_receive_from(connection_t *conn, datagram_t *dest, uint8_t aux, struct sockaddr_in *src);
+
+// Receive a datagram as in sc_network_receive_from, also storing when it arrived in
+// `arrival_ns` (CLOCK_MONOTONIC, see sc_time_now_ns): the kernel timestamp if enabled
+// with sc_low_latency_socket, otherwise the time the receive returned.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_network_receive_timed(connection_t *conn, datagram_t *dest, uint8_t aux, struct sockaddr_in *src,
+    uint64_t *arrival_ns);
+
+// Send a datagram on the aux socket directly to `addr`, e.g. a reply to a client request.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_network_send_to(connection_t *conn, datagram_t *dgram, uint32_t len, struct sockaddr_in *addr);
+
+// Receive a datagram as in sc_network_receive, with the kernel writing directly into a
+// slot acquired from `pool`. Ownership of the slot passes to the caller, who must return
+// it with sc_buffer_pool_release.
+// Returns the filled slot if successful, NULL otherwise (including pool exhaustion).
+CORE_API pooled_datagram *sc_network_receive_pooled(connection_t *conn, buffer_pool_t *pool, uint8_t aux);
+
+// Send `count` (<= NETWORK_BATCH_MAX) datagrams, routed per datagram as in sc_network_send,
+// using one sendmmsg call per run of datagrams sharing a destination.
+// `results[i]` is set to true if `dgrams[i]` was sent, false otherwise.
+// Returns the number of datagrams sent.
+CORE_API uint32_t sc_network_send_batch(connection_t *conn, datagram_t **dgrams, uint32_t *lens,
+    uint8_t *results, uint32_t count);
+
+// Receive up to `count` (<= NETWORK_BATCH_MAX) datagrams with one recvmmsg call, blocking
+// until at least one arrives. Datagrams are received directly into `dests`.
+// `lens[i]` is set to the size of `dests[i]`, or 0 if it was invalid and should be skipped.
+// Returns the number of `dests` entries written.
+CORE_API uint32_t sc_network_receive_batch(connection_t *conn, datagram_t *dests, uint32_t *lens,
+    uint32_t count, uint8_t aux);
+
+// Receive as sc_network_receive_batch, also storing when each datagram arrived in
+// `arrivals` as in sc_network_receive_timed.
+// Returns the number of `dests` entries written.
+CORE_API uint32_t sc_network_receive_batch_timed(connection_t *conn, datagram_t *dests, uint32_t *lens,
+    uint64_t *arrivals, uint32_t count, uint8_t aux);
+
+// File descriptor to watch (e.g. with sc_event_loop_add_fd) for datagrams arriving on the
+// aux or audio socket per `aux`: the socket itself, or its ring with io_uring.
+CORE_API int32_t sc_network_event_fd(connection_t *conn, uint8_t aux);
+
+// Client: port at which unicast audio for `conn`'s group (a join burst, fan-out) reaches
+// it, in host order: the group port on a client's first stream, the stream's own unicast
+// port on further streams, so each stream gets only its own audio.
+// Returns the port, 0 if it could not be found.
+CORE_API uint16_t sc_network_unicast_port(connection_t *conn);
+
+// Copy `conn`'s counters and histograms into `dest` without pausing senders or receivers.
+// Counters are read individually, so a snapshot taken mid-update may be off by in-flight packets.
+CORE_API void sc_connection_stats_snapshot(connection_t *conn, connection_stats *dest);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "defines.h"
+
+#include <sys/socket.h>  // struct msghdr
+
+typedef enum {
+    PACING_AUTO = 0,   // SO_TXTIME if the kernel accepts it and fq is the default qdisc, else sleep
+    PACING_TXTIME = 1, // Kernel releases each datagram at its time (needs the fq qdisc on the interface)
+    PACING_SLEEP = 2   // Sending thread sleeps until each datagram's time
+} pacing_mode;
+
+typedef struct {
+    uint64_t paced;     // Datagrams given a release time
+    uint64_t delayed;   // Datagrams held back behind an earlier one
+    uint64_t slept_ns;  // Time the sending thread spent sleeping (PACING_SLEEP)
+} pacing_stats;
+
+// Spaces datagrams sent on one socket at least `gap_ns` apart, so a frame split into
+// several datagrams leaves as an even stream instead of a burst that shallow AP queues
+// drop the tail of. Datagrams are never scheduled before the current time, so a sender
+// that falls behind does not catch up with a burst. Set as `conn->pacer` to pace group
+// datagrams sent from `conn`; used from one sending thread.
+typedef struct pacer {
+    uint8_t      mode;     // PACING_TXTIME or PACING_SLEEP once initialised
+    uint64_t     gap_ns;
+    uint64_t     next_ns;  // Earliest release time for the next datagram
+    pacing_stats stats;
+} pacer_t;
+
+// Space ancillary data needs to carry a release time
+#define PACING_CONTROL_SIZE CMSG_SPACE(sizeof(uint64_t))
+
+// Initialise a pacer for `socket_fd`, enabling SO_TXTIME on it if `mode` asks for it.
+// PACING_TXTIME falls back to PACING_SLEEP if the kernel refuses SO_TXTIME.
+CORE_API void sc_pacer_init(pacer_t *pacer, int32_t socket_fd, pacing_mode mode, uint64_t gap_ns);
+
+// Release time (CLOCK_MONOTONIC, see sc_time_now_ns) of the next datagram.
+CORE_API uint64_t sc_pacer_next(pacer_t *pacer);
+
+// Prepare the next datagram of `msg` for release: attach its release time as SCM_TXTIME
+// ancillary data in `control` (PACING_CONTROL_SIZE bytes), or sleep until it is due.
+CORE_API void sc_pacer_schedule(pacer_t *pacer, struct msghdr *msg, uint8_t *control);
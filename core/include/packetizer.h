@@ -0,0 +1,106 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+// Largest audio frame the reassembler can rebuild, in bytes
+#define AUDIO_FRAME_MAX_BYTES 16384
+
+// Frames the reassembler keeps in flight at once. Must be a power of two.
+#define REASSEMBLER_FRAMES 8
+
+// Frame index jump back taken to mean the stream restarted (e.g. a server restart
+// beginning again at 0) rather than a late fragment of a frame already finished
+#define REASSEMBLER_RESYNC_DISTANCE 1024
+
+// Leads the payload of every SERVER_AUDIO datagram, in network byte order.
+// A frame is split into `fragment_count` fragments, each `fragment_size` bytes except
+// the last, so fragment `i` starts at byte `i * fragment_size` of the frame.
+typedef struct __attribute__((__packed__)) {
+    uint32_t frame;           // Frame index within the stream
+    uint8_t  fragment;        // Fragment index within the frame
+    uint8_t  fragment_count;  // Fragments making up the frame (<= 64)
+    uint16_t fragment_size;   // Audio bytes per (non-final) fragment
+} audio_fragment_header;
+
+// Audio bytes that fit in one datagram of `packet_size` bytes
+#define AUDIO_FRAGMENT_CAPACITY(packet_size) \
+    ((packet_size) - sizeof(datagram_header) - sizeof(audio_fragment_header))
+
+// Called for every datagram the packetizer completes. `dgram` is only valid for the call.
+typedef void (*packetizer_emit_fn)(datagram_t *dgram, uint32_t len, void *ctx);
+
+typedef struct {
+    uint32_t frame_bytes;    // PCM bytes per frame
+    uint32_t packet_size;    // Datagram bytes per full fragment (<= DATAGRAM_MAX_SIZE)
+    uint16_t fragment_size;  // Audio bytes per full fragment
+    uint8_t  fragment_count;
+    uint32_t frame;          // Index of the frame being filled
+    uint32_t frame_offset;   // Bytes of the current frame filled so far
+    uint32_t sequence;       // Next datagram sequence
+    uint64_t timestamp_ns;   // Stamped on the frame's datagrams, 0 to stamp their send time
+    datagram_t dgram;        // Fragment being filled, written into directly from input
+    packetizer_emit_fn emit;
+    void *emit_ctx;
+} packetizer_t;
+
+typedef struct {
+    uint32_t frame;
+    uint32_t len;
+    uint8_t  fragment_count;
+    uint16_t fragment_size;     // Every fragment of the frame must agree on the layout
+    uint64_t received_mask;     // Bit per fragment received
+    uint64_t first_arrival_ns;
+    uint8_t  in_use;            // Frame being rebuilt
+    uint8_t  finished;          // Frame completed or timed out, its later fragments are stale
+    uint8_t  data[AUDIO_FRAME_MAX_BYTES];
+} reassembly_slot;
+
+typedef struct {
+    uint64_t completed;   // Frames rebuilt
+    uint64_t incomplete;  // Frames discarded after timing out with fragments missing
+    uint64_t invalid;     // Fragments rejected as malformed or disagreeing with their frame's layout
+    uint64_t stale;       // Fragments of frames already finished or superseded
+} reassembler_stats;
+
+typedef struct {
+    reassembly_slot slots[REASSEMBLER_FRAMES];
+    uint64_t timeout_ns;
+    reassembler_stats stats;
+} reassembler_t;
+
+// Initialise a packetizer splitting a PCM stream into `frame_bytes` frames
+// (<= AUDIO_FRAME_MAX_BYTES), sent as SERVER_AUDIO datagrams of at most `packet_size`
+// bytes. Smaller packets lower the latency per datagram at the cost of more packets per
+// second. Each completed datagram is passed to `emit` along with `ctx`.
+CORE_API void sc_packetizer_init(packetizer_t *pkt, uint32_t frame_bytes, uint32_t packet_size,
+    packetizer_emit_fn emit, void *ctx);
+
+// Change the frame and packet sizes (as for sc_packetizer_init) from the next frame on,
+// keeping the stream's sequence and frame numbering. No frame may be partly pushed.
+CORE_API void sc_packetizer_reconfigure(packetizer_t *pkt, uint32_t frame_bytes, uint32_t packet_size);
+
+// Stamp the datagrams of frames pushed from now on with `timestamp_ns` (e.g. the frame's
+// media time, see sc_pcm_source_due_ns) instead of their send time, so receivers can
+// schedule playout by it. Set before each frame; 0 goes back to the send time.
+CORE_API void sc_packetizer_set_timestamp(packetizer_t *pkt, uint64_t timestamp_ns);
+
+// Append `len` bytes of PCM to the stream, emitting datagrams as fragments fill.
+CORE_API void sc_packetizer_push(packetizer_t *pkt, const uint8_t *pcm, uint32_t len);
+
+// Complete any partially filled frame, padding it with silence, and emit its fragments.
+CORE_API void sc_packetizer_flush(packetizer_t *pkt);
+
+// Initialise a reassembler that discards frames still incomplete `timeout_ns` after
+// their first fragment arrived.
+CORE_API void sc_reassembler_init(reassembler_t *ra, uint64_t timeout_ns);
+
+// Add a received SERVER_AUDIO datagram (host byte order header, as returned by
+// sc_network_receive). `now_ns` is the current sc_time_now_ns time.
+// Returns the rebuilt frame if this fragment completed it, NULL otherwise. The frame
+// stays valid until the next call.
+CORE_API const reassembly_slot *sc_reassembler_push(reassembler_t *ra, const datagram_t *dgram,
+    uint64_t now_ns);
+
+// Discard frames that have been incomplete for longer than the timeout.
+CORE_API void sc_reassembler_expire(reassembler_t *ra, uint64_t now_ns);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "defines.h"
+#include "codec.h"
+
+// Most frames one sc_pcm_source_read can return
+#define PCM_SOURCE_FRAMES_MAX 4096
+
+// Sample formats a source can read, all little endian and interleaved
+typedef enum {
+    PCM_FORMAT_S16 = 0,
+    PCM_FORMAT_S24 = 1,  // Packed, 3 bytes per sample
+    PCM_FORMAT_F32 = 2
+} pcm_format;
+
+typedef struct {
+    uint32_t   sample_rate;
+    uint8_t    channels;
+    pcm_format format;
+} pcm_params;
+
+typedef struct {
+    uint64_t frames;     // Frames read
+    uint64_t zero_copy;  // Reads served straight from the mapped file
+    uint64_t underruns;  // Reads a pipe could not fill in time
+    uint64_t resyncs;    // Times the schedule restarted after falling behind
+} pcm_source_stats;
+
+// Linux audio input: a WAV or raw PCM file, mapped and read in place, or a pipe such as
+// stdin (e.g. a decoder process writing raw PCM). Reads yield interleaved 16 bit samples in
+// host order, ready for a codec, and are paced to real time against the monotonic clock.
+typedef struct {
+    int32_t          fd;
+    int32_t          fd_flags;      // File status flags to restore on close, -1 if untouched
+    const uint8_t   *map;           // Whole file, NULL when reading a pipe
+    uint64_t         map_size;
+    uint64_t         data_start;    // Offset of the first sample in the file
+    uint64_t         data_end;
+    uint64_t         offset;        // Next sample to read in the file
+    uint8_t          loop;          // Restart files at their end instead of finishing
+    uint8_t          eof;
+    pcm_params       params;
+    uint32_t         frame_bytes;   // Input bytes per frame
+    uint32_t         pending;       // Pipe bytes buffered towards the next read
+    uint64_t         start_ns;      // When frame 0 was due
+    uint64_t         scheduled;     // Frames accounted for by the schedule since `start_ns`
+    pcm_source_stats stats;
+    uint8_t          buffer[PCM_SOURCE_FRAMES_MAX * CODEC_CHANNELS_MAX * 4];
+    float            f32[PCM_SOURCE_FRAMES_MAX * CODEC_CHANNELS_MAX];
+    int16_t          s16[PCM_SOURCE_FRAMES_MAX * CODEC_CHANNELS_MAX];
+} pcm_source_t;
+
+// Open `path` ("-" for stdin). WAV input (RIFF header) describes itself; anything else is
+// raw PCM laid out as `params`. With `loop` files repeat forever.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_pcm_source_open(pcm_source_t *src, const char *path, const pcm_params *params, uint8_t loop);
+
+CORE_API void sc_pcm_source_close(pcm_source_t *src);
+
+// Start the real-time schedule: frame 0 is due at `now_ns`.
+CORE_API void sc_pcm_source_start(pcm_source_t *src, uint64_t now_ns);
+
+// Frames due by `now_ns` that have not yet been read. A source left more than a second
+// behind (e.g. a stalled pipe) restarts its schedule rather than bursting to catch up.
+CORE_API uint32_t sc_pcm_source_due(pcm_source_t *src, uint64_t now_ns);
+
+// When the next frame to be read was due on the schedule (sc_time_now_ns clock), e.g. to
+// stamp it with its media time rather than the time it happens to be sent.
+CORE_API uint64_t sc_pcm_source_due_ns(pcm_source_t *src);
+
+// Sleep until `frames` more frames are due, for callers not driven by an event loop.
+CORE_API void sc_pcm_source_wait(pcm_source_t *src, uint32_t frames);
+
+// Read the next `frames` frames (<= PCM_SOURCE_FRAMES_MAX), pointing `pcm` at them. The
+// samples stay valid until the next call. From a file of 16 bit samples they are read in
+// place. A pipe that has not yet delivered all `frames` returns 0 without blocking.
+// Returns the frames read: `frames`, or fewer (possibly 0) at the end of the input.
+CORE_API uint32_t sc_pcm_source_read(pcm_source_t *src, uint32_t frames, const int16_t **pcm);
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+#include "jitter_buffer.h"
+
+#include <netinet/in.h>  // struct sockaddr_in
+
+// Receivers whose reports one group controller aggregates
+#define RATE_CONTROL_RECEIVERS_MAX 64
+
+// Loss fractions (in 1/256, as in RTCP) that drive adaptation
+#define RATE_CONTROL_LOSS_CONGESTED 26  // ~10%: cut bitrate
+#define RATE_CONTROL_LOSS_LOSSY 5       // ~2%: add protection
+#define RATE_CONTROL_LOSS_CLEAN 1       // ~0.4%: below this an interval counts as clean
+
+// Consecutive clean intervals before protection is relaxed one step, and before a
+// higher bitrate codec is tried again
+#define RATE_CONTROL_CLEAN_TO_RELAX 3
+#define RATE_CONTROL_CLEAN_TO_UPGRADE 10
+
+// Payload of CLIENT_REPORT, in network byte order
+typedef struct __attribute__((__packed__)) {
+    char     group_addr[INET_ADDRSTRLEN];
+    uint8_t  loss_fraction;     // Lost / expected since the previous report, in 1/256
+    uint8_t  reserved;
+    uint16_t buffer_ms;         // Playout delay held in the jitter buffer
+    uint32_t jitter_us;         // Smoothed inter-arrival jitter
+    uint32_t highest_sequence;  // Newest sequence received
+} receiver_report;
+
+// Client side state carried between reports
+typedef struct {
+    uint32_t last_highest;
+    uint64_t last_received;
+    uint64_t last_resyncs;   // Jitter buffer resyncs at the previous report
+    uint8_t  started;
+} report_builder_t;
+
+// Limits the server may adapt within
+typedef struct {
+    uint32_t min_packet_size;  // Datagram bytes
+    uint32_t max_packet_size;
+    uint8_t  min_fec_group;    // Smallest FEC group: most overhead (1 / group)
+    uint8_t  max_fec_group;    // Largest FEC group: least overhead
+    uint8_t  high_codec;       // Codec used while links are clean (e.g. CODEC_PCM_S16)
+    uint8_t  low_codec;        // Lower bitrate codec used under congestion (e.g. CODEC_IMA_ADPCM)
+    uint32_t congested_jitter_us;  // Jitter treated as queueing on a congested link
+} rate_bounds;
+
+// Sender settings chosen by the controller
+typedef struct {
+    uint32_t packet_size;
+    uint8_t  fec_group;
+    uint8_t  codec;
+} rate_settings;
+
+typedef struct {
+    uint32_t addr;          // Receiver IPv4 address, network order
+    uint16_t port;
+    uint8_t  loss_fraction;
+    uint16_t buffer_ms;
+    uint32_t jitter_us;
+    uint64_t received_ns;
+} receiver_state;
+
+typedef struct {
+    uint64_t reports;    // Reports accepted
+    uint64_t decreases;  // Steps towards lower bitrate or more protection
+    uint64_t increases;  // Steps back towards higher bitrate or less protection
+} rate_control_stats;
+
+// Server side per group controller. Aggregates the worst fresh receiver report each
+// interval and steps settings AIMD style: congestion switches to the low bitrate codec
+// and halves the FEC group at once; moderate loss shrinks packets and adds FEC; a run of
+// clean intervals relaxes one step at a time.
+typedef struct {
+    char               group_addr[INET_ADDRSTRLEN];
+    rate_bounds        bounds;
+    rate_settings      settings;
+    receiver_state     receivers[RATE_CONTROL_RECEIVERS_MAX];
+    uint32_t           receiver_count;
+    uint64_t           report_timeout_ns;  // Receivers silent this long are forgotten
+    uint32_t           clean_intervals;
+    rate_control_stats stats;
+} rate_controller_t;
+
+// Client: initialise report state.
+CORE_API void sc_report_builder_init(report_builder_t *builder);
+
+// Client: build a CLIENT_REPORT in `dest` for `group` from `jb` covering the time since
+// the previous report, to send to the server with sc_network_send.
+// Returns the datagram size.
+CORE_API uint32_t sc_receiver_report_build(report_builder_t *builder, jitter_buffer_t *jb,
+    const char *group, datagram_t *dest);
+
+// Server: initialise a controller for `group`, starting at the least protected, highest
+// quality settings within `bounds`.
+CORE_API void sc_rate_controller_init(rate_controller_t *rc, const char *group, const rate_bounds *bounds,
+    uint64_t report_timeout_ns);
+
+// Server: record a CLIENT_REPORT from `src`.
+// Returns true if the report was for this group and valid, false otherwise.
+CORE_API uint8_t sc_rate_controller_handle_report(rate_controller_t *rc, const datagram_t *report,
+    struct sockaddr_in *src, uint64_t now_ns);
+
+// Server: adapt `rc->settings` to the reports received. Call once per report interval.
+// Apply changed settings to the packetizer and FEC encoder, and re-advertise after a
+// codec change so receivers decode with the new codec.
+// Returns true if the settings changed, false otherwise.
+CORE_API uint8_t sc_rate_controller_update(rate_controller_t *rc, uint64_t now_ns);
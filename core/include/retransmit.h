@@ -0,0 +1,79 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+#include "jitter_buffer.h"
+
+#include <netinet/in.h>  // INET_ADDRSTRLEN
+
+// Datagrams the server keeps available for repair. Must be a power of two.
+#define RETRANSMIT_CACHE_CAPACITY 256
+
+// Missing ranges one CLIENT_NACK can carry
+#define NACK_ENTRIES_MAX 16
+
+// One missing range, in network byte order. Bit `i` of `bitmap` set means
+// `base_sequence + 1 + i` is missing as well.
+typedef struct __attribute__((__packed__)) {
+    uint32_t base_sequence;
+    uint32_t bitmap;
+} nack_entry;
+
+// Payload of a CLIENT_NACK datagram. The group tells apart the sequence spaces of a
+// server's channels, whose clients all NACK to its one aux socket.
+typedef struct __attribute__((__packed__)) {
+    char       group_addr[INET_ADDRSTRLEN];
+    uint8_t    count;
+    nack_entry entries[NACK_ENTRIES_MAX];
+} nack_payload;
+
+typedef struct {
+    datagram_t dgram;
+    uint32_t   len;
+    uint64_t   last_repair_ns;  // When this datagram was last re-multicast (0 if never)
+} retransmit_entry;
+
+typedef struct {
+    uint64_t requested;    // Sequences asked for across all NACKs
+    uint64_t repaired;     // Datagrams re-multicast
+    uint64_t suppressed;   // Requests merged into a recent repair of the same datagram
+    uint64_t unavailable;  // Requests for datagrams no longer (or never) cached
+} retransmit_stats;
+
+// Server side ring of recently sent group datagrams, indexed by sequence
+typedef struct {
+    retransmit_entry entries[RETRANSMIT_CACHE_CAPACITY];
+    uint64_t suppress_ns;
+    uint32_t newest_sequence;  // Highest sequence stored, valid once `stored` is set
+    uint8_t  stored;
+    retransmit_stats stats;
+} retransmit_cache_t;
+
+// Client side record of which sequences were recently NACKed, to pace re-requests
+typedef struct {
+    uint32_t sequences[JITTER_BUFFER_CAPACITY];
+    uint64_t sent_ns[JITTER_BUFFER_CAPACITY];
+    uint64_t retry_ns;
+} nack_tracker_t;
+
+// Initialise an empty cache. Requests for a datagram repaired less than `suppress_ns`
+// ago (e.g. the same loss NACKed by many clients) are answered by that one repair.
+CORE_API void sc_retransmit_cache_init(retransmit_cache_t *cache, uint64_t suppress_ns);
+
+// Remember a SERVER_AUDIO datagram of `len` bytes after it has been sent.
+CORE_API void sc_retransmit_cache_store(retransmit_cache_t *cache, const datagram_t *dgram, uint32_t len);
+
+// Re-multicast the cached datagrams requested by a received CLIENT_NACK on `conn`. NACKs
+// for a group other than `conn`'s are ignored.
+// Returns the number of datagrams resent.
+CORE_API uint32_t sc_retransmit_cache_handle_nack(retransmit_cache_t *cache, connection_t *conn,
+    const datagram_t *nack, uint64_t now_ns);
+
+// Initialise a tracker that re-requests a still missing sequence after `retry_ns`.
+CORE_API void sc_nack_tracker_init(nack_tracker_t *tracker, uint64_t retry_ns);
+
+// Build a CLIENT_NACK in `dest` for gaps in `jb`, the buffer of multicast `group`, between
+// playout and the newest datagram, skipping sequences NACKed within the retry interval.
+// Returns the datagram size if there is anything to request, 0 otherwise.
+CORE_API uint32_t sc_nack_build(nack_tracker_t *tracker, jitter_buffer_t *jb, const char *group,
+    datagram_t *dest, uint64_t now_ns);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+#include <pthread.h>
+
+// Number of datagram slots in a ring. Must be a power of two.
+#define RING_CAPACITY 256
+
+// Lock-free single-producer/single-consumer ring of datagram slots.
+//
+// The producer fills slots in place and publishes them with a release store of `head`;
+// the consumer reads them in place and hands them back with a release store of `tail`.
+// Each index lives on its own cache line, next to the owning thread's cached copy of
+// the other index, so neither thread writes to a line the other is polling.
+typedef struct {
+    // Producer owned
+    uint32_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint32_t cached_tail;
+    uint64_t dropped;  // Datagrams discarded because the ring was full, updated atomically
+
+    // Consumer owned
+    uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint32_t cached_head;
+
+    // A slot with len 0 holds an invalid datagram and should be skipped by the consumer
+    uint32_t   lens[RING_CAPACITY] __attribute__((aligned(CACHE_LINE_SIZE)));
+    datagram_t dgrams[RING_CAPACITY];
+} ring_t;
+
+typedef struct {
+    pthread_t     thread;
+    connection_t *conn;
+    ring_t       *ring;
+    uint8_t       running;
+} ring_receiver_t;
+
+// Allocate an empty, cache line aligned ring. Returns NULL on allocation failure.
+CORE_API ring_t *sc_ring_create(void);
+
+CORE_API void sc_ring_destroy(ring_t *ring);
+
+// Producer: number of contiguous free slots starting at the returned index (may be 0).
+// `index` receives the slot index to write to.
+CORE_API uint32_t sc_ring_producer_reserve(ring_t *ring, uint32_t *index);
+
+// Producer: publish `count` slots written since the last commit.
+CORE_API void sc_ring_producer_commit(ring_t *ring, uint32_t count);
+
+// Consumer: next filled slot, or NULL if the ring is empty.
+// `len` receives the datagram length (0 if invalid).
+CORE_API datagram_t *sc_ring_consumer_peek(ring_t *ring, uint32_t *len);
+
+// Consumer: hand the slot returned by sc_ring_consumer_peek back to the producer.
+CORE_API void sc_ring_consumer_release(ring_t *ring);
+
+// Start a thread receiving from `conn`'s audio socket into `ring` (as its producer),
+// batching with recvmmsg directly into free slots. When the ring is full, datagrams are
+// drained from the socket and counted in `ring->dropped` instead of stalling the kernel.
+// Returns true if the thread was started, false otherwise.
+CORE_API uint8_t sc_ring_receiver_start(ring_receiver_t *rx, connection_t *conn, ring_t *ring);
+
+// Stop and join a receiver thread started by sc_ring_receiver_start.
+CORE_API void sc_ring_receiver_stop(ring_receiver_t *rx);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+#include "event_loop.h"
+#include "fanout.h"
+#include "pacing.h"
+
+#include <pthread.h>
+
+// Channels one server can host (all listed in a single advertisement)
+#define SERVER_CHANNELS_MAX ADVERTISEMENT_CHANNELS_MAX
+
+// Sender threads one server can run
+#define SERVER_WORKERS_MAX 32
+
+// Produce and send the channel's next audio, e.g. with sc_network_send or a packetizer
+// emitting to `channel`. Called every channel interval on the channel's worker thread.
+typedef void (*channel_source_fn)(connection_t *channel, void *ctx);
+
+typedef struct {
+    connection_t      conn;         // Own multicast socket, group and sequence space
+    channel_source_fn source;
+    void             *source_ctx;
+    uint64_t          interval_ns;  // Period between source calls
+    fanout_t         *fanout;       // Unicast subscribers, NULL if multicast
+    pacer_t          *pacer;        // Spacing of multicast datagrams, NULL to send at once
+} server_channel;
+
+typedef struct {
+    pthread_t    thread;
+    event_loop_t loop;
+    int32_t      cpu;        // Core the thread is pinned to
+    uint8_t      started;
+} server_worker;
+
+// Hosts many independent channels from one process. Channels are sharded round-robin
+// across worker threads, each pinned to its own core and driving its channels from an
+// event loop, so channels never contend on a shared lock or socket.
+typedef struct {
+    connection_t   control;  // Aux socket: advertisements, closes and client requests,
+                             // the latter served by the first worker while running
+    server_channel channels[SERVER_CHANNELS_MAX];
+    uint32_t       channel_count;
+    server_worker  workers[SERVER_WORKERS_MAX];
+    uint32_t       worker_count;
+    uint8_t        running;
+} server_t;
+
+// Allocate a server with `worker_count` sender threads (0 = one per online core).
+// Returns the server if successful, NULL otherwise.
+CORE_API server_t *sc_server_create(uint32_t worker_count);
+
+// Stop the server if running, broadcast a close for every channel and free it.
+CORE_API void sc_server_destroy(server_t *server);
+
+// Add a channel sending audio in `codec` of the given layout (advertised to clients) to
+// multicast `group`, calling `source` every `interval_ns`.
+// Channels can only be added while the server is stopped.
+// Returns the channel index if successful, -1 otherwise.
+CORE_API int32_t sc_server_add_channel(server_t *server, const char *group, uint8_t codec, uint32_t sample_rate,
+    uint8_t channels, uint64_t interval_ns, channel_source_fn source, void *ctx);
+
+// Send channel `index` by unicast to subscribed clients instead of multicast, for networks
+// that block multicast. Subscribers silent for `expiry_ns` are dropped. Call while stopped.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_server_enable_fanout(server_t *server, int32_t index, uint64_t expiry_ns);
+
+// Pace channel `index`'s multicast datagrams evenly, `datagrams_per_interval` per
+// channel interval, instead of sending each frame's datagrams as one burst. With
+// PACING_SLEEP the worker thread sleeps between datagrams, delaying its other channels.
+// Call while stopped.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_server_enable_pacing(server_t *server, int32_t index, pacing_mode mode, uint32_t datagrams_per_interval);
+
+// Apply a client request (subscription, keepalive, unsubscribe) received from `src` on the
+// control socket, routed to the channel by group address.
+// Returns true if the request was handled, false otherwise.
+CORE_API uint8_t sc_server_handle_request(server_t *server, const datagram_t *request, struct sockaddr_in *src);
+
+// Start the worker threads.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_server_start(server_t *server);
+
+// Stop and join the worker threads.
+CORE_API void sc_server_stop(server_t *server);
+
+// Broadcast one advertisement listing every channel.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_server_advertise(server_t *server);
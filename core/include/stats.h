@@ -0,0 +1,77 @@
+#pragma once
+
+#include "defines.h"
+
+// Log-linear (HDR-style) histogram of nanosecond values: every power of two range is
+// split into 2^HISTOGRAM_SUB_BITS buckets, bounding the error to ~6% at any scale.
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_MAGNITUDE 40  // Values are clamped below 2^40 ns (~18 minutes)
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_MAGNITUDE - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+// errno values counted individually; larger ones share the last slot
+#define STATS_ERRNO_MAX 128
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+} histogram;
+
+// Receive side sequence tracking, owned by the receiving thread
+typedef struct {
+    uint32_t highest_sequence;
+    uint64_t window;           // Bit i set: highest_sequence - i was received
+    uint32_t span;             // Bits of `window` tracked since the first sequence: a clear
+                               // bit below it was counted as a gap, anything older never was
+    uint64_t last_arrival_ns;
+    uint64_t last_timestamp;
+    uint8_t  started;
+} stats_tracking;
+
+// Counters kept per connection. Updated with relaxed atomics so any thread can count
+// and sc_connection_stats_snapshot can read them without locking.
+typedef struct {
+    uint64_t packets_sent;
+    uint64_t bytes_sent;
+    uint64_t packets_received;
+    uint64_t bytes_received;
+    uint64_t invalid;          // Received datagrams failing validation
+    uint64_t gaps;             // Audio sequences skipped over and not filled in since
+    uint64_t duplicates;       // Audio sequences received more than once
+    uint64_t reordered;        // Audio sequences received after a later one
+    uint64_t late;             // Frames arriving after their playout (sc_stats_record_late)
+    uint64_t send_errors;
+    uint64_t receive_errors;
+    uint64_t errnos[STATS_ERRNO_MAX + 1];  // Send/receive failures by errno
+    int64_t  clock_offset_ns;  // Sender minus local clock, applied to delay samples
+    histogram jitter;          // Inter-arrival jitter: |arrival gap - send gap| (RFC 3550 D)
+    histogram delay;           // End-to-end delay: arrival minus send timestamp
+    stats_tracking tracking;
+} connection_stats;
+
+CORE_API void sc_histogram_record(histogram *h, uint64_t value_ns);
+
+// Value below which `percentile` (0-100) of the recorded values fall, or 0 if empty.
+CORE_API uint64_t sc_histogram_percentile(const histogram *h, double percentile);
+
+// Number of values recorded.
+CORE_API uint64_t sc_histogram_count(const histogram *h);
+
+CORE_API void sc_stats_record_send(connection_stats *stats, uint32_t packets, uint64_t bytes);
+
+// Count a failed send or receive with its errno.
+CORE_API void sc_stats_record_error(connection_stats *stats, uint8_t send, int32_t err);
+
+// Account a valid received datagram arriving at `arrival_ns`. Audio datagrams also
+// update gap, duplicate and reorder counts and the jitter and delay histograms.
+CORE_API void sc_stats_record_receive(connection_stats *stats, uint8_t kind, uint32_t sequence,
+    uint64_t timestamp, uint32_t len, uint64_t arrival_ns);
+
+// Count a frame that arrived too late to play (e.g. JITTER_PUSH_LATE).
+CORE_API void sc_stats_record_late(connection_stats *stats);
+
+// Set the sender minus local clock offset (e.g. from clock_sync) used for delay samples.
+// Without one, delay is only meaningful when sender and receiver share a clock.
+CORE_API void sc_stats_set_clock_offset(connection_stats *stats, int64_t offset_ns);
+
+// Log a one line summary of `stats` under `name`.
+CORE_API void sc_stats_log(const char *name, const connection_stats *stats);
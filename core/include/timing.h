@@ -0,0 +1,12 @@
+#pragma once
+
+#include "defines.h"
+
+#define NS_PER_SEC  1000000000ULL
+#define NS_PER_USEC 1000ULL
+
+// Current CLOCK_MONOTONIC time in nanoseconds. Unaffected by wall clock changes.
+CORE_API uint64_t sc_time_now_ns(void);
+
+// Current CLOCK_REALTIME (wall clock) time in nanoseconds since the Unix epoch.
+CORE_API uint64_t sc_time_wall_ns(void);
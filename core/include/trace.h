@@ -0,0 +1,84 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+#include <pthread.h>
+
+#define TRACE_MAGIC "SCTRACE1"
+#define TRACE_VERSION 1
+
+// Start of a trace file. Records follow it back to back.
+typedef struct __attribute__((__packed__)) {
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t records;  // Complete records in the file
+    uint64_t bytes;    // File bytes in use, this header included
+} trace_file_header;
+
+// One received datagram, followed by its `len` bytes exactly as they arrived (wire
+// format), padded to 8 bytes. Fields are in host byte order.
+typedef struct __attribute__((__packed__)) {
+    uint64_t arrival_ns;  // CLOCK_MONOTONIC arrival (kernel timestamp when enabled)
+    uint16_t len;
+    uint8_t  aux;         // Arrived on the aux socket rather than the audio socket
+    uint8_t  reserved[5];
+} trace_record;
+
+// Appends received datagrams to a memory-mapped trace file, growing it as needed. A
+// record becomes part of the trace only once complete, so a crashed recorder leaves a
+// readable file. Safe to use from several receiving threads.
+typedef struct trace {
+    pthread_mutex_t    lock;
+    int32_t            fd;
+    uint8_t           *map;
+    uint64_t           capacity;  // Bytes mapped (and allocated in the file)
+    trace_file_header *header;
+} trace_recorder_t;
+
+typedef struct {
+    int32_t        fd;
+    const uint8_t *map;
+    uint64_t       mapped;  // Bytes mapped (the whole file)
+    uint64_t       size;    // Bytes of complete records, from the file's header
+    uint64_t       offset;  // Next record
+    uint64_t       index;   // Records read
+    uint64_t       records;
+} trace_reader_t;
+
+// Called by sc_trace_replay with each datagram, decoded as sc_network_receive would.
+typedef void (*trace_replay_fn)(void *ctx, datagram_t *dgram, uint32_t len, uint64_t arrival_ns, uint8_t aux);
+
+// Create (or truncate) the trace file at `path`.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_trace_recorder_open(trace_recorder_t *rec, const char *path);
+
+// Append a datagram of `len` bytes in wire format.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_trace_record(trace_recorder_t *rec, const void *wire, uint32_t len, uint64_t arrival_ns,
+    uint8_t aux);
+
+// Trim the file to the records written and close it.
+CORE_API void sc_trace_recorder_close(trace_recorder_t *rec);
+
+// Map the trace file at `path` for reading.
+// Returns true if successful, false otherwise.
+CORE_API uint8_t sc_trace_reader_open(trace_reader_t *reader, const char *path);
+
+CORE_API void sc_trace_reader_close(trace_reader_t *reader);
+
+// Go back to the first record.
+CORE_API void sc_trace_reader_rewind(trace_reader_t *reader);
+
+// Copy the next record's datagram (still in wire format) into `dest`.
+// Returns true if a record was read, false at the end of the trace.
+CORE_API uint8_t sc_trace_next(trace_reader_t *reader, datagram_t *dest, uint32_t *len, uint64_t *arrival_ns,
+    uint8_t *aux);
+
+// Feed the remaining records to `fn`, skipping any that fail validation. With `realtime`
+// records are delivered with their recorded spacing and arrival times moved onto the
+// current clock, otherwise as fast as `fn` consumes them with their recorded arrival
+// times, so replays are deterministic.
+// Returns the number of datagrams delivered.
+CORE_API uint64_t sc_trace_replay(trace_reader_t *reader, uint8_t realtime, trace_replay_fn fn, void *ctx);
@@ -1,27 +1,73 @@
 #pragma once
 
 #include "defines.h"
-#include "networking.h"
-#include <sys/time.h>  // struct timeval
+#include "stats.h"
 #include <netinet/in.h>
 
-#define DATAGRAM_PAYLOAD_MAX_SIZE 1  // TODO: revise
+// Version of the on-wire datagram format, carried in every header
+#define DATAGRAM_VERSION 2
+
+// Largest datagram that fits a 1500 byte Ethernet MTU without IP fragmentation
+// (1500 - 20 byte IPv4 header - 8 byte UDP header)
+#define DATAGRAM_MAX_SIZE 1472
+#define DATAGRAM_PAYLOAD_MAX_SIZE (DATAGRAM_MAX_SIZE - 16)  // 16 = sizeof(datagram_header)
 
 typedef enum {
     SERVER_AD = 0,
     SERVER_CLOSE = 1,
-    SERVER_AUDIO = 2
+    SERVER_AUDIO = 2,
+    SERVER_FEC = 3,
+    CLIENT_NACK = 4,
+    CLIENT_TIME_REQUEST = 5,
+    SERVER_TIME_RESPONSE = 6,
+    CLIENT_SUBSCRIBE = 7,
+    CLIENT_KEEPALIVE = 8,
+    CLIENT_UNSUBSCRIBE = 9,
+    CLIENT_JOIN = 10,
+    CLIENT_REPORT = 11
 } datagram_kind;
 
+#define DATAGRAM_KIND_MAX CLIENT_REPORT
+
+// Fixed-width header. Sent in network byte order, held in host byte order once received
+// (see datagram.h). Fields are ordered so every one is naturally aligned on the wire.
 typedef struct __attribute__((__packed__)) {
-    datagram_kind kind;
+    uint8_t  version;      // DATAGRAM_VERSION
+    uint8_t  kind;         // datagram_kind
+    uint16_t payload_len;  // Bytes following the header
     uint32_t sequence;
-    struct timeval timestamp;
+    uint64_t timestamp;    // Send time, sender's CLOCK_MONOTONIC nanoseconds
 } datagram_header;
 
+// Channels one SERVER_AD can list (64 * 22 + 1 bytes fits the payload)
+#define ADVERTISEMENT_CHANNELS_MAX 64
+
+// Audio layout of a channel unless its server says otherwise
+#define AUDIO_DEFAULT_SAMPLE_RATE 48000
+#define AUDIO_DEFAULT_CHANNELS    2
+
+// One channel (multicast group) offered by a server. Sent in network byte order, held in
+// host byte order once received.
+typedef struct __attribute__((__packed__)) {
+    char     group_addr[INET_ADDRSTRLEN];
+    uint8_t  codec;        // codec_id the group's audio is encoded with
+    uint32_t sample_rate;  // Hz
+    uint8_t  channels;     // Interleaved in each frame
+} advertised_channel;
+
+// SERVER_AD payload. Only the first `channel_count` entries are sent.
+typedef struct __attribute__((__packed__)) {
+    uint8_t            channel_count;
+    advertised_channel channels[ADVERTISEMENT_CHANNELS_MAX];
+} advertisement;
+
+// Payload bytes of an advertisement listing `count` channels
+#define ADVERTISEMENT_SIZE(count) (sizeof(uint8_t) + (count) * sizeof(advertised_channel))
+
 typedef union __attribute__((__packed__)) {
-    char group_addr[INET_ADDRSTRLEN];          // SERVER_AD
-    uint8_t audio[DATAGRAM_PAYLOAD_MAX_SIZE];  // SERVER_AUDIO
+    char group_addr[INET_ADDRSTRLEN];          // SERVER_CLOSE
+    advertisement ad;                          // SERVER_AD
+    uint8_t audio[DATAGRAM_PAYLOAD_MAX_SIZE];  // Other kinds, see their modules
 } datagram_payload;
 
 typedef struct __attribute__((__packed__)) {
@@ -29,12 +75,26 @@ typedef struct __attribute__((__packed__)) {
     datagram_payload payload;
 } datagram_t;
 
+struct fanout;  // fanout.h
+struct pacer;   // pacing.h
+struct uring;   // uring.h
+struct trace;   // trace.h
+
 typedef struct {
     int32_t  socket_audio_fd;
     int32_t  socket_aux_fd;
     uint32_t send_sequence;
     uint32_t recv_sequence;
     uint8_t  is_server;
+    uint8_t  codec;  // Server: codec advertised. Client: codec of the advertised group.
+    uint32_t sample_rate;  // Audio layout, advertised and learned as `codec` is
+    uint8_t  channels;
     char     group_addr[INET_ADDRSTRLEN];
     char     other_addr[INET_ADDRSTRLEN];  // Client: server addr. Server: unused.
+    struct fanout *fanout;  // Server: unicast subscribers replacing the group, NULL to multicast
+    struct pacer  *pacer;   // Server: spaces out multicast group datagrams, NULL to send at once
+    struct uring  *uring_audio;  // io_uring backend per socket, NULL for plain socket calls
+    struct uring  *uring_aux;
+    struct trace  *trace;   // Records every datagram received, NULL to not record
+    connection_stats stats;
 } connection_t;
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "defines.h"
+#include "types.h"
+
+#include <pthread.h>
+#include <netinet/in.h>  // struct sockaddr_in
+#include <sys/socket.h>  // struct msghdr
+#include <sys/uio.h>     // struct iovec
+
+// Submission queue entries per ring
+#define URING_ENTRIES 256
+
+// Buffers the kernel receives into (provided-buffer ring). Must be a power of two.
+#define URING_RECV_BUFFERS 256
+
+// Sends that can be in flight at once
+#define URING_SEND_SLOTS 128
+
+// Receive timeout waiting with no limit
+#define URING_WAIT_FOREVER UINT64_MAX
+
+// A queued send. The kernel reads it after the caller has returned, so the datagram is
+// copied in (already encoded) and everything the send points at lives here.
+typedef struct {
+    struct msghdr      msg;
+    struct iovec       iov;
+    struct sockaddr_in addr;
+    uint8_t            data[sizeof(datagram_t)];
+} uring_send_slot;
+
+typedef struct {
+    uint64_t submits;      // io_uring_enter calls, for all purposes
+    uint64_t received;     // Datagrams taken from completions
+    uint64_t sent;         // Sends completed successfully
+    uint64_t rearms;       // Multishot receives re-armed after the kernel ended them
+    uint64_t starved;      // Times the kernel ran out of receive buffers
+} uring_stats;
+
+// io_uring backend for one socket (Linux 6.0+), driven with raw syscalls. A multishot
+// receive stays armed on the socket, landing datagrams in kernel-selected buffers from a
+// provided-buffer ring, so a steady stream is received with no syscalls at all. Sends
+// are queued as SQEs and submitted together. Thread-safe.
+typedef struct uring {
+    pthread_mutex_t   lock;
+    int32_t           ring_fd;
+    int32_t           socket_fd;
+    uint8_t           sqpoll;       // Kernel thread polls the submission queue
+    uint8_t           armed;        // Multishot receive outstanding
+
+    // Rings shared with the kernel
+    void             *sq_ring;
+    void             *cq_ring;
+    size_t            sq_ring_size;
+    size_t            cq_ring_size;
+    void             *sqes;
+    uint32_t         *sq_head;
+    uint32_t         *sq_tail;
+    uint32_t         *sq_mask;
+    uint32_t         *sq_array;
+    uint32_t         *sq_flags;
+    uint32_t         *cq_head;
+    uint32_t         *cq_tail;
+    uint32_t         *cq_mask;
+    void             *cqes;
+    uint32_t          sq_pending;   // Queued but not yet submitted
+
+    // Receive buffers handed to the kernel, and completions not yet taken by the caller
+    void             *buf_ring;
+    uint8_t          *buffers;
+    uint16_t          buf_tail;
+    struct msghdr     recv_msg;     // Layout template for multishot recvmsg
+    uint16_t          ready_bids[URING_RECV_BUFFERS];
+    uint32_t          ready_head;
+    uint32_t          ready_tail;
+
+    uring_send_slot  *slots;
+    uint32_t          free_slots[URING_SEND_SLOTS];
+    uint32_t          free_count;
+
+    connection_stats *conn_stats;   // Where asynchronous send errors are recorded
+    uring_stats       stats;
+} uring_t;
+
+// Set up a ring for `socket_fd`, arming a multishot receive on it. With `sqpoll` a kernel
+// thread picks up submissions, so sends need no syscall while it is awake, at the cost
+// of a core spinning while traffic flows.
+// Returns true if successful, false otherwise (e.g. io_uring unavailable or disabled).
+CORE_API uint8_t sc_uring_init(uring_t *ring, int32_t socket_fd, uint8_t sqpoll, connection_stats *conn_stats);
+
+// Close the ring, cancelling its outstanding operations. The socket is left open.
+CORE_API void sc_uring_close(uring_t *ring);
+
+// Queue a send of `dgram` (`len` bytes, host order header) to `addr`.
+// Returns true if queued, false otherwise.
+CORE_API uint8_t sc_uring_queue_send(uring_t *ring, const datagram_t *dgram, uint32_t len,
+    const struct sockaddr_in *addr);
+
+// Submit everything queued.
+CORE_API void sc_uring_submit(uring_t *ring);
+
+// Take the next received datagram, in wire format, copying it into `dest`, its sender
+// into `src` and its arrival time into `arrival_ns` (see sc_low_latency_arrival_ns).
+// Waits up to `timeout_ns` for one to arrive: 0 returns at once, URING_WAIT_FOREVER blocks
+// until one does.
+// Returns the datagram size, 0 if it was malformed, or -1 if none was ready.
+CORE_API int32_t sc_uring_receive(uring_t *ring, datagram_t *dest, struct sockaddr_in *src, uint64_t *arrival_ns,
+    uint64_t timeout_ns);
@@ -0,0 +1,82 @@
+#define _GNU_SOURCE  // posix_memalign(...)
+
+#include "buffer_pool.h"
+
+#include "logger.h"
+#include "assert.h"
+
+#include <stdlib.h>  // posix_memalign(...), malloc(...), free(...)
+#include <string.h>  // memset(...)
+
+buffer_pool_t *sc_buffer_pool_create(uint32_t capacity) {
+    void *pool_mem;
+    void *slab_mem;
+
+    CORE_ASSERT_MSG(capacity > 0 && (capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    if (posix_memalign(&pool_mem, CACHE_LINE_SIZE, sizeof(buffer_pool_t)) != 0) {
+        LOG_ERROR("sc_buffer_pool_create: allocation failed");
+        return NULL;
+    }
+    buffer_pool_t *pool = (buffer_pool_t *) pool_mem;
+    memset(pool, 0, sizeof(buffer_pool_t));
+
+    pool->free_indices = malloc(sizeof(uint32_t) * capacity);
+    if (!pool->free_indices || posix_memalign(&slab_mem, CACHE_LINE_SIZE, sizeof(pooled_datagram) * capacity) != 0) {
+        LOG_ERROR("sc_buffer_pool_create: allocation failed");
+        free(pool->free_indices);
+        free(pool);
+        return NULL;
+    }
+    pool->slab = (pooled_datagram *) slab_mem;
+    pool->capacity = capacity;
+
+    // Every buffer starts free
+    for (uint32_t i = 0; i < capacity; i++) {
+        pool->slab[i].index = i;
+        pool->slab[i].len = 0;
+        pool->free_indices[i] = i;
+    }
+    pool->head = 0;
+    pool->tail = capacity;
+    pool->cached_tail = capacity;
+    return pool;
+}
+
+void sc_buffer_pool_destroy(buffer_pool_t *pool) {
+    free(pool->slab);
+    free(pool->free_indices);
+    free(pool);
+}
+
+pooled_datagram *sc_buffer_pool_acquire(buffer_pool_t *pool) {
+    if (pool->spare) {
+        pooled_datagram *spare = pool->spare;
+        pool->spare = NULL;
+        return spare;
+    }
+    uint32_t head = pool->head;
+    if (head == pool->cached_tail) {
+        pool->cached_tail = __atomic_load_n(&pool->tail, __ATOMIC_ACQUIRE);
+        if (head == pool->cached_tail) {
+            return NULL;
+        }
+    }
+    uint32_t index = pool->free_indices[head & (pool->capacity - 1)];
+    __atomic_store_n(&pool->head, head + 1, __ATOMIC_RELEASE);
+    return &pool->slab[index];
+}
+
+void sc_buffer_pool_release(buffer_pool_t *pool, pooled_datagram *buffer) {
+    // At most `capacity` buffers are ever out, so the free queue cannot overflow
+    uint32_t tail = pool->tail;
+    pool->free_indices[tail & (pool->capacity - 1)] = buffer->index;
+    buffer->len = 0;
+    __atomic_store_n(&pool->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+void sc_buffer_pool_unacquire(buffer_pool_t *pool, pooled_datagram *buffer) {
+    CORE_ASSERT(!pool->spare);
+    buffer->len = 0;
+    pool->spare = buffer;
+}
@@ -0,0 +1,134 @@
+#include "clock_sync.h"
+
+#include "networking.h"
+#include "datagram.h"
+#include "timing.h"
+#include "logger.h"
+
+#include <string.h>  // memset(...)
+
+void sc_clock_sync_init(clock_sync_t *cs) {
+    memset(cs, 0, sizeof(clock_sync_t));
+}
+
+uint32_t sc_clock_sync_build_request(clock_sync_t *cs, datagram_t *dest) {
+    time_probe *probe = (time_probe *) dest->payload.audio;
+
+    dest->header.kind = CLIENT_TIME_REQUEST;
+    dest->header.sequence = 0;
+    dest->header.timestamp = sc_time_now_ns();
+    probe->client_send = HTONLL(dest->header.timestamp);
+    cs->probe_send_ns = dest->header.timestamp;
+    probe->server_receive = 0;
+    probe->server_send = 0;
+    dest->header.payload_len = sizeof(time_probe);
+    return sizeof(datagram_header) + sizeof(time_probe);
+}
+
+uint8_t sc_clock_sync_respond(connection_t *conn, const datagram_t *request,
+    struct sockaddr_in *src, uint64_t receive_ns) {
+    const time_probe *asked = (const time_probe *) request->payload.audio;
+    datagram_t response;
+    time_probe *probe = (time_probe *) response.payload.audio;
+
+    if (request->header.kind != CLIENT_TIME_REQUEST || request->header.payload_len < sizeof(time_probe)) {
+        LOG_WARN("sc_clock_sync_respond: malformed time request");
+        return false;
+    }
+    response.header.kind = SERVER_TIME_RESPONSE;
+    response.header.sequence = request->header.sequence;
+    probe->client_send = asked->client_send;  // Echoed untouched, already network order
+    probe->server_receive = HTONLL(receive_ns);
+    response.header.timestamp = sc_time_now_ns();
+    probe->server_send = HTONLL(response.header.timestamp);
+    return sc_network_send_to(conn, &response, sizeof(datagram_header) + sizeof(time_probe), src);
+}
+
+// Least squares fit of offset against local time over the trusted samples
+void _clock_sync_estimate(clock_sync_t *cs) {
+    uint64_t min_delay = UINT64_MAX;
+    for (uint32_t i = 0; i < cs->count; i++) {
+        min_delay = cs->samples[i].delay_ns < min_delay ? cs->samples[i].delay_ns : min_delay;
+    }
+
+    // Work relative to the newest trusted sample to keep the sums well conditioned
+    const clock_sample *reference = NULL;
+    for (uint32_t i = 0; i < cs->count; i++) {
+        const clock_sample *s = &cs->samples[i];
+        if (s->delay_ns <= min_delay + CLOCK_SYNC_DELAY_SLACK_NS
+            && (!reference || (int64_t) (s->local_ns - reference->local_ns) > 0)) {
+            reference = s;
+        }
+    }
+
+    double n = 0, sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    for (uint32_t i = 0; i < cs->count; i++) {
+        const clock_sample *s = &cs->samples[i];
+        if (s->delay_ns > min_delay + CLOCK_SYNC_DELAY_SLACK_NS) {
+            continue;
+        }
+        double x = (double) (int64_t) (s->local_ns - reference->local_ns);
+        double y = (double) (s->offset_ns - reference->offset_ns);
+        n += 1;
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+    }
+
+    double denominator = n * sum_xx - sum_x * sum_x;
+    double drift = 0;
+    double intercept = sum_y / n;
+    if (n >= 2 && denominator > 0) {
+        drift = (n * sum_xy - sum_x * sum_y) / denominator;
+        intercept = (sum_y - drift * sum_x) / n;
+    }
+    cs->reference_local_ns = reference->local_ns;
+    cs->offset_ns = reference->offset_ns + (int64_t) intercept;
+    cs->drift = drift;
+    cs->synced = true;
+}
+
+uint8_t sc_clock_sync_handle_response(clock_sync_t *cs, const datagram_t *response,
+    uint64_t receive_ns) {
+    const time_probe *probe = (const time_probe *) response->payload.audio;
+
+    if (response->header.kind != SERVER_TIME_RESPONSE || response->header.payload_len < sizeof(time_probe)) {
+        LOG_WARN("sc_clock_sync_handle_response: malformed time response");
+        return false;
+    }
+    uint64_t t1 = HTONLL(probe->client_send);
+    uint64_t t2 = HTONLL(probe->server_receive);
+    uint64_t t3 = HTONLL(probe->server_send);
+    uint64_t t4 = receive_ns;
+    if (cs->probe_send_ns == 0 || t1 != cs->probe_send_ns) {
+        LOG_DEBUG("sc_clock_sync_handle_response: response to no outstanding probe");
+        return false;
+    }
+    cs->probe_send_ns = 0;
+    if (t4 < t1 || t3 < t2 || t4 - t1 < t3 - t2) {
+        LOG_WARN("sc_clock_sync_handle_response: inconsistent probe times");
+        return false;
+    }
+
+    clock_sample *sample = &cs->samples[cs->next++ & (CLOCK_SYNC_SAMPLES - 1)];
+    sample->local_ns = t4;
+    sample->delay_ns = (t4 - t1) - (t3 - t2);
+    sample->offset_ns = ((int64_t) (t2 - t1) + (int64_t) (t3 - t4)) / 2;
+    if (cs->count < CLOCK_SYNC_SAMPLES) {
+        cs->count++;
+    }
+    _clock_sync_estimate(cs);
+    return true;
+}
+
+uint64_t sc_clock_sync_local_to_server(clock_sync_t *cs, uint64_t local_ns) {
+    double elapsed = (double) (int64_t) (local_ns - cs->reference_local_ns);
+    return local_ns + cs->offset_ns + (int64_t) (cs->drift * elapsed);
+}
+
+uint64_t sc_clock_sync_server_to_local(clock_sync_t *cs, uint64_t server_ns) {
+    // Invert server = local + offset + drift * (local - reference)
+    double elapsed = (double) (int64_t) (server_ns - cs->offset_ns - cs->reference_local_ns);
+    return cs->reference_local_ns + (int64_t) (elapsed / (1.0 + cs->drift));
+}
@@ -0,0 +1,227 @@
+#include "codec.h"
+
+#include "logger.h"
+
+#include <string.h>     // memset(...)
+#include <arpa/inet.h>  // htons(...), ntohs(...)
+
+// Bytes leading each channel's block in an IMA-ADPCM frame: predictor (int16,
+// network order), step index, and a flag set on channel 0 if the last nibble is padding
+#define ADPCM_CHANNEL_HEADER 4
+
+static const int16_t adpcm_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t adpcm_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const codec_t *registry[CODEC_REGISTRY_MAX];
+static uint8_t registry_count = 0;
+
+int32_t _clamp(int32_t value, int32_t min, int32_t max) {
+    value = value < min ? min : value;
+    return value > max ? max : value;
+}
+
+uint32_t _pcm_encoded_size(uint32_t frames, uint8_t channels) {
+    return frames * channels * sizeof(int16_t);
+}
+
+uint32_t _pcm_encode(codec_state *state, const int16_t *pcm, uint32_t frames, uint8_t channels,
+    uint8_t *dest) {
+    (void) state;
+    uint32_t samples = frames * channels;
+    for (uint32_t i = 0; i < samples; i++) {
+        uint16_t sample = htons((uint16_t) pcm[i]);
+        memcpy(dest + i * sizeof(int16_t), &sample, sizeof(int16_t));
+    }
+    return samples * sizeof(int16_t);
+}
+
+uint32_t _pcm_decode(codec_state *state, const uint8_t *src, uint32_t len, uint8_t channels,
+    int16_t *pcm) {
+    (void) state;
+    uint32_t samples = len / sizeof(int16_t);
+    samples -= samples % channels;
+    for (uint32_t i = 0; i < samples; i++) {
+        uint16_t sample;
+        memcpy(&sample, src + i * sizeof(int16_t), sizeof(int16_t));
+        pcm[i] = (int16_t) ntohs(sample);
+    }
+    return samples / channels;
+}
+
+uint32_t _adpcm_encoded_size(uint32_t frames, uint8_t channels) {
+    // First frame is carried verbatim as the predictor in each channel header
+    uint32_t nibbles = (frames > 0 ? frames - 1 : 0) * channels;
+    return ADPCM_CHANNEL_HEADER * channels + (nibbles + 1) / 2;
+}
+
+// Quantise one sample to a 4 bit code, updating the channel's predictor and step index
+uint8_t _adpcm_encode_sample(int32_t sample, int32_t *predictor, int32_t *index) {
+    int32_t step = adpcm_step_table[*index];
+    int32_t diff = sample - *predictor;
+    uint8_t code = diff < 0 ? 8 : 0;
+    diff = diff < 0 ? -diff : diff;
+
+    // Successive approximation of diff / step in 3 bits, tracking the value the
+    // decoder will reconstruct so both sides stay in lock step
+    int32_t delta = step >> 3;
+    if (diff >= step) { code |= 4; diff -= step; delta += step; }
+    step >>= 1;
+    if (diff >= step) { code |= 2; diff -= step; delta += step; }
+    step >>= 1;
+    if (diff >= step) { code |= 1; delta += step; }
+
+    *predictor = _clamp(*predictor + ((code & 8) ? -delta : delta), INT16_MIN, INT16_MAX);
+    *index = _clamp(*index + adpcm_index_table[code], 0, 88);
+    return code;
+}
+
+int16_t _adpcm_decode_sample(uint8_t code, int32_t *predictor, int32_t *index) {
+    int32_t step = adpcm_step_table[*index];
+    int32_t delta = step >> 3;
+    if (code & 4) delta += step;
+    if (code & 2) delta += step >> 1;
+    if (code & 1) delta += step >> 2;
+
+    *predictor = _clamp(*predictor + ((code & 8) ? -delta : delta), INT16_MIN, INT16_MAX);
+    *index = _clamp(*index + adpcm_index_table[code], 0, 88);
+    return (int16_t) *predictor;
+}
+
+uint32_t _adpcm_encode(codec_state *state, const int16_t *pcm, uint32_t frames, uint8_t channels,
+    uint8_t *dest) {
+    int32_t predictor[CODEC_CHANNELS_MAX];
+    int32_t index[CODEC_CHANNELS_MAX];
+    uint32_t size = _adpcm_encoded_size(frames, channels);
+
+    if (channels == 0 || channels > CODEC_CHANNELS_MAX) {
+        LOG_WARN("_adpcm_encode: unsupported channel count %d", channels);
+        return 0;
+    }
+    if (frames == 0) {
+        return 0;
+    }
+    for (uint8_t c = 0; c < channels; c++) {
+        uint16_t first = htons((uint16_t) pcm[c]);
+        predictor[c] = pcm[c];
+        index[c] = state->step_index[c];
+        memcpy(dest + c * ADPCM_CHANNEL_HEADER, &first, sizeof(uint16_t));
+        dest[c * ADPCM_CHANNEL_HEADER + 2] = (uint8_t) index[c];
+        dest[c * ADPCM_CHANNEL_HEADER + 3] = 0;
+    }
+    dest[3] = ((frames - 1) * channels) & 1;
+
+    // Nibbles follow in interleaved sample order, low nibble first
+    uint8_t *nibbles = dest + ADPCM_CHANNEL_HEADER * channels;
+    uint32_t samples = (frames - 1) * channels;
+    const int16_t *src = pcm + channels;
+    memset(nibbles, 0, (samples + 1) / 2);
+    for (uint32_t i = 0; i < samples; i++) {
+        uint8_t c = i % channels;
+        uint8_t code = _adpcm_encode_sample(src[i], &predictor[c], &index[c]);
+        nibbles[i >> 1] |= code << ((i & 1) << 2);
+    }
+
+    // Step sizes carry over so the next frame starts well adapted
+    for (uint8_t c = 0; c < channels; c++) {
+        state->predictor[c] = (int16_t) predictor[c];
+        state->step_index[c] = (uint8_t) index[c];
+    }
+    return size;
+}
+
+uint32_t _adpcm_decode(codec_state *state, const uint8_t *src, uint32_t len, uint8_t channels,
+    int16_t *pcm) {
+    int32_t predictor[CODEC_CHANNELS_MAX];
+    int32_t index[CODEC_CHANNELS_MAX];
+    uint32_t header_len = ADPCM_CHANNEL_HEADER * channels;
+
+    (void) state;
+    if (channels == 0 || channels > CODEC_CHANNELS_MAX) {
+        LOG_WARN("_adpcm_decode: unsupported channel count %d", channels);
+        return 0;
+    }
+    if (len < header_len) {
+        return 0;
+    }
+    // The pad bit drops an unused final nibble, so it needs at least one payload byte
+    uint32_t nibble_count = (len - header_len) * 2;
+    if (nibble_count < (uint32_t) (src[3] & 1)) {
+        LOG_WARN("_adpcm_decode: padded frame carries no samples");
+        return 0;
+    }
+    for (uint8_t c = 0; c < channels; c++) {
+        uint16_t first;
+        memcpy(&first, src + c * ADPCM_CHANNEL_HEADER, sizeof(uint16_t));
+        predictor[c] = (int16_t) ntohs(first);
+        index[c] = _clamp(src[c * ADPCM_CHANNEL_HEADER + 2], 0, 88);
+        pcm[c] = (int16_t) predictor[c];
+    }
+
+    const uint8_t *nibbles = src + header_len;
+    uint32_t samples = nibble_count - (src[3] & 1);
+    samples -= samples % channels;
+    int16_t *dest = pcm + channels;
+    for (uint32_t i = 0; i < samples; i++) {
+        uint8_t c = i % channels;
+        uint8_t code = (nibbles[i >> 1] >> ((i & 1) << 2)) & 0xF;
+        dest[i] = _adpcm_decode_sample(code, &predictor[c], &index[c]);
+    }
+    return 1 + samples / channels;
+}
+
+static const codec_t codec_pcm_s16 = {
+    CODEC_PCM_S16, "pcm_s16", _pcm_encoded_size, _pcm_encode, _pcm_decode
+};
+
+static const codec_t codec_ima_adpcm = {
+    CODEC_IMA_ADPCM, "ima_adpcm", _adpcm_encoded_size, _adpcm_encode, _adpcm_decode
+};
+
+void _codec_registry_init(void) {
+    static uint8_t initialised = false;
+    if (!initialised) {
+        initialised = true;
+        registry[registry_count++] = &codec_pcm_s16;
+        registry[registry_count++] = &codec_ima_adpcm;
+    }
+}
+
+uint8_t sc_codec_register(const codec_t *codec) {
+    _codec_registry_init();
+    for (uint8_t i = 0; i < registry_count; i++) {
+        if (registry[i]->id == codec->id) {
+            registry[i] = codec;
+            return true;
+        }
+    }
+    if (registry_count == CODEC_REGISTRY_MAX) {
+        return false;
+    }
+    registry[registry_count++] = codec;
+    return true;
+}
+
+const codec_t *sc_codec_get(uint8_t id) {
+    _codec_registry_init();
+    for (uint8_t i = 0; i < registry_count; i++) {
+        if (registry[i]->id == id) {
+            return registry[i];
+        }
+    }
+    return NULL;
+}
+
+void sc_codec_state_init(codec_state *state) {
+    memset(state, 0, sizeof(codec_state));
+}
@@ -0,0 +1,28 @@
+#include "datagram.h"
+
+#include <arpa/inet.h>  // htons(...), htonl(...), ntohs(...), ntohl(...)
+
+void sc_datagram_header_encode(const datagram_header *src, uint16_t payload_len,
+    datagram_header *dest) {
+    dest->version     = DATAGRAM_VERSION;
+    dest->kind        = src->kind;
+    dest->payload_len = htons(payload_len);
+    dest->sequence    = htonl(src->sequence);
+    dest->timestamp   = HTONLL(src->timestamp);
+}
+
+void sc_datagram_header_decode(datagram_header *header) {
+    header->payload_len = ntohs(header->payload_len);
+    header->sequence    = ntohl(header->sequence);
+    header->timestamp   = HTONLL(header->timestamp);
+}
+
+uint8_t sc_datagram_decode(datagram_t *dgram, uint32_t len) {
+    if (len < sizeof(datagram_header)) {
+        return false;
+    }
+    sc_datagram_header_decode(&dgram->header);
+    return dgram->header.version == DATAGRAM_VERSION
+        && dgram->header.kind <= DATAGRAM_KIND_MAX
+        && dgram->header.payload_len == len - sizeof(datagram_header);
+}
@@ -0,0 +1,437 @@
+#include "dsp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DSP_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Every kernel must give bit-identical results to the scalar ones, so `a + b * c` may not be
+// fused into one FMA (rounded once, where the SIMD kernels round twice). GCC only honours
+// -ffp-contract=off, set in the Makefile.
+#ifdef __clang__
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+#define S16_SCALE 32768.0f
+#define S24_SCALE 8388608.0f
+
+// Adding then subtracting 1.5 * 2^23 rounds a float of magnitude < 2^22 to the nearest
+// integer, ties to even, exactly as the SIMD conversion instructions do.
+#define ROUND_MAGIC 12582912.0f
+
+typedef struct {
+    dsp_isa isa;
+    void (*s16_to_f32)(const int16_t *src, float *dest, uint32_t count);
+    void (*f32_to_s16)(const float *src, int16_t *dest, uint32_t count);
+    void (*deinterleave2)(const float *src, float *left, float *right, uint32_t frames);
+    void (*interleave2)(const float *left, const float *right, float *dest, uint32_t frames);
+    void (*gain)(float *buffer, float gain, uint32_t count);
+    void (*mix)(float *dest, const float *src, float gain, uint32_t count);
+} dsp_kernels;
+
+static dsp_kernels kernels;
+static uint8_t kernels_ready = false;
+
+float _clampf(float value, float min, float max) {
+    value = value < min ? min : value;
+    return value > max ? max : value;
+}
+
+// Scalar reference kernels. SIMD kernels use these for their tails.
+
+void _s16_to_f32_scalar(const int16_t *src, float *dest, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dest[i] = (float) src[i] * (1.0f / S16_SCALE);
+    }
+}
+
+void _f32_to_s16_scalar(const float *src, int16_t *dest, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        float scaled = _clampf(src[i] * S16_SCALE, -32768.0f, 32767.0f);
+        dest[i] = (int16_t) ((scaled + ROUND_MAGIC) - ROUND_MAGIC);
+    }
+}
+
+void _deinterleave2_scalar(const float *src, float *left, float *right, uint32_t frames) {
+    for (uint32_t i = 0; i < frames; i++) {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+void _interleave2_scalar(const float *left, const float *right, float *dest, uint32_t frames) {
+    for (uint32_t i = 0; i < frames; i++) {
+        dest[2 * i] = left[i];
+        dest[2 * i + 1] = right[i];
+    }
+}
+
+void _gain_scalar(float *buffer, float gain, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        buffer[i] = buffer[i] * gain;
+    }
+}
+
+void _mix_scalar(float *dest, const float *src, float gain, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dest[i] = dest[i] + src[i] * gain;
+    }
+}
+
+#ifdef DSP_X86
+
+__attribute__((target("sse2")))
+void _s16_to_f32_sse2(const int16_t *src, float *dest, uint32_t count) {
+    const __m128 scale = _mm_set1_ps(1.0f / S16_SCALE);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i s16 = _mm_loadu_si128((const __m128i *) (src + i));
+        // Sign extend by placing each sample in the high half then shifting down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s16, s16), 16);
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    _s16_to_f32_scalar(src + i, dest + i, count - i);
+}
+
+__attribute__((target("sse2")))
+void _f32_to_s16_sse2(const float *src, int16_t *dest, uint32_t count) {
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    const __m128 max = _mm_set1_ps(32767.0f);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), min), max);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), min), max);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i *) (dest + i), packed);
+    }
+    _f32_to_s16_scalar(src + i, dest + i, count - i);
+}
+
+__attribute__((target("sse2")))
+void _deinterleave2_sse2(const float *src, float *left, float *right, uint32_t frames) {
+    uint32_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 a = _mm_loadu_ps(src + 2 * i);      // L0 R0 L1 R1
+        __m128 b = _mm_loadu_ps(src + 2 * i + 4);  // L2 R2 L3 R3
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    _deinterleave2_scalar(src + 2 * i, left + i, right + i, frames - i);
+}
+
+__attribute__((target("sse2")))
+void _interleave2_sse2(const float *left, const float *right, float *dest, uint32_t frames) {
+    uint32_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(dest + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(dest + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+    _interleave2_scalar(left + i, right + i, dest + 2 * i, frames - i);
+}
+
+__attribute__((target("sse2")))
+void _gain_sse2(float *buffer, float gain, uint32_t count) {
+    const __m128 g = _mm_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(buffer + i, _mm_mul_ps(_mm_loadu_ps(buffer + i), g));
+    }
+    _gain_scalar(buffer + i, gain, count - i);
+}
+
+__attribute__((target("sse2")))
+void _mix_sse2(float *dest, const float *src, float gain, uint32_t count) {
+    const __m128 g = _mm_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 mixed = _mm_add_ps(_mm_loadu_ps(dest + i), _mm_mul_ps(_mm_loadu_ps(src + i), g));
+        _mm_storeu_ps(dest + i, mixed);
+    }
+    _mix_scalar(dest + i, src + i, gain, count - i);
+}
+
+__attribute__((target("avx2")))
+void _s16_to_f32_avx2(const int16_t *src, float *dest, uint32_t count) {
+    const __m256 scale = _mm256_set1_ps(1.0f / S16_SCALE);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s32 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + i)));
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s32), scale));
+    }
+    _s16_to_f32_scalar(src + i, dest + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void _f32_to_s16_avx2(const float *src, int16_t *dest, uint32_t count) {
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+    const __m256 min = _mm256_set1_ps(-32768.0f);
+    const __m256 max = _mm256_set1_ps(32767.0f);
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), min), max);
+        __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), min), max);
+        // packs works per 128 bit lane, so restore sample order across lanes afterwards
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *) (dest + i), packed);
+    }
+    _f32_to_s16_sse2(src + i, dest + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void _gain_avx2(float *buffer, float gain, uint32_t count) {
+    const __m256 g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(buffer + i, _mm256_mul_ps(_mm256_loadu_ps(buffer + i), g));
+    }
+    _gain_scalar(buffer + i, gain, count - i);
+}
+
+__attribute__((target("avx2")))
+void _mix_avx2(float *dest, const float *src, float gain, uint32_t count) {
+    const __m256 g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 mixed = _mm256_add_ps(_mm256_loadu_ps(dest + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+        _mm256_storeu_ps(dest + i, mixed);
+    }
+    _mix_scalar(dest + i, src + i, gain, count - i);
+}
+
+#endif  // DSP_X86
+
+#ifdef DSP_NEON
+
+void _s16_to_f32_neon(const int16_t *src, float *dest, uint32_t count) {
+    const float32x4_t scale = vdupq_n_f32(1.0f / S16_SCALE);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s16 = vld1q_s16(src + i);
+        vst1q_f32(dest + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s16))), scale));
+        vst1q_f32(dest + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s16))), scale));
+    }
+    _s16_to_f32_scalar(src + i, dest + i, count - i);
+}
+
+void _f32_to_s16_neon(const float *src, int16_t *dest, uint32_t count) {
+    const float32x4_t scale = vdupq_n_f32(S16_SCALE);
+    const float32x4_t min = vdupq_n_f32(-32768.0f);
+    const float32x4_t max = vdupq_n_f32(32767.0f);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t a = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i), scale), min), max);
+        float32x4_t b = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i + 4), scale), min), max);
+        // vcvtnq rounds to nearest, ties to even, matching the scalar reference
+        int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b)));
+        vst1q_s16(dest + i, packed);
+    }
+    _f32_to_s16_scalar(src + i, dest + i, count - i);
+}
+
+void _deinterleave2_neon(const float *src, float *left, float *right, uint32_t frames) {
+    uint32_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t lr = vld2q_f32(src + 2 * i);
+        vst1q_f32(left + i, lr.val[0]);
+        vst1q_f32(right + i, lr.val[1]);
+    }
+    _deinterleave2_scalar(src + 2 * i, left + i, right + i, frames - i);
+}
+
+void _interleave2_neon(const float *left, const float *right, float *dest, uint32_t frames) {
+    uint32_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t lr = { { vld1q_f32(left + i), vld1q_f32(right + i) } };
+        vst2q_f32(dest + 2 * i, lr);
+    }
+    _interleave2_scalar(left + i, right + i, dest + 2 * i, frames - i);
+}
+
+void _gain_neon(float *buffer, float gain, uint32_t count) {
+    const float32x4_t g = vdupq_n_f32(gain);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(buffer + i, vmulq_f32(vld1q_f32(buffer + i), g));
+    }
+    _gain_scalar(buffer + i, gain, count - i);
+}
+
+void _mix_neon(float *dest, const float *src, float gain, uint32_t count) {
+    const float32x4_t g = vdupq_n_f32(gain);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // Separate multiply and add (not vmlaq/vfmaq) to stay bit exact with the reference
+        vst1q_f32(dest + i, vaddq_f32(vld1q_f32(dest + i), vmulq_f32(vld1q_f32(src + i), g)));
+    }
+    _mix_scalar(dest + i, src + i, gain, count - i);
+}
+
+#endif  // DSP_NEON
+
+static const dsp_kernels kernels_scalar = {
+    DSP_ISA_SCALAR, _s16_to_f32_scalar, _f32_to_s16_scalar, _deinterleave2_scalar,
+    _interleave2_scalar, _gain_scalar, _mix_scalar
+};
+
+#ifdef DSP_X86
+static const dsp_kernels kernels_sse2 = {
+    DSP_ISA_SSE2, _s16_to_f32_sse2, _f32_to_s16_sse2, _deinterleave2_sse2,
+    _interleave2_sse2, _gain_sse2, _mix_sse2
+};
+
+static const dsp_kernels kernels_avx2 = {
+    DSP_ISA_AVX2, _s16_to_f32_avx2, _f32_to_s16_avx2, _deinterleave2_sse2,
+    _interleave2_sse2, _gain_avx2, _mix_avx2
+};
+#endif
+
+#ifdef DSP_NEON
+static const dsp_kernels kernels_neon = {
+    DSP_ISA_NEON, _s16_to_f32_neon, _f32_to_s16_neon, _deinterleave2_neon,
+    _interleave2_neon, _gain_neon, _mix_neon
+};
+#endif
+
+void _dsp_ready(void) {
+    if (!kernels_ready) {
+        sc_dsp_init();
+    }
+}
+
+void sc_dsp_init(void) {
+    kernels = kernels_scalar;
+#ifdef DSP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        kernels = kernels_sse2;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels = kernels_avx2;
+    }
+#endif
+#ifdef DSP_NEON
+    kernels = kernels_neon;  // Always present on AArch64
+#endif
+    kernels_ready = true;
+}
+
+uint8_t sc_dsp_set_isa(dsp_isa isa) {
+    _dsp_ready();
+    switch (isa) {
+        case DSP_ISA_SCALAR:
+            kernels = kernels_scalar;
+            return true;
+#ifdef DSP_X86
+        case DSP_ISA_SSE2:
+            if (!__builtin_cpu_supports("sse2")) {
+                return false;
+            }
+            kernels = kernels_sse2;
+            return true;
+        case DSP_ISA_AVX2:
+            if (!__builtin_cpu_supports("avx2")) {
+                return false;
+            }
+            kernels = kernels_avx2;
+            return true;
+#endif
+#ifdef DSP_NEON
+        case DSP_ISA_NEON:
+            kernels = kernels_neon;
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+dsp_isa sc_dsp_get_isa(void) {
+    _dsp_ready();
+    return kernels.isa;
+}
+
+void sc_dsp_s16_to_f32(const int16_t *src, float *dest, uint32_t count) {
+    _dsp_ready();
+    kernels.s16_to_f32(src, dest, count);
+}
+
+void sc_dsp_f32_to_s16(const float *src, int16_t *dest, uint32_t count) {
+    _dsp_ready();
+    kernels.f32_to_s16(src, dest, count);
+}
+
+void sc_dsp_s24_to_f32(const uint8_t *src, float *dest, uint32_t count) {
+    // 3 byte samples do not map onto SIMD lanes without byte shuffles, left to the
+    // compiler's auto-vectoriser
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *b = src + 3 * i;
+        int32_t sample = (int32_t) ((uint32_t) b[0] << 8 | (uint32_t) b[1] << 16 | (uint32_t) b[2] << 24) >> 8;
+        dest[i] = (float) sample * (1.0f / S24_SCALE);
+    }
+}
+
+void sc_dsp_f32_to_s24(const float *src, uint8_t *dest, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        float scaled = _clampf(src[i] * S24_SCALE, -8388608.0f, 8388607.0f);
+        // ROUND_MAGIC only covers |x| < 2^22, so round via the integer conversion's
+        // truncation with an explicit ties-to-even correction instead
+        int32_t truncated = (int32_t) scaled;
+        float frac = scaled - (float) truncated;
+        int32_t sample = truncated;
+        if (frac > 0.5f || (frac == 0.5f && (truncated & 1))) {
+            sample++;
+        } else if (frac < -0.5f || (frac == -0.5f && (truncated & 1))) {
+            sample--;
+        }
+        dest[3 * i] = (uint8_t) sample;
+        dest[3 * i + 1] = (uint8_t) (sample >> 8);
+        dest[3 * i + 2] = (uint8_t) (sample >> 16);
+    }
+}
+
+void sc_dsp_deinterleave_f32(const float *src, float **dest, uint8_t channels, uint32_t frames) {
+    _dsp_ready();
+    if (channels == 2) {
+        kernels.deinterleave2(src, dest[0], dest[1], frames);
+        return;
+    }
+    for (uint32_t i = 0; i < frames; i++) {
+        for (uint8_t c = 0; c < channels; c++) {
+            dest[c][i] = src[i * channels + c];
+        }
+    }
+}
+
+void sc_dsp_interleave_f32(const float **src, float *dest, uint8_t channels, uint32_t frames) {
+    _dsp_ready();
+    if (channels == 2) {
+        kernels.interleave2(src[0], src[1], dest, frames);
+        return;
+    }
+    for (uint32_t i = 0; i < frames; i++) {
+        for (uint8_t c = 0; c < channels; c++) {
+            dest[i * channels + c] = src[c][i];
+        }
+    }
+}
+
+void sc_dsp_gain_f32(float *buffer, float gain, uint32_t count) {
+    _dsp_ready();
+    kernels.gain(buffer, gain, count);
+}
+
+void sc_dsp_mix_f32(float *dest, const float *src, float gain, uint32_t count) {
+    _dsp_ready();
+    kernels.mix(dest, src, gain, count);
+}
@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+
+#include "event_loop.h"
+
+#include "networking.h"
+#include "timing.h"
+#include "logger.h"
+
+#include <string.h>        // memset(...), strerror(...)
+#include <unistd.h>        // read(...), write(...), close(...)
+#include <fcntl.h>         // fcntl(...), O_NONBLOCK
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+
+// Events handled per epoll_wait call
+#define EVENTS_PER_WAIT 16
+
+// epoll data value marking the stop eventfd rather than a source
+#define WAKE_ID -1
+
+int32_t _event_loop_add_source(event_loop_t *loop, int32_t fd, uint8_t is_timer,
+    event_callback callback, void *ctx) {
+    int32_t id = -1;
+    for (int32_t i = 0; i < EVENT_LOOP_SOURCES_MAX; i++) {
+        if (!loop->sources[i].in_use) {
+            id = i;
+            break;
+        }
+    }
+    if (id < 0) {
+        LOG_ERROR("sc_event_loop: no free source slots");
+        return -1;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.events = EPOLLIN;
+    event.data.u32 = (uint32_t) id;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        LOG_ERROR("sc_event_loop: epoll_ctl add failed. Errno [%d] %s", errno, strerror(errno));
+        return -1;
+    }
+    event_source *source = &loop->sources[id];
+    source->fd = fd;
+    source->is_timer = is_timer;
+    source->callback = callback;
+    source->ctx = ctx;
+    source->in_use = true;
+    return id;
+}
+
+uint8_t sc_event_loop_init(event_loop_t *loop) {
+    memset(loop, 0, sizeof(event_loop_t));
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        LOG_ERROR("sc_event_loop_init: epoll_create1 failed. Errno [%d] %s", errno, strerror(errno));
+        return false;
+    }
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->wake_fd < 0) {
+        LOG_ERROR("sc_event_loop_init: eventfd failed. Errno [%d] %s", errno, strerror(errno));
+        close(loop->epoll_fd);
+        return false;
+    }
+    struct epoll_event event;
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.events = EPOLLIN;
+    event.data.u32 = (uint32_t) WAKE_ID;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &event);
+    return true;
+}
+
+void sc_event_loop_close(event_loop_t *loop) {
+    for (int32_t i = 0; i < EVENT_LOOP_SOURCES_MAX; i++) {
+        if (loop->sources[i].in_use) {
+            sc_event_loop_remove(loop, i);
+        }
+    }
+    close(loop->wake_fd);
+    close(loop->epoll_fd);
+}
+
+int32_t sc_event_loop_add_fd(event_loop_t *loop, int32_t fd, event_callback callback, void *ctx) {
+    int32_t flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        LOG_ERROR("sc_event_loop_add_fd: failed to make fd non-blocking. Errno [%d] %s", errno, strerror(errno));
+        return -1;
+    }
+    return _event_loop_add_source(loop, fd, false, callback, ctx);
+}
+
+int32_t sc_event_loop_add_timer(event_loop_t *loop, uint64_t interval_ns, event_callback callback,
+    void *ctx) {
+    int32_t fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("sc_event_loop_add_timer: timerfd_create failed. Errno [%d] %s", errno, strerror(errno));
+        return -1;
+    }
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = interval_ns / NS_PER_SEC;
+    spec.it_interval.tv_nsec = interval_ns % NS_PER_SEC;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(fd, 0, &spec, NULL) < 0) {
+        LOG_ERROR("sc_event_loop_add_timer: timerfd_settime failed. Errno [%d] %s", errno, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    int32_t id = _event_loop_add_source(loop, fd, true, callback, ctx);
+    if (id < 0) {
+        close(fd);
+    }
+    return id;
+}
+
+uint8_t sc_event_loop_align_timer(event_loop_t *loop, int32_t id, uint64_t at_ns) {
+    event_source *source = &loop->sources[id];
+    struct itimerspec spec;
+    if (!source->in_use || !source->is_timer || timerfd_gettime(source->fd, &spec) < 0) {
+        return false;
+    }
+    spec.it_value.tv_sec = at_ns / NS_PER_SEC;
+    spec.it_value.tv_nsec = at_ns % NS_PER_SEC;
+    if (timerfd_settime(source->fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        LOG_ERROR("sc_event_loop_align_timer: timerfd_settime failed. Errno [%d] %s", errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void sc_event_loop_remove(event_loop_t *loop, int32_t id) {
+    event_source *source = &loop->sources[id];
+    if (!source->in_use) {
+        return;
+    }
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+    if (source->is_timer) {
+        close(source->fd);
+    }
+    source->in_use = false;
+}
+
+void _event_loop_advertise(void *ctx) {
+    if (!sc_network_server_advertise((connection_t *) ctx)) {
+        LOG_WARN("Periodic server advertisement failed");
+    }
+}
+
+int32_t sc_event_loop_add_advertiser(event_loop_t *loop, connection_t *conn, uint64_t interval_ns) {
+    return sc_event_loop_add_timer(loop, interval_ns, _event_loop_advertise, conn);
+}
+
+void sc_event_loop_run(event_loop_t *loop) {
+    struct epoll_event events[EVENTS_PER_WAIT];
+
+    while (!__atomic_load_n(&loop->stopped, __ATOMIC_ACQUIRE)) {
+        int32_t count = epoll_wait(loop->epoll_fd, events, EVENTS_PER_WAIT, -1);
+        if (count < 0) {
+            if (errno != EINTR) {
+                LOG_ERROR("sc_event_loop_run: epoll_wait failed. Errno [%d] %s", errno, strerror(errno));
+                break;
+            }
+            continue;
+        }
+        for (int32_t i = 0; i < count; i++) {
+            int32_t id = (int32_t) events[i].data.u32;
+            if (id == WAKE_ID) {
+                uint64_t value;
+                ssize_t unused = read(loop->wake_fd, &value, sizeof(uint64_t));
+                (void) unused;
+                continue;
+            }
+            event_source *source = &loop->sources[id];
+            if (!source->in_use) {
+                continue;  // Removed by an earlier callback in this batch
+            }
+            if (source->is_timer) {
+                // Consume the expiry count so the timer re-arms its readiness
+                uint64_t expirations;
+                if (read(source->fd, &expirations, sizeof(uint64_t)) != sizeof(uint64_t)) {
+                    continue;
+                }
+            }
+            source->callback(source->ctx);
+        }
+    }
+}
+
+void sc_event_loop_stop(event_loop_t *loop) {
+    uint64_t one = 1;
+    __atomic_store_n(&loop->stopped, true, __ATOMIC_RELEASE);
+    ssize_t unused = write(loop->wake_fd, &one, sizeof(uint64_t));
+    (void) unused;
+}
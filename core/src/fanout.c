@@ -0,0 +1,233 @@
+#define _GNU_SOURCE  // sendmmsg(...)
+
+#include "fanout.h"
+
+#include "networking.h"
+#include "datagram.h"
+#include "timing.h"
+#include "logger.h"
+#include "assert.h"
+
+#include <string.h>       // memset(...), memcpy(...), strncpy(...)
+#include <arpa/inet.h>    // htons(...)
+#include <netinet/udp.h>  // SOL_UDP, UDP_SEGMENT
+#include <sys/socket.h>
+#include <sys/uio.h>      // struct iovec
+#include <errno.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103  // linux/udp.h, for C libraries predating UDP GSO
+#endif
+
+uint8_t sc_fanout_init(fanout_t *fanout, uint64_t expiry_ns) {
+    memset(fanout, 0, sizeof(fanout_t));
+    int32_t ret = pthread_mutex_init(&fanout->lock, NULL);
+    if (ret != 0) {
+        LOG_ERROR("sc_fanout_init: pthread_mutex_init failed. Errno [%d] %s", ret, strerror(ret));
+        return false;
+    }
+    fanout->expiry_ns = expiry_ns;
+    fanout->gso_enabled = true;
+    return true;
+}
+
+void sc_fanout_destroy(fanout_t *fanout) {
+    pthread_mutex_destroy(&fanout->lock);
+}
+
+uint32_t sc_fanout_build_request(datagram_t *dest, uint8_t kind, const char *group, uint16_t port) {
+    subscription *sub = (subscription *) dest->payload.audio;
+
+    dest->header.kind = kind;
+    dest->header.sequence = 0;
+    dest->header.timestamp = sc_time_now_ns();
+    memset(sub->group_addr, '\0', INET_ADDRSTRLEN);
+    strncpy(sub->group_addr, group, INET_ADDRSTRLEN - 1);
+    sub->port = htons(port);
+    dest->header.payload_len = sizeof(subscription);
+    return sizeof(datagram_header) + sizeof(subscription);
+}
+
+// Index of the subscriber at `addr`, or -1 if not subscribed
+int32_t _fanout_find(fanout_t *fanout, struct sockaddr_in *addr) {
+    for (uint32_t i = 0; i < fanout->count; i++) {
+        struct sockaddr_in *sub = &fanout->subscribers[i].addr;
+        if (sub->sin_addr.s_addr == addr->sin_addr.s_addr && sub->sin_port == addr->sin_port) {
+            return (int32_t) i;
+        }
+    }
+    return -1;
+}
+
+// Remove by moving the last subscriber into the gap, keeping the array packed
+void _fanout_remove(fanout_t *fanout, uint32_t index) {
+    fanout->subscribers[index] = fanout->subscribers[--fanout->count];
+}
+
+uint32_t _fanout_expire(fanout_t *fanout, uint64_t now_ns) {
+    uint32_t dropped = 0;
+    uint32_t i = 0;
+    while (i < fanout->count) {
+        if (now_ns - fanout->subscribers[i].last_seen_ns > fanout->expiry_ns) {
+            _fanout_remove(fanout, i);
+            dropped++;
+        } else {
+            i++;
+        }
+    }
+    fanout->last_expire_ns = now_ns;
+    fanout->stats.expired += dropped;
+    return dropped;
+}
+
+uint8_t sc_fanout_handle_request(fanout_t *fanout, const datagram_t *request,
+    struct sockaddr_in *src, uint64_t now_ns) {
+    const subscription *sub = (const subscription *) request->payload.audio;
+    uint8_t kind = request->header.kind;
+
+    if ((kind != CLIENT_SUBSCRIBE && kind != CLIENT_KEEPALIVE && kind != CLIENT_UNSUBSCRIBE)
+        || request->header.payload_len < sizeof(subscription)) {
+        LOG_WARN("sc_fanout_handle_request: malformed subscription request");
+        return false;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(struct sockaddr_in));
+    addr.sin_family = AF_INET;
+    addr.sin_addr = src->sin_addr;
+    addr.sin_port = sub->port;
+
+    pthread_mutex_lock(&fanout->lock);
+    int32_t index = _fanout_find(fanout, &addr);
+    if (kind == CLIENT_UNSUBSCRIBE) {
+        if (index >= 0) {
+            _fanout_remove(fanout, (uint32_t) index);
+        }
+    } else if (index >= 0) {
+        fanout->subscribers[index].last_seen_ns = now_ns;
+    } else if (fanout->count < FANOUT_SUBSCRIBERS_MAX) {
+        // A keepalive from an unknown client (e.g. after a server restart) resubscribes it
+        subscriber *added = &fanout->subscribers[fanout->count++];
+        added->addr = addr;
+        added->last_seen_ns = now_ns;
+        fanout->stats.subscribed++;
+    } else {
+        LOG_WARN("sc_fanout_handle_request: subscriber limit (%d) reached", FANOUT_SUBSCRIBERS_MAX);
+    }
+    pthread_mutex_unlock(&fanout->lock);
+    return true;
+}
+
+uint32_t sc_fanout_expire(fanout_t *fanout, uint64_t now_ns) {
+    pthread_mutex_lock(&fanout->lock);
+    uint32_t dropped = _fanout_expire(fanout, now_ns);
+    pthread_mutex_unlock(&fanout->lock);
+    return dropped;
+}
+
+// Send `segments` datagrams (2 iovecs each) to subscribers from `first` onward. Several
+// segments are sent as one UDP_SEGMENT message of `segment_size` byte datagrams (the
+// last may be shorter). Falls back to one message per datagram if GSO is refused.
+// Returns the number of datagram copies sent.
+uint32_t _fanout_send_run(fanout_t *fanout, int32_t socket_fd, struct iovec *iov, uint32_t segments,
+    uint16_t segment_size, uint32_t first) {
+    struct mmsghdr msgs[NETWORK_BATCH_MAX];
+    union {
+        char           buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control;
+    uint8_t use_gso = segments > 1;
+    uint32_t sent_total = 0;
+
+    if (use_gso) {
+        // Identical for every subscriber, so all messages share one control buffer
+        memset(&control, 0, sizeof(control));
+        struct cmsghdr *cmsg = (struct cmsghdr *) control.buf;
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(uint16_t));
+    }
+
+    for (uint32_t base = first; base < fanout->count; base += NETWORK_BATCH_MAX) {
+        uint32_t batch = fanout->count - base;
+        if (batch > NETWORK_BATCH_MAX) {
+            batch = NETWORK_BATCH_MAX;
+        }
+        memset(msgs, 0, sizeof(struct mmsghdr) * batch);
+        for (uint32_t i = 0; i < batch; i++) {
+            msgs[i].msg_hdr.msg_name = &fanout->subscribers[base + i].addr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = iov;
+            msgs[i].msg_hdr.msg_iovlen = 2 * segments;
+            if (use_gso) {
+                msgs[i].msg_hdr.msg_control = control.buf;
+                msgs[i].msg_hdr.msg_controllen = sizeof(control.buf);
+            }
+        }
+
+        uint32_t offset = 0;
+        while (offset < batch) {
+            int32_t sent = sendmmsg(socket_fd, &msgs[offset], batch - offset, 0);
+            if (sent <= 0) {
+                if (use_gso && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)) {
+                    LOG_WARN("UDP_SEGMENT refused, falling back to per-datagram sends. Errno [%d] %s",
+                        errno, strerror(errno));
+                    fanout->gso_enabled = false;
+                    for (uint32_t s = 0; s < segments; s++) {
+                        sent_total += _fanout_send_run(fanout, socket_fd, &iov[2 * s], 1, 0, base + offset);
+                    }
+                    return sent_total;
+                }
+                // Skip the subscriber the kernel rejected and carry on with the rest
+                fanout->stats.send_errors += segments;
+                offset++;
+                continue;
+            }
+            sent_total += (uint32_t) sent * segments;
+            fanout->stats.gso_sends += use_gso ? (uint32_t) sent : 0;
+            offset += sent;
+        }
+    }
+    return sent_total;
+}
+
+uint32_t sc_fanout_send(fanout_t *fanout, int32_t socket_fd, datagram_t **dgrams, uint32_t *lens,
+    uint32_t count) {
+    datagram_header wire_headers[NETWORK_BATCH_MAX];
+    struct iovec iovecs[NETWORK_BATCH_MAX * 2];
+    uint32_t sent_total = 0;
+
+    CORE_ASSERT(count <= NETWORK_BATCH_MAX);
+    // Headers are encoded once and shared by every subscriber's copy
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t payload_len = lens[i] - sizeof(datagram_header);
+        sc_datagram_header_encode(&dgrams[i]->header, payload_len, &wire_headers[i]);
+        iovecs[2 * i].iov_base = &wire_headers[i];
+        iovecs[2 * i].iov_len = sizeof(datagram_header);
+        iovecs[2 * i + 1].iov_base = &dgrams[i]->payload;
+        iovecs[2 * i + 1].iov_len = payload_len;
+    }
+
+    pthread_mutex_lock(&fanout->lock);
+    uint64_t now_ns = sc_time_now_ns();
+    if (now_ns - fanout->last_expire_ns > fanout->expiry_ns / 4) {
+        _fanout_expire(fanout, now_ns);
+    }
+
+    uint32_t start = 0;
+    while (start < count) {
+        // Every segment of a GSO send but the last must be exactly the segment size
+        uint32_t run = 1;
+        if (fanout->gso_enabled) {
+            while (start + run < count && run < FANOUT_GSO_SEGMENTS_MAX
+                && lens[start + run - 1] == lens[start] && lens[start + run] <= lens[start]) {
+                run++;
+            }
+        }
+        sent_total += _fanout_send_run(fanout, socket_fd, &iovecs[2 * start], run, (uint16_t) lens[start], 0);
+        start += run;
+    }
+    fanout->stats.sent += sent_total;
+    pthread_mutex_unlock(&fanout->lock);
+    return sent_total;
+}
@@ -0,0 +1,231 @@
+#include "fast_join.h"
+
+#include "networking.h"
+#include "datagram.h"
+#include "timing.h"
+#include "logger.h"
+
+#include <stdio.h>      // fopen(...), fprintf(...), fscanf(...), rename(...)
+#include <string.h>     // memset(...), strncpy(...)
+#include <arpa/inet.h>  // htons(...), ntohs(...), htonl(...), ntohl(...)
+#include <errno.h>
+
+#define CACHE_MASK (RETRANSMIT_CACHE_CAPACITY - 1)
+
+void sc_fast_join_init(fast_join_t *fj, const char *group, uint32_t chunk, uint64_t interval_ns) {
+    memset(fj, 0, sizeof(fast_join_t));
+    strncpy(fj->group_addr, group, INET_ADDRSTRLEN - 1);
+    fj->chunk = chunk ? chunk : 1;
+    fj->interval_ns = interval_ns;
+}
+
+uint32_t sc_fast_join_build_request(datagram_t *dest, const char *group, uint16_t port,
+    uint16_t frames, const datagram_t *received) {
+    join_request *req = (join_request *) dest->payload.audio;
+
+    dest->header.kind = CLIENT_JOIN;
+    dest->header.sequence = 0;
+    dest->header.timestamp = sc_time_now_ns();
+    memset(req->group_addr, '\0', INET_ADDRSTRLEN);
+    strncpy(req->group_addr, group, INET_ADDRSTRLEN - 1);
+    req->port = htons(port);
+    req->frames = htons(frames);
+    req->sequence = htonl(received->header.sequence);
+    req->timestamp = HTONLL(received->header.timestamp);
+    dest->header.payload_len = sizeof(join_request);
+    return sizeof(datagram_header) + sizeof(join_request);
+}
+
+// Returns true if `req` echoes a datagram of the group still in `cache`, false otherwise.
+uint8_t _fast_join_proven(retransmit_cache_t *cache, const join_request *req) {
+    uint32_t sequence = ntohl(req->sequence);
+    const retransmit_entry *entry = &cache->entries[sequence & CACHE_MASK];
+    return entry->len > 0 && entry->dgram.header.sequence == sequence
+        && entry->dgram.header.timestamp == HTONLL(req->timestamp);
+}
+
+// Record `addr` as answered at `now_ns`.
+// Returns true if it was not answered within FAST_JOIN_SOURCE_INTERVAL_NS, false otherwise.
+uint8_t _fast_join_admit(fast_join_t *fj, struct in_addr addr, uint64_t now_ns) {
+    join_source *slot = &fj->sources[0];
+    for (uint32_t i = 0; i < FAST_JOIN_SOURCES_MAX; i++) {
+        join_source *source = &fj->sources[i];
+        if (source->answered_ns && source->addr.s_addr == addr.s_addr) {
+            if (now_ns - source->answered_ns < FAST_JOIN_SOURCE_INTERVAL_NS) {
+                return false;
+            }
+            slot = source;
+            break;
+        }
+        // Otherwise reuse the least recently answered source
+        if (source->answered_ns < slot->answered_ns) {
+            slot = source;
+        }
+    }
+    slot->addr = addr;
+    slot->answered_ns = now_ns;
+    return true;
+}
+
+uint8_t sc_fast_join_handle_request(fast_join_t *fj, retransmit_cache_t *cache,
+    const datagram_t *request, struct sockaddr_in *src, uint64_t now_ns) {
+    const join_request *req = (const join_request *) request->payload.audio;
+    join_burst *burst = NULL;
+
+    if (request->header.kind != CLIENT_JOIN || request->header.payload_len < sizeof(join_request)) {
+        LOG_WARN("sc_fast_join_handle_request: malformed join request");
+        fj->stats.rejected++;
+        return false;
+    }
+    uint32_t frames = ntohs(req->frames);
+    if (frames == 0 || strncmp(req->group_addr, fj->group_addr, INET_ADDRSTRLEN) != 0 || !cache->stored) {
+        fj->stats.rejected++;
+        return false;
+    }
+    if (!_fast_join_proven(cache, req)) {
+        fj->stats.unproven++;
+        return false;
+    }
+    for (uint32_t i = 0; i < FAST_JOIN_BURSTS_MAX; i++) {
+        if (!fj->bursts[i].active) {
+            burst = &fj->bursts[i];
+            break;
+        }
+    }
+    if (!burst) {
+        LOG_WARN("sc_fast_join_handle_request: all %d burst slots busy", FAST_JOIN_BURSTS_MAX);
+        fj->stats.rejected++;
+        return false;
+    }
+    if (!_fast_join_admit(fj, src->sin_addr, now_ns)) {
+        fj->stats.limited++;
+        return false;
+    }
+    if (frames > FAST_JOIN_FRAMES_MAX) {
+        frames = FAST_JOIN_FRAMES_MAX;
+    }
+    memset(&burst->addr, 0, sizeof(struct sockaddr_in));
+    burst->addr.sin_family = AF_INET;
+    burst->addr.sin_addr = src->sin_addr;
+    burst->addr.sin_port = req->port;
+    burst->end_sequence = cache->newest_sequence + 1;
+    burst->next_sequence = burst->end_sequence - frames;
+    burst->next_send_ns = now_ns;
+    burst->active = true;
+    fj->stats.joins++;
+    return true;
+}
+
+uint32_t sc_fast_join_poll(fast_join_t *fj, retransmit_cache_t *cache, connection_t *conn,
+    uint64_t now_ns) {
+    uint32_t sent_total = 0;
+
+    for (uint32_t i = 0; i < FAST_JOIN_BURSTS_MAX; i++) {
+        join_burst *burst = &fj->bursts[i];
+        if (!burst->active || now_ns < burst->next_send_ns) {
+            continue;
+        }
+        for (uint32_t n = 0; n < fj->chunk && burst->next_sequence != burst->end_sequence; n++) {
+            uint32_t sequence = burst->next_sequence++;
+            retransmit_entry *entry = &cache->entries[sequence & CACHE_MASK];
+            // Oldest datagrams may have been overwritten by live audio since the request
+            if (entry->len == 0 || entry->dgram.header.sequence != sequence) {
+                fj->stats.missed++;
+                continue;
+            }
+            if (sc_network_send_to(conn, &entry->dgram, entry->len, &burst->addr)) {
+                sent_total++;
+            }
+        }
+        burst->next_send_ns = now_ns + fj->interval_ns;
+        burst->active = burst->next_sequence != burst->end_sequence;
+    }
+    fj->stats.sent += sent_total;
+    return sent_total;
+}
+
+uint8_t sc_fast_join_active(fast_join_t *fj) {
+    for (uint32_t i = 0; i < FAST_JOIN_BURSTS_MAX; i++) {
+        if (fj->bursts[i].active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t sc_known_servers_load(known_servers_t *ks, const char *path, uint64_t max_age_ns) {
+    known_server entry;
+    unsigned int codec;
+    unsigned long long seen;
+    uint64_t now = sc_time_wall_ns();
+
+    memset(ks, 0, sizeof(known_servers_t));
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        if (errno != ENOENT) {
+            LOG_WARN("sc_known_servers_load: cannot open %s. Errno [%d] %s", path, errno, strerror(errno));
+        }
+        return false;
+    }
+    // One "server group codec seen_wall_ns" line per server, most recent first
+    while (ks->count < KNOWN_SERVERS_MAX
+        && fscanf(file, "%15s %15s %u %llu", entry.server_addr, entry.group_addr, &codec, &seen) == 4) {
+        entry.codec = (uint8_t) codec;
+        entry.seen_wall_ns = seen;
+        if (now - entry.seen_wall_ns <= max_age_ns) {
+            ks->servers[ks->count++] = entry;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+uint8_t sc_known_servers_save(const known_servers_t *ks, const char *path) {
+    char temp_path[4096];
+
+    // Written beside the target then renamed over it, so readers never see a partial file
+    if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= (int) sizeof(temp_path)) {
+        LOG_WARN("sc_known_servers_save: path too long");
+        return false;
+    }
+    FILE *file = fopen(temp_path, "w");
+    if (!file) {
+        LOG_WARN("sc_known_servers_save: cannot open %s. Errno [%d] %s", temp_path, errno, strerror(errno));
+        return false;
+    }
+    for (uint32_t i = 0; i < ks->count; i++) {
+        const known_server *entry = &ks->servers[i];
+        fprintf(file, "%.*s %.*s %u %llu\n", INET_ADDRSTRLEN, entry->server_addr,
+            INET_ADDRSTRLEN, entry->group_addr, entry->codec, (unsigned long long) entry->seen_wall_ns);
+    }
+    if (fclose(file) != 0 || rename(temp_path, path) != 0) {
+        LOG_WARN("sc_known_servers_save: cannot write %s. Errno [%d] %s", path, errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void sc_known_servers_remember(known_servers_t *ks, const char *server, const char *group,
+    uint8_t codec) {
+    known_server entry;
+    memset(&entry, 0, sizeof(known_server));
+    strncpy(entry.server_addr, server, INET_ADDRSTRLEN - 1);
+    strncpy(entry.group_addr, group, INET_ADDRSTRLEN - 1);
+    entry.codec = codec;
+    entry.seen_wall_ns = sc_time_wall_ns();
+
+    // Drop any older record of the same server and group, or else the least recent
+    uint32_t remove = ks->count < KNOWN_SERVERS_MAX ? ks->count : KNOWN_SERVERS_MAX - 1;
+    for (uint32_t i = 0; i < ks->count; i++) {
+        if (strncmp(ks->servers[i].server_addr, entry.server_addr, INET_ADDRSTRLEN) == 0
+            && strncmp(ks->servers[i].group_addr, entry.group_addr, INET_ADDRSTRLEN) == 0) {
+            remove = i;
+            break;
+        }
+    }
+    if (remove == ks->count) {
+        ks->count++;
+    }
+    memmove(&ks->servers[1], &ks->servers[0], remove * sizeof(known_server));
+    ks->servers[0] = entry;
+}
@@ -0,0 +1,181 @@
+#include "fec.h"
+
+#include "datagram.h"
+#include "packetizer.h"
+#include "timing.h"
+#include "assert.h"
+#include "logger.h"
+
+#include <string.h>     // memset(...), memcpy(...)
+#include <arpa/inet.h>  // htonl(...), htons(...), ntohl(...), ntohs(...)
+
+// A packetizer's full fragment at FEC_PROTECTED_DATAGRAM_MAX must itself be protectable
+CORE_STATIC_ASSERT(sizeof(audio_fragment_header) + AUDIO_FRAGMENT_CAPACITY(FEC_PROTECTED_DATAGRAM_MAX)
+    <= FEC_PROTECTED_PAYLOAD_MAX, fec_fits_packetizer);
+
+// 16 byte vector. GCC/Clang lower XOR on it to SSE2 on x86 and NEON on ARM.
+typedef uint8_t xor_block __attribute__((vector_size(16)));
+
+// dest ^= src over `len` bytes
+void _fec_xor(uint8_t *dest, const uint8_t *src, uint32_t len) {
+    uint32_t i = 0;
+    for (; i + sizeof(xor_block) <= len; i += sizeof(xor_block)) {
+        xor_block a, b;
+        memcpy(&a, dest + i, sizeof(xor_block));  // Unaligned safe loads/stores
+        memcpy(&b, src + i, sizeof(xor_block));
+        a ^= b;
+        memcpy(dest + i, &a, sizeof(xor_block));
+    }
+    for (; i < len; i++) {
+        dest[i] ^= src[i];
+    }
+}
+
+fec_header *_fec_header(datagram_t *dgram) {
+    return (fec_header *) dgram->payload.audio;
+}
+
+uint8_t *_fec_parity_bytes(datagram_t *dgram) {
+    return dgram->payload.audio + sizeof(fec_header);
+}
+
+void _fec_encoder_reset(fec_encoder_t *enc, uint32_t base_sequence) {
+    enc->count = 0;
+    enc->max_len = 0;
+    enc->next_sequence = base_sequence;
+    memset(&enc->parity, 0, sizeof(datagram_header) + sizeof(fec_header) + FEC_PROTECTED_PAYLOAD_MAX);
+    enc->parity.header.kind = SERVER_FEC;
+    enc->parity.header.sequence = base_sequence;
+    _fec_header(&enc->parity)->base_sequence = base_sequence;
+}
+
+void sc_fec_encoder_init(fec_encoder_t *enc, uint8_t group_size) {
+    CORE_ASSERT(group_size >= 2 && group_size <= FEC_GROUP_MAX);
+    enc->group_size = group_size;
+    _fec_encoder_reset(enc, 0);
+}
+
+datagram_t *sc_fec_encoder_add(fec_encoder_t *enc, const datagram_t *dgram, uint32_t len,
+    uint32_t *parity_len) {
+    uint16_t payload_len = len - sizeof(datagram_header);
+    fec_header *fec = _fec_header(&enc->parity);
+
+    if (payload_len > FEC_PROTECTED_PAYLOAD_MAX) {
+        LOG_WARN("sc_fec_encoder_add: payload (%d) too large to protect", payload_len);
+        _fec_encoder_reset(enc, dgram->header.sequence + 1);
+        return NULL;
+    }
+    if (enc->count == 0 || dgram->header.sequence != enc->next_sequence) {
+        _fec_encoder_reset(enc, dgram->header.sequence);
+    }
+
+    // Held in host order while accumulating, converted once the group completes
+    _fec_xor(_fec_parity_bytes(&enc->parity), dgram->payload.audio, payload_len);
+    fec->length_xor ^= payload_len;
+    fec->timestamp_xor ^= dgram->header.timestamp;
+    enc->max_len = payload_len > enc->max_len ? payload_len : enc->max_len;
+    enc->next_sequence++;
+    if (++enc->count < enc->group_size) {
+        return NULL;
+    }
+
+    fec->base_sequence = htonl(fec->base_sequence);
+    fec->group_size = enc->group_size;
+    fec->length_xor = htons(fec->length_xor);
+    fec->timestamp_xor = HTONLL(fec->timestamp_xor);
+    enc->parity.header.timestamp = sc_time_now_ns();
+    enc->count = 0;  // Next add starts a fresh group
+
+    *parity_len = sizeof(datagram_header) + sizeof(fec_header) + enc->max_len;
+    return &enc->parity;
+}
+
+void sc_fec_decoder_init(fec_decoder_t *dec) {
+    memset(dec, 0, sizeof(fec_decoder_t));
+}
+
+void sc_fec_decoder_add_parity(fec_decoder_t *dec, const datagram_t *parity, uint32_t len) {
+    if (len < sizeof(datagram_header) + sizeof(fec_header)) {
+        LOG_WARN("sc_fec_decoder_add_parity: truncated parity datagram");
+        return;
+    }
+    // Oldest held parity is overwritten when full
+    fec_pending *slot = &dec->pending[dec->next_slot++ & (FEC_DECODER_PENDING - 1)];
+    memcpy(&slot->dgram, parity, len);
+    uint8_t group_size = _fec_header(&slot->dgram)->group_size;
+    if (group_size >= 2 && group_size <= FEC_GROUP_MAX) {
+        dec->group_size = group_size;
+    }
+    // Zero the tail so shorter protected payloads XOR against padding
+    memset((uint8_t *) &slot->dgram + len, 0, sizeof(datagram_t) - len);
+    slot->in_use = true;
+}
+
+// Try to rebuild the single missing datagram of `pending`'s group.
+// Returns true if the parity is finished with (used, or useless), false to keep holding it.
+uint8_t _fec_try_recover(fec_decoder_t *dec, fec_pending *pending, jitter_buffer_t *jb) {
+    fec_header *fec = _fec_header(&pending->dgram);
+    uint32_t base = ntohl(fec->base_sequence);
+    uint32_t missing_sequence = 0;
+    uint32_t missing = 0;
+    uint32_t len;
+
+    if (fec->group_size < 2 || fec->group_size > FEC_GROUP_MAX) {
+        return true;
+    }
+    // Members already played out still count, their slots hold them until reused
+    for (uint32_t i = 0; i < fec->group_size; i++) {
+        if (!sc_jitter_buffer_recent(jb, base + i, &len)) {
+            missing_sequence = base + i;
+            missing++;
+        }
+    }
+    if (missing == 0) {
+        return true;
+    }
+    if (!sc_jitter_buffer_pending(jb, missing_sequence)) {
+        // The hole has already been played out (or passed), too late to fill
+        dec->stats.unrecovered++;
+        return true;
+    }
+    if (missing > 1) {
+        return false;  // Others may still arrive late
+    }
+
+    datagram_t recovered;
+    uint16_t payload_len = ntohs(fec->length_xor);
+    uint64_t timestamp = HTONLL(fec->timestamp_xor);
+    memcpy(recovered.payload.audio, _fec_parity_bytes(&pending->dgram), FEC_PROTECTED_PAYLOAD_MAX);
+    for (uint32_t i = 0; i < fec->group_size; i++) {
+        const datagram_t *dgram = sc_jitter_buffer_recent(jb, base + i, &len);
+        if (dgram) {
+            _fec_xor(recovered.payload.audio, dgram->payload.audio, dgram->header.payload_len);
+            payload_len ^= dgram->header.payload_len;
+            timestamp ^= dgram->header.timestamp;
+        }
+    }
+    if (payload_len > FEC_PROTECTED_PAYLOAD_MAX) {
+        LOG_WARN("sc_fec_decoder_recover: inconsistent parity for group %u", base);
+        return true;
+    }
+    recovered.header.version = DATAGRAM_VERSION;
+    recovered.header.kind = SERVER_AUDIO;
+    recovered.header.payload_len = payload_len;
+    recovered.header.sequence = missing_sequence;
+    recovered.header.timestamp = timestamp;
+    if (sc_jitter_buffer_push_recovered(jb, &recovered, sizeof(datagram_header) + payload_len) == JITTER_PUSH_OK) {
+        dec->stats.recovered++;
+    }
+    return true;
+}
+
+uint32_t sc_fec_decoder_recover(fec_decoder_t *dec, jitter_buffer_t *jb) {
+    uint64_t recovered_before = dec->stats.recovered;
+    for (uint32_t i = 0; i < FEC_DECODER_PENDING; i++) {
+        fec_pending *pending = &dec->pending[i];
+        if (pending->in_use && _fec_try_recover(dec, pending, jb)) {
+            pending->in_use = false;
+        }
+    }
+    return dec->stats.recovered - recovered_before;
+}
@@ -0,0 +1,276 @@
+#include "jitter_buffer.h"
+
+#include "assert.h"
+
+#include <string.h>  // memset(...), memcpy(...)
+
+#define SLOT_MASK (JITTER_BUFFER_CAPACITY - 1)
+
+// Frames of headroom above target depth before excess delay is discarded
+#define EXCESS_DEPTH_MARGIN 4
+
+// Jitter multiple covered by the playout delay (~4 standard deviations)
+#define JITTER_DEPTH_FACTOR 4
+
+void _jitter_buffer_update_target(jitter_buffer_t *jb) {
+    uint64_t cover_ns = jb->jitter_ns * JITTER_DEPTH_FACTOR;
+    uint32_t depth = jb->min_depth
+        + (uint32_t) ((cover_ns + jb->frame_interval_ns - 1) / jb->frame_interval_ns);
+    jb->target_depth = depth > jb->max_depth ? jb->max_depth : depth;
+}
+
+void _jitter_buffer_update_jitter(jitter_buffer_t *jb, const datagram_t *dgram, uint64_t arrival_ns) {
+    int64_t transit = (int64_t) (arrival_ns - dgram->header.timestamp);
+    if (jb->has_transit) {
+        int64_t d = transit - jb->last_transit_ns;
+        uint64_t abs_d = (uint64_t) (d < 0 ? -d : d);
+        // jitter += (|D| - jitter) / 16
+        if (abs_d > jb->jitter_ns) {
+            jb->jitter_ns += (abs_d - jb->jitter_ns) >> JITTER_BUFFER_JITTER_SHIFT;
+        } else {
+            jb->jitter_ns -= (jb->jitter_ns - abs_d) >> JITTER_BUFFER_JITTER_SHIFT;
+        }
+    }
+    jb->last_transit_ns = transit;
+    jb->has_transit = true;
+    _jitter_buffer_update_target(jb);
+}
+
+// Drop the slot at `next_sequence` and move playout forward by one frame.
+void _jitter_buffer_advance(jitter_buffer_t *jb) {
+    jitter_slot *slot = &jb->slots[jb->next_sequence & SLOT_MASK];
+    if (slot->occupied) {
+        slot->occupied = false;
+        jb->count--;
+    }
+    jb->next_sequence++;
+}
+
+// Empty the buffer and restart playout at `sequence`, refilling before playing.
+void _jitter_buffer_resync(jitter_buffer_t *jb, uint32_t sequence) {
+    // Played datagrams are forgotten too, the restarted stream may reuse their sequences
+    for (uint32_t i = 0; i < JITTER_BUFFER_CAPACITY; i++) {
+        jb->slots[i].occupied = false;
+        jb->slots[i].len = 0;
+    }
+    jb->count = 0;
+    jb->next_sequence = sequence;
+    jb->highest_sequence = sequence;
+    jb->playing = false;
+    // The sender's clock may have restarted too
+    jb->has_transit = false;
+    jb->stats.resyncs++;
+}
+
+void sc_jitter_buffer_init(jitter_buffer_t *jb, uint32_t min_depth, uint32_t max_depth,
+    uint64_t frame_interval_ns) {
+    CORE_ASSERT(min_depth <= max_depth);
+    CORE_ASSERT(max_depth <= JITTER_BUFFER_CAPACITY);
+    CORE_ASSERT(frame_interval_ns > 0);
+
+    memset(jb, 0, sizeof(jitter_buffer_t));
+    jb->min_depth = min_depth;
+    jb->max_depth = max_depth;
+    jb->target_depth = min_depth;
+    jb->frame_interval_ns = frame_interval_ns;
+}
+
+// Slot a datagram by sequence. Shared by received and recovered datagrams.
+jitter_push_result _jitter_buffer_store(jitter_buffer_t *jb, const datagram_t *dgram, uint32_t len) {
+    uint32_t sequence = dgram->header.sequence;
+
+    CORE_ASSERT(len <= sizeof(datagram_t));
+    if (!jb->started) {
+        jb->next_sequence = sequence;
+        jb->highest_sequence = sequence;
+        jb->started = true;
+    }
+
+    // Signed distance handles sequence wrap around
+    int32_t ahead = (int32_t) (sequence - jb->next_sequence);
+    if (ahead >= JITTER_BUFFER_RESYNC_DISTANCE || ahead < -JITTER_BUFFER_RESYNC_DISTANCE) {
+        // Only a run of consecutive datagrams at the new position shows a restart
+        if (jb->probation_count == 0 || sequence != jb->probation_sequence) {
+            jb->probation_count = 0;
+        }
+        jb->probation_sequence = sequence + 1;
+        if (++jb->probation_count < JITTER_BUFFER_PROBATION) {
+            jb->stats.strays++;
+            return JITTER_PUSH_STRAY;
+        }
+        jb->probation_count = 0;
+        _jitter_buffer_resync(jb, sequence);
+        ahead = 0;
+    }
+    if (ahead < 0) {
+        jb->stats.late++;
+        return JITTER_PUSH_LATE;
+    }
+    // Too far ahead to fit: skip playout forward, the skipped frames are lost
+    while (ahead >= JITTER_BUFFER_CAPACITY) {
+        if (jb->slots[jb->next_sequence & SLOT_MASK].occupied) {
+            jb->stats.discarded++;
+        } else {
+            jb->stats.missing++;
+        }
+        _jitter_buffer_advance(jb);
+        ahead--;
+    }
+
+    jitter_slot *slot = &jb->slots[sequence & SLOT_MASK];
+    if (slot->occupied) {
+        jb->stats.duplicates++;
+        return JITTER_PUSH_DUPLICATE;
+    }
+    memcpy(&slot->dgram, dgram, len);
+    slot->len = len;
+    slot->occupied = true;
+    jb->count++;
+    if ((int32_t) (sequence - jb->highest_sequence) > 0) {
+        jb->highest_sequence = sequence;
+    }
+    return JITTER_PUSH_OK;
+}
+
+jitter_push_result sc_jitter_buffer_push(jitter_buffer_t *jb, const datagram_t *dgram,
+    uint32_t len, uint64_t arrival_ns) {
+    jitter_push_result result = _jitter_buffer_store(jb, dgram, len);
+    if (result == JITTER_PUSH_OK) {
+        _jitter_buffer_update_jitter(jb, dgram, arrival_ns);
+        jb->stats.received++;
+    }
+    return result;
+}
+
+void sc_jitter_buffer_flush(jitter_buffer_t *jb) {
+    for (uint32_t i = 0; i < JITTER_BUFFER_CAPACITY; i++) {
+        if (jb->slots[i].occupied) {
+            jb->slots[i].occupied = false;
+            jb->stats.discarded++;
+        }
+    }
+    jb->count = 0;
+    if (jb->started) {
+        jb->next_sequence = jb->highest_sequence + 1;
+    }
+    jb->playing = false;
+}
+
+jitter_push_result sc_jitter_buffer_push_recovered(jitter_buffer_t *jb, const datagram_t *dgram,
+    uint32_t len) {
+    jitter_push_result result = _jitter_buffer_store(jb, dgram, len);
+    if (result == JITTER_PUSH_OK) {
+        jb->stats.recovered++;
+    }
+    return result;
+}
+
+// Pop the frame at `next_sequence`, or report it missing.
+jitter_pop_result _jitter_buffer_take(jitter_buffer_t *jb, datagram_t *dest, uint32_t *len) {
+    jitter_slot *slot = &jb->slots[jb->next_sequence & SLOT_MASK];
+    if (!slot->occupied) {
+        jb->stats.missing++;
+        jb->next_sequence++;
+        return JITTER_POP_MISSING;
+    }
+    memcpy(dest, &slot->dgram, slot->len);
+    *len = slot->len;
+    jb->stats.played++;
+    _jitter_buffer_advance(jb);
+    return JITTER_POP_FRAME;
+}
+
+jitter_pop_result sc_jitter_buffer_pop(jitter_buffer_t *jb, datagram_t *dest, uint32_t *len) {
+    if (!jb->playing) {
+        if (jb->count == 0 || jb->count < jb->target_depth) {
+            return JITTER_POP_BUFFERING;
+        }
+        jb->playing = true;
+    }
+    if (jb->count == 0) {
+        // Ran dry: refill to target depth before resuming
+        jb->playing = false;
+        jb->stats.underruns++;
+        return JITTER_POP_BUFFERING;
+    }
+    // Holding well beyond what jitter requires: drop the oldest frames to cut delay
+    while (jb->count > jb->target_depth + EXCESS_DEPTH_MARGIN) {
+        if (jb->slots[jb->next_sequence & SLOT_MASK].occupied) {
+            jb->stats.discarded++;
+        } else {
+            jb->stats.missing++;
+        }
+        _jitter_buffer_advance(jb);
+    }
+    return _jitter_buffer_take(jb, dest, len);
+}
+
+jitter_pop_result sc_jitter_buffer_pop_due(jitter_buffer_t *jb, datagram_t *dest, uint32_t *len,
+    uint64_t due_ns) {
+    int64_t tolerance = (int64_t) jb->frame_interval_ns / 2;
+
+    while (jb->count > 0) {
+        // Stamp of the frame at `next_sequence`, extrapolated from the first one buffered
+        uint32_t ahead = 0;
+        while (!jb->slots[(jb->next_sequence + ahead) & SLOT_MASK].occupied) {
+            ahead++;
+        }
+        const jitter_slot *slot = &jb->slots[(jb->next_sequence + ahead) & SLOT_MASK];
+        int64_t early = (int64_t) (slot->dgram.header.timestamp - ahead * jb->frame_interval_ns - due_ns);
+        if (early > tolerance) {
+            return JITTER_POP_BUFFERING;
+        }
+        if (early >= -tolerance) {
+            jb->playing = true;
+            return _jitter_buffer_take(jb, dest, len);
+        }
+        // Its playout has passed
+        if (ahead == 0) {
+            jb->stats.discarded++;
+        } else {
+            jb->stats.missing++;
+        }
+        _jitter_buffer_advance(jb);
+    }
+    if (jb->playing) {
+        jb->playing = false;
+        jb->stats.underruns++;
+    }
+    return JITTER_POP_BUFFERING;
+}
+
+uint64_t sc_jitter_buffer_delay_ns(jitter_buffer_t *jb) {
+    return jb->count * jb->frame_interval_ns;
+}
+
+const datagram_t *sc_jitter_buffer_peek(jitter_buffer_t *jb, uint32_t sequence, uint32_t *len) {
+    if (!sc_jitter_buffer_pending(jb, sequence)) {
+        return NULL;
+    }
+    jitter_slot *slot = &jb->slots[sequence & SLOT_MASK];
+    if (!slot->occupied) {
+        return NULL;
+    }
+    *len = slot->len;
+    return &slot->dgram;
+}
+
+const datagram_t *sc_jitter_buffer_recent(jitter_buffer_t *jb, uint32_t sequence, uint32_t *len) {
+    jitter_slot *slot = &jb->slots[sequence & SLOT_MASK];
+    // Slots keep their datagram after playout until a later sequence reuses them
+    if (!jb->started || slot->len == 0 || slot->dgram.header.sequence != sequence) {
+        return NULL;
+    }
+    *len = slot->len;
+    return &slot->dgram;
+}
+
+void sc_jitter_buffer_set_min_depth(jitter_buffer_t *jb, uint32_t min_depth) {
+    jb->min_depth = min_depth < jb->max_depth ? min_depth : jb->max_depth;
+    _jitter_buffer_update_target(jb);
+}
+
+uint8_t sc_jitter_buffer_pending(jitter_buffer_t *jb, uint32_t sequence) {
+    int32_t ahead = (int32_t) (sequence - jb->next_sequence);
+    return jb->started && ahead >= 0 && ahead < JITTER_BUFFER_CAPACITY;
+}
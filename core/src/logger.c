@@ -1,31 +1,188 @@
 #include "logger.h"
 
-#include <stdio.h>   // printf
-#include <stdlib.h>  // malloc and free
-#include <stdarg.h>  // variadic argument parsing
+#include <stdio.h>      // vsnprintf(...), fwrite(...)
+#include <stdarg.h>     // variadic argument parsing
+#include <string.h>     // memcpy(...)
+#include <pthread.h>
+#include <sched.h>      // sched_yield(...)
+#include <semaphore.h>  // sem_post(...) never blocks, so producers stay lock-free
+
+#define QUEUE_MASK (LOG_QUEUE_CAPACITY - 1)
+
+// Longest output line: prefix, ": ", message, newline
+#define LOG_LINE_MAX (LOG_RECORD_MAX + 16)
+
+// Bounded multi-producer queue slot (D. Vyukov's design). `sequence` tells producers and
+// the consumer whose turn it is to touch the slot, so no slot is ever locked.
+typedef struct {
+    uint32_t sequence;
+    uint8_t  level;
+    uint16_t len;
+    char     text[LOG_RECORD_MAX];
+} log_record;
+
+static const char* prefix[5] = {"[FATAL]", "[ERROR]", "[WARN]", "[INFO]", "[DEBUG]"};
+
+static log_record queue[LOG_QUEUE_CAPACITY];
+static uint32_t enqueue_pos __attribute__((aligned(CACHE_LINE_SIZE)));
+static uint32_t dequeue_pos __attribute__((aligned(CACHE_LINE_SIZE)));
+static uint64_t dropped;
+static uint8_t  running;
+static uint32_t inflight;  // Producers between checking `running` and posting `pending`
+static pthread_t writer;
+static sem_t     pending;
+
+// Format "prefix: text\n" into `line`, returning its length
+uint32_t _log_line(char *line, uint8_t level, const char *text, uint32_t len) {
+    uint32_t prefix_len = strlen(prefix[level]);
+    memcpy(line, prefix[level], prefix_len);
+    line[prefix_len] = ':';
+    line[prefix_len + 1] = ' ';
+    memcpy(line + prefix_len + 2, text, len);
+    line[prefix_len + 2 + len] = '\n';
+    return prefix_len + 3 + len;
+}
+
+// vsnprintf into `dest`, returning the (possibly truncated) length written
+uint16_t _log_format(char *dest, const char *msg, va_list args) {
+    int32_t len = vsnprintf(dest, LOG_RECORD_MAX, msg, args);
+    if (len < 0) {
+        return 0;
+    }
+    return len >= LOG_RECORD_MAX ? LOG_RECORD_MAX - 1 : (uint16_t) len;
+}
+
+void _log_write_sync(log_level level, const char *msg, va_list args) {
+    // Per-thread scratch space: no allocation, and safe for concurrent callers
+    static __thread char text[LOG_RECORD_MAX];
+    static __thread char line[LOG_LINE_MAX];
+
+    uint16_t len = _log_format(text, msg, args);
+    fwrite(line, 1, _log_line(line, level, text, len), stdout);
+    fflush(stdout);
+}
+
+// Claim a queue slot, format into it in place and publish it.
+// Returns false if the queue is full.
+uint8_t _log_enqueue(log_level level, const char *msg, va_list args) {
+    uint32_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    log_record *record;
+    for (;;) {
+        record = &queue[pos & QUEUE_MASK];
+        uint32_t sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t) (sequence - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // Slot still holds a record from a lap ago: full
+        } else {
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    record->level = level;
+    record->len = _log_format(record->text, msg, args);
+    __atomic_store_n(&record->sequence, pos + 1, __ATOMIC_RELEASE);
+    sem_post(&pending);
+    return true;
+}
+
+// Write every published record with as few write calls as possible.
+void _log_drain(void) {
+    static char out[LOG_LINE_MAX * 32];
+    uint32_t out_len = 0;
+
+    for (;;) {
+        log_record *record = &queue[dequeue_pos & QUEUE_MASK];
+        if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != dequeue_pos + 1) {
+            break;
+        }
+        if (out_len + LOG_LINE_MAX > sizeof(out)) {
+            fwrite(out, 1, out_len, stdout);
+            out_len = 0;
+        }
+        out_len += _log_line(out + out_len, record->level, record->text, record->len);
+        // Hand the slot back to producers for the next lap
+        __atomic_store_n(&record->sequence, dequeue_pos + LOG_QUEUE_CAPACITY, __ATOMIC_RELEASE);
+        dequeue_pos++;
+    }
+    fwrite(out, 1, out_len, stdout);
+    fflush(stdout);
+}
+
+void *_log_writer_main(void *arg) {
+    (void) arg;
+    uint64_t reported_dropped = 0;
+
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        sem_wait(&pending);
+        _log_drain();
+
+        uint64_t now_dropped = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+        if (now_dropped != reported_dropped) {
+            printf("%s: logger dropped %llu records\n", prefix[LOG_LEVEL_WARN],
+                (unsigned long long) (now_dropped - reported_dropped));
+            reported_dropped = now_dropped;
+        }
+    }
+    _log_drain();
+    return NULL;
+}
 
 void _log_output(log_level level, const char* msg, ...) {
-    const char* prefix[5] = {"[FATAL]", "[ERROR]", "[WARN]", "[INFO]", "[DEBUG]"};
-    char *buffer;
-    int32_t len;
-
-    __builtin_va_list va_list_ptr;
-    va_start(va_list_ptr, msg);
-
-    // Call vsnprintf twice, first with a copy of the vararg list/pointer
-    // to find the total length once formatted (throwing result away).
-    va_list va_list_ptr_copy;
-    va_copy(va_list_ptr_copy, va_list_ptr);
-    len = vsnprintf(0, 0, msg, va_list_ptr_copy);
-    va_end(va_list_ptr_copy);
-
-    // Allocate known length from above vsnprintf and call it again, this
-    // time writing the result to the buffer.
-    buffer = malloc(len + 1);
-    vsnprintf(buffer, len + 1, msg, va_list_ptr);
-    buffer[len] = '\0';
-    va_end(va_list_ptr);
-
-    printf("%s: %s\n", prefix[level], buffer);
-    free(buffer);
+    va_list args;
+    va_start(args, msg);
+
+    // Counted before `running` is read so sc_logger_stop cannot destroy `pending` under us
+    __atomic_fetch_add(&inflight, 1, __ATOMIC_SEQ_CST);
+    if (level == LOG_LEVEL_FATAL || !__atomic_load_n(&running, __ATOMIC_SEQ_CST)) {
+        __atomic_fetch_sub(&inflight, 1, __ATOMIC_RELEASE);
+        _log_write_sync(level, msg, args);
+    } else {
+        if (!_log_enqueue(level, msg, args)) {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        }
+        __atomic_fetch_sub(&inflight, 1, __ATOMIC_RELEASE);
+    }
+    va_end(args);
+}
+
+void sc_logger_start(void) {
+    if (running) {
+        return;
+    }
+    for (uint32_t i = 0; i < LOG_QUEUE_CAPACITY; i++) {
+        queue[i].sequence = i;
+    }
+    enqueue_pos = 0;
+    dequeue_pos = 0;
+    sem_init(&pending, 0, 0);
+    __atomic_store_n(&running, true, __ATOMIC_RELEASE);
+    if (pthread_create(&writer, NULL, _log_writer_main, NULL) != 0) {
+        __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+        sem_destroy(&pending);
+        LOG_ERROR("sc_logger_start: failed to start writer thread, logging synchronously");
+    }
+}
+
+void sc_logger_stop(void) {
+    if (!running) {
+        return;
+    }
+    __atomic_store_n(&running, false, __ATOMIC_SEQ_CST);
+    sem_post(&pending);
+    pthread_join(writer, NULL);
+    // Producers that saw the logger running may still be publishing: wait them out and
+    // write what they queued after the writer's last drain
+    while (__atomic_load_n(&inflight, __ATOMIC_ACQUIRE) != 0) {
+        sched_yield();
+    }
+    _log_drain();
+    sem_destroy(&pending);
+}
+
+uint64_t sc_logger_dropped(void) {
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
 }
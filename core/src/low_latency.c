@@ -0,0 +1,93 @@
+#define _GNU_SOURCE  // pthread_setaffinity_np(...), CPU_SET(...), SO_BUSY_POLL
+
+#include "low_latency.h"
+
+#include "timing.h"
+#include "logger.h"
+
+#include <string.h>   // memcpy(...)
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>    // cpu_set_t, SCHED_FIFO
+
+// Enable kernel receive timestamps on `socket_fd`.
+// Returns true if successful, false otherwise.
+uint8_t _low_latency_timestamps(int32_t socket_fd) {
+    int32_t enable = 1;
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(int32_t)) < 0) {
+        LOG_WARN("Failed to enable SO_TIMESTAMPNS. Errno [%d] %s", errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+uint8_t sc_low_latency_socket(connection_t *conn, const low_latency_profile *profile) {
+    uint8_t applied = _low_latency_timestamps(conn->socket_audio_fd);
+    if (conn->socket_aux_fd > 0) {  // Channels have no aux socket
+        applied &= _low_latency_timestamps(conn->socket_aux_fd);
+    }
+
+    if (profile->buffer_depth > 0) {
+        // The kernel doubles the request to cover its own per-datagram bookkeeping
+        int32_t rcvbuf = (int32_t) (profile->buffer_depth * sizeof(datagram_t));
+        int32_t actual = 0;
+        socklen_t len = sizeof(int32_t);
+        // SO_RCVBUFFORCE lifts the net.core.rmem_max cap but needs CAP_NET_ADMIN
+        if (setsockopt(conn->socket_audio_fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(int32_t)) < 0
+            && setsockopt(conn->socket_audio_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(int32_t)) < 0) {
+            LOG_WARN("Failed to set SO_RCVBUF. Errno [%d] %s", errno, strerror(errno));
+            applied = false;
+        }
+        getsockopt(conn->socket_audio_fd, SOL_SOCKET, SO_RCVBUF, &actual, &len);
+        if (actual < rcvbuf) {
+            LOG_WARN("Receive buffer capped at %d bytes (asked %d), see net.core.rmem_max", actual, rcvbuf);
+            applied = false;
+        }
+    }
+
+    if (profile->busy_poll_us > 0) {
+        int32_t busy_poll = (int32_t) profile->busy_poll_us;
+        if (setsockopt(conn->socket_audio_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(int32_t)) < 0) {
+            LOG_WARN("Failed to set SO_BUSY_POLL. Errno [%d] %s", errno, strerror(errno));
+            applied = false;
+        }
+    }
+    return applied;
+}
+
+uint8_t sc_low_latency_thread(const low_latency_profile *profile) {
+    uint8_t applied = true;
+
+    if (profile->rt_priority > 0) {
+        struct sched_param param = { .sched_priority = profile->rt_priority };
+        int32_t ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (ret != 0) {
+            LOG_WARN("Failed to set SCHED_FIFO priority %d. Errno [%d] %s", profile->rt_priority, ret, strerror(ret));
+            applied = false;
+        }
+    }
+    if (profile->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(profile->cpu, &cpus);
+        int32_t ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+        if (ret != 0) {
+            LOG_WARN("Failed to pin receive thread to CPU %d. Errno [%d] %s", profile->cpu, ret, strerror(ret));
+            applied = false;
+        }
+    }
+    return applied;
+}
+
+uint64_t sc_low_latency_arrival_ns(const struct msghdr *msg) {
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR((struct msghdr *) msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec stamp;
+            memcpy(&stamp, CMSG_DATA(cmsg), sizeof(struct timespec));
+            // Kernel timestamps are wall clock: carry them onto the monotonic clock
+            uint64_t wall_ns = (uint64_t) stamp.tv_sec * NS_PER_SEC + (uint64_t) stamp.tv_nsec;
+            return wall_ns - (sc_time_wall_ns() - sc_time_now_ns());
+        }
+    }
+    return sc_time_now_ns();
+}
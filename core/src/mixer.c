@@ -0,0 +1,193 @@
+#include "mixer.h"
+
+#include "packetizer.h"
+#include "dsp.h"
+#include "timing.h"
+#include "logger.h"
+
+#include <string.h>  // memset(...)
+
+uint8_t sc_mixer_init(mixer_t *mixer, uint32_t sample_rate, uint8_t channels, uint64_t frame_interval_ns,
+    float duck_gain) {
+    uint64_t frames = sample_rate * frame_interval_ns / NS_PER_SEC;
+    if (channels == 0 || channels > CODEC_CHANNELS_MAX || frames == 0 || frames > MIXER_FRAMES_MAX) {
+        LOG_WARN("sc_mixer_init: unsupported layout (%u Hz, %d channels)", sample_rate, channels);
+        return false;
+    }
+
+    memset(mixer, 0, sizeof(mixer_t));
+    mixer->sample_rate = sample_rate;
+    mixer->channels = channels;
+    mixer->frames = (uint32_t) frames;
+    mixer->frame_interval_ns = frame_interval_ns;
+    mixer->duck_gain = duck_gain;
+    mixer->duck_priority = -1;
+    return true;
+}
+
+int32_t sc_mixer_add_stream(mixer_t *mixer, uint8_t codec, uint32_t sample_rate, uint8_t channels,
+    float gain, uint8_t priority) {
+    if (mixer->count == MIXER_STREAMS_MAX) {
+        LOG_WARN("sc_mixer_add_stream: mixer full (%d streams)", MIXER_STREAMS_MAX);
+        return -1;
+    }
+    if (sample_rate != mixer->sample_rate || channels != mixer->channels) {
+        LOG_WARN("sc_mixer_add_stream: stream layout (%u Hz, %d channels) differs from the mix (%u Hz, %d channels)",
+            sample_rate, channels, mixer->sample_rate, mixer->channels);
+        return -1;
+    }
+    mixer_stream *stream = &mixer->streams[mixer->count];
+    stream->codec = sc_codec_get(codec);
+    if (!stream->codec) {
+        LOG_WARN("sc_mixer_add_stream: unsupported codec (%d)", codec);
+        return -1;
+    }
+    sc_jitter_buffer_init(&stream->jb, MIXER_JITTER_MIN, MIXER_JITTER_MAX, mixer->frame_interval_ns);
+    sc_fec_decoder_init(&stream->fec);
+    sc_codec_state_init(&stream->codec_state);
+    stream->gain = gain;
+    stream->applied_gain = gain;
+    stream->priority = priority;
+    return (int32_t) mixer->count++;
+}
+
+uint8_t sc_mixer_set_codec(mixer_t *mixer, int32_t index, uint8_t codec) {
+    mixer_stream *stream = &mixer->streams[index];
+    const codec_t *next = sc_codec_get(codec);
+    if (!next) {
+        LOG_WARN("sc_mixer_set_codec: unsupported codec (%d)", codec);
+        return false;
+    }
+    if (next == stream->codec) {
+        return true;
+    }
+    sc_jitter_buffer_flush(&stream->jb);
+    sc_codec_state_init(&stream->codec_state);
+    stream->codec = next;
+    return true;
+}
+
+void sc_mixer_set_gain(mixer_t *mixer, int32_t index, float gain) {
+    mixer->streams[index].gain = gain;
+}
+
+void sc_mixer_push(mixer_t *mixer, int32_t index, const datagram_t *dgram, uint32_t len,
+    uint64_t arrival_ns) {
+    mixer_stream *stream = &mixer->streams[index];
+    if (dgram->header.kind == SERVER_FEC) {
+        sc_fec_decoder_add_parity(&stream->fec, dgram, len);
+        // Buffer a whole group, so a lost member is still ahead of playout once the
+        // group's parity arrives
+        sc_jitter_buffer_set_min_depth(&stream->jb,
+            stream->fec.group_size > MIXER_JITTER_MIN ? stream->fec.group_size : MIXER_JITTER_MIN);
+    } else if (dgram->header.kind == SERVER_AUDIO) {
+        sc_jitter_buffer_push(&stream->jb, dgram, len, arrival_ns);
+    } else {
+        return;
+    }
+    sc_fec_decoder_recover(&stream->fec, &stream->jb);
+}
+
+// Decode the popped frame of `stream` into the mixer's PCM buffer, zero filling any
+// shortfall.
+// Returns true if the frame was decoded, false otherwise.
+uint8_t _mixer_decode(mixer_t *mixer, mixer_stream *stream) {
+    const audio_fragment_header *fragment = (const audio_fragment_header *) stream->frame.payload.audio;
+    uint32_t samples = mixer->frames * mixer->channels;
+
+    if (stream->frame.header.payload_len < sizeof(audio_fragment_header) || fragment->fragment_count != 1) {
+        stream->stats.unsupported++;
+        return false;
+    }
+    uint32_t len = stream->frame.header.payload_len - sizeof(audio_fragment_header);
+    if (len > stream->codec->encoded_size(mixer->frames, mixer->channels)) {
+        stream->stats.unsupported++;
+        return false;
+    }
+    uint32_t frames = stream->codec->decode(&stream->codec_state,
+        stream->frame.payload.audio + sizeof(audio_fragment_header), len, mixer->channels, mixer->pcm);
+    if (frames < mixer->frames) {
+        memset(mixer->pcm + frames * mixer->channels, 0, (samples - frames * mixer->channels) * sizeof(int16_t));
+    }
+    return true;
+}
+
+// Add the mixer's decoded PCM to the mix at `gain`, ramping from the stream's last gain
+// so gain and ducking changes do not click.
+void _mixer_accumulate(mixer_t *mixer, mixer_stream *stream, float gain) {
+    uint32_t samples = mixer->frames * mixer->channels;
+    uint32_t block_frames = mixer->frames / MIXER_RAMP_STEPS;
+
+    sc_dsp_s16_to_f32(mixer->pcm, mixer->scratch, samples);
+    if (stream->applied_gain == gain || block_frames == 0) {
+        sc_dsp_mix_f32(mixer->mix, mixer->scratch, gain, samples);
+        stream->applied_gain = gain;
+        return;
+    }
+    float from = stream->applied_gain;
+    for (uint32_t step = 0; step < MIXER_RAMP_STEPS; step++) {
+        uint32_t offset = step * block_frames * mixer->channels;
+        uint32_t count = step + 1 == MIXER_RAMP_STEPS ? samples - offset : block_frames * mixer->channels;
+        float step_gain = from + (gain - from) * (float) (step + 1) / MIXER_RAMP_STEPS;
+        sc_dsp_mix_f32(mixer->mix + offset, mixer->scratch + offset, step_gain, count);
+    }
+    stream->applied_gain = gain;
+}
+
+uint32_t sc_mixer_mix(mixer_t *mixer, int16_t *out) {
+    return sc_mixer_mix_due(mixer, out, 0);
+}
+
+uint32_t sc_mixer_mix_due(mixer_t *mixer, int16_t *out, uint64_t due_ns) {
+    uint32_t samples = mixer->frames * mixer->channels;
+    int32_t top_priority = -1;
+    uint32_t mixed = 0;
+    uint32_t len;
+
+    // Pop every stream first: which streams are playing decides the ducking
+    for (uint32_t i = 0; i < mixer->count; i++) {
+        mixer_stream *stream = &mixer->streams[i];
+        jitter_pop_result result = due_ns
+            ? sc_jitter_buffer_pop_due(&stream->jb, &stream->frame, &len, due_ns)
+            : sc_jitter_buffer_pop(&stream->jb, &stream->frame, &len);
+        stream->has_frame = result == JITTER_POP_FRAME;
+        if (result == JITTER_POP_MISSING) {
+            stream->stats.concealed++;
+        }
+        // A stream concealing a lost frame is still playing
+        if (result != JITTER_POP_BUFFERING && stream->priority > top_priority) {
+            top_priority = stream->priority;
+        }
+    }
+    if (top_priority >= mixer->duck_priority) {
+        mixer->duck_priority = top_priority;
+        mixer->duck_hold = MIXER_DUCK_HOLD;
+    } else if (mixer->duck_hold > 0) {
+        mixer->duck_hold--;
+    } else {
+        mixer->duck_priority = top_priority;
+    }
+
+    memset(mixer->mix, 0, samples * sizeof(float));
+    uint8_t ducked = false;
+    for (uint32_t i = 0; i < mixer->count; i++) {
+        mixer_stream *stream = &mixer->streams[i];
+        float gain = stream->gain;
+        if (stream->priority < mixer->duck_priority) {
+            gain *= mixer->duck_gain;
+        }
+        if (!stream->has_frame || !_mixer_decode(mixer, stream)) {
+            stream->applied_gain = gain;  // Silent: nothing to ramp
+            continue;
+        }
+        _mixer_accumulate(mixer, stream, gain);
+        stream->stats.played++;
+        ducked |= stream->priority < mixer->duck_priority;
+        mixed++;
+    }
+    sc_dsp_f32_to_s16(mixer->mix, out, samples);
+
+    mixer->stats.mixes++;
+    mixer->stats.ducked += ducked;
+    return mixed;
+}
@@ -1,92 +1,164 @@
+#define _GNU_SOURCE  // sendmmsg(...), recvmmsg(...)
+
 #include "networking.h"
 
 #include "types.h"
+#include "datagram.h"
+#include "timing.h"
+#include "codec.h"
+#include "fanout.h"
+#include "pacing.h"
+#include "uring.h"
+#include "low_latency.h"
+#include "trace.h"
 #include "logger.h"
 #include "assert.h"
 
+#include <stddef.h>      // offsetof(...)
+#include <stdlib.h>      // malloc(...), free(...)
 #include <string.h>      // memset(...)
 #include <netinet/in.h>  // sockaddr_in, AF_INET
 #include <arpa/inet.h>   // htonl(...)
 #include <sys/socket.h>
-#include <time.h>        // struct timeval, gettimeofday(...)
+#include <sys/uio.h>     // struct iovec
+#include <unistd.h>      // close(...)
+#include <fcntl.h>       // fcntl(...)
 #include <errno.h>
 
 #define SOCKET_CLOSED_FD 0
 
-ssize_t _broadcast(connection_t *conn, uint8_t *buffer, uint32_t len) {
-    struct sockaddr_in addr;
+// Kinds sent to the multicast group on the audio socket
+uint8_t _is_group_kind(uint8_t kind) {
+    return kind == SERVER_AUDIO || kind == SERVER_FEC;
+}
+
+void _broadcast_addr(struct sockaddr_in *addr) {
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = INADDR_BROADCAST;
+    addr->sin_port = htons(BROADCAST_TEMP_PORT);
+}
 
-    memset(&addr, 0, sizeof(struct sockaddr_in));
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_BROADCAST;
-    addr.sin_port = htons(BROADCAST_TEMP_PORT);
+void _multicast_addr(connection_t *conn, struct sockaddr_in *addr) {
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr(conn->group_addr);
+    addr->sin_port = htons(MULTICAST_TEMP_PORT);
+}
 
-    ssize_t bytes_sent = sendto(
-        conn->socket_aux_fd,
-        buffer,
-        len,
-        0,
-        (struct sockaddr *) &addr,
-        sizeof(struct sockaddr_in)
-    );
+void _unicast_addr(connection_t *conn, struct sockaddr_in *addr) {
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr(conn->other_addr);
+    addr->sin_port = htons(UNICAST_TEMP_PORT);
+}
+
+// Point `iov` at the wire form of `dgram`: the header encoded into `wire` followed by
+// the payload in place, so the caller's datagram is never modified or copied.
+void _encode_iovecs(datagram_t *dgram, uint32_t len, datagram_header *wire, struct iovec iov[2]) {
+    uint32_t payload_len = len - sizeof(datagram_header);
+    sc_datagram_header_encode(&dgram->header, payload_len, wire);
+    iov[0].iov_base = wire;
+    iov[0].iov_len = sizeof(datagram_header);
+    iov[1].iov_base = &dgram->payload;
+    iov[1].iov_len = payload_len;
+}
+
+// io_uring backend of `socket_fd`, NULL if it uses plain socket calls
+uring_t *_sc_network_ring(connection_t *conn, int32_t socket_fd) {
+    if (socket_fd == conn->socket_audio_fd) {
+        return conn->uring_audio;
+    }
+    return socket_fd == conn->socket_aux_fd ? conn->uring_aux : NULL;
+}
+
+// Send `dgram` to `addr` from `socket_fd` of `conn`, released by `pacer` unless it is NULL.
+ssize_t _send_encoded(connection_t *conn, int32_t socket_fd, struct sockaddr_in *addr, datagram_t *dgram,
+    uint32_t len, pacer_t *pacer) {
+    datagram_header wire;
+    struct iovec iov[2];
+    struct msghdr msg;
+    uint8_t control[PACING_CONTROL_SIZE];
+    uring_t *ring = _sc_network_ring(conn, socket_fd);
+
+    if (ring && !pacer) {
+        // Paced datagrams carry their release time or sleep, so only unpaced ones are queued
+        if (!sc_uring_queue_send(ring, dgram, len, addr)) {
+            errno = ENOBUFS;
+            return -1;
+        }
+        sc_uring_submit(ring);
+        return len;
+    }
+    _encode_iovecs(dgram, len, &wire, iov);
+    memset(&msg, 0, sizeof(struct msghdr));
+    msg.msg_name = addr;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    if (pacer) {
+        sc_pacer_schedule(pacer, &msg, control);
+    }
+    return sendmsg(socket_fd, &msg, 0);
+}
+
+ssize_t _broadcast(connection_t *conn, datagram_t *dgram, uint32_t len) {
+    struct sockaddr_in addr;
+    _broadcast_addr(&addr);
+
+    ssize_t bytes_sent = _send_encoded(conn, conn->socket_aux_fd, &addr, dgram, len, NULL);
     
     if (bytes_sent == 0) {
         LOG_ERROR("broadcast: 0 bytes sent");
     }
     if (bytes_sent < 0) {
         LOG_ERROR("broadcast: send_to failed. errno [%d] %s", errno, strerror(errno));
+        sc_stats_record_error(&conn->stats, true, errno);
+    } else {
+        sc_stats_record_send(&conn->stats, 1, bytes_sent);
     }
     return bytes_sent;
 }
 
-ssize_t _multicast(connection_t *conn, uint8_t *buffer, uint32_t len) {
+ssize_t _multicast(connection_t *conn, datagram_t *dgram, uint32_t len) {
     struct sockaddr_in multicast_addr_group;
 
-    memset(&multicast_addr_group, 0, sizeof(struct sockaddr_in));
-    multicast_addr_group.sin_family = AF_INET;
-    multicast_addr_group.sin_addr.s_addr = inet_addr(conn->group_addr);
-    multicast_addr_group.sin_port = htons(MULTICAST_TEMP_PORT);
+    if (conn->fanout) {
+        // Unicast mode: delivery problems are per subscriber and counted by the fan-out
+        sc_fanout_send(conn->fanout, conn->socket_audio_fd, &dgram, &len, 1);
+        sc_stats_record_send(&conn->stats, 1, len);
+        return len;
+    }
+    _multicast_addr(conn, &multicast_addr_group);
 
-    ssize_t bytes_sent = sendto(
-        conn->socket_audio_fd,
-        buffer,
-        len,
-        0,
-        (struct sockaddr *) &multicast_addr_group,
-        sizeof(struct sockaddr_in)
-    );
+    ssize_t bytes_sent = _send_encoded(conn, conn->socket_audio_fd, &multicast_addr_group, dgram, len, conn->pacer);
 
     if (bytes_sent == 0) {
         LOG_ERROR("multicast: 0 bytes sent");
     }
     if (bytes_sent < 0) {
         LOG_ERROR("multicast: send_to failed. errno [%d] %s", errno, strerror(errno));
+        sc_stats_record_error(&conn->stats, true, errno);
+    } else {
+        sc_stats_record_send(&conn->stats, 1, bytes_sent);
     }
     return bytes_sent;
 }
 
-ssize_t _unicast(connection_t *conn, uint8_t *buffer, uint32_t len) {
+ssize_t _unicast(connection_t *conn, datagram_t *dgram, uint32_t len) {
     struct sockaddr_in addr;
+    _unicast_addr(conn, &addr);
 
-    memset(&addr, 0, sizeof(struct sockaddr_in));
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = inet_addr(conn->other_addr);
-    addr.sin_port = htons(UNICAST_TEMP_PORT);
-
-    ssize_t bytes_sent = sendto(
-        conn->socket_aux_fd,
-        buffer,
-        len,
-        0,
-        (struct sockaddr *) &addr,
-        sizeof(struct sockaddr_in)
-    );
+    ssize_t bytes_sent = _send_encoded(conn, conn->socket_aux_fd, &addr, dgram, len, NULL);
 
     if (bytes_sent == 0) {
         LOG_ERROR("unicast: 0 bytes sent");
     }
     if (bytes_sent < 0) {
         LOG_ERROR("unicast: send_to failed. Errno [%d] %s", errno, strerror(errno));
+        sc_stats_record_error(&conn->stats, true, errno);
+    } else {
+        sc_stats_record_send(&conn->stats, 1, bytes_sent);
     }
     return bytes_sent;
 }
@@ -97,7 +169,7 @@ uint8_t _sc_network_send_valid_params(datagram_t *dgram, uint32_t len) {
         LOG_WARN("Attempted to send datagram with too large `len` (%d)", len);
         return false;
     }
-    if (dgram->header.kind > 2) {  // 2 = max enum value (SERVER_AUDIO)
+    if (dgram->header.kind > DATAGRAM_KIND_MAX) {
         LOG_WARN("Attempted to send datagram with invalid header kind ('%d')", dgram->header.kind);
         return false;
     }
@@ -109,7 +181,7 @@ uint8_t _sc_network_send_valid_params(datagram_t *dgram, uint32_t len) {
         LOG_WARN("sc_network_send called with server ad. Use sc_network_server_advertise");
         return false;
     }
-    if (dgram->header.kind == SERVER_CLOSE && len > sizeof(datagram_header)) {
+    if (dgram->header.kind == SERVER_CLOSE && len > sizeof(datagram_header) + INET_ADDRSTRLEN) {
         LOG_WARN("Datagram size (%d) exceeds limit for SERVER_CLOSE", len);
         return false;
     }
@@ -120,7 +192,7 @@ uint8_t _sc_network_send_valid_params(datagram_t *dgram, uint32_t len) {
     return true;
 }
 
-void sc_socket_server_init(connection_t *conn) {
+uint8_t sc_socket_server_init(connection_t *conn) {
     int32_t opt_ret;
     int32_t boardcast_enable = 1;  // must be 32 bit else Errno 22 Invalid arg
 
@@ -144,17 +216,106 @@ void sc_socket_server_init(connection_t *conn) {
         LOG_ERROR("sc_socket_init: Failed to enable broadcasting. Errno [%d] %s", errno, strerror(errno));
     }
 
+    // Bind aux socket to receive unicast requests (e.g. NACKs) from clients
+    struct sockaddr_in unicast_addr;
+    memset(&unicast_addr, 0, sizeof(struct sockaddr_in));
+    unicast_addr.sin_family = AF_INET;
+    unicast_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    unicast_addr.sin_port = htons(UNICAST_TEMP_PORT);
+    if (bind(conn->socket_aux_fd, (struct sockaddr *) &unicast_addr, sizeof(struct sockaddr_in)) < 0) {
+        // e.g. another server already running on this host
+        LOG_ERROR("Failed to bind server aux socket to port %d. Errno [%d] %s", UNICAST_TEMP_PORT, errno,
+            strerror(errno));
+        close(conn->socket_aux_fd);
+        close(conn->socket_audio_fd);
+        conn->socket_audio_fd = SOCKET_CLOSED_FD;
+        conn->socket_aux_fd = SOCKET_CLOSED_FD;
+        return false;
+    }
+    LOG_INFO("Server aux socket bound");
+
     // Set sequence and flag(s)
     conn->send_sequence = 0;
     conn->recv_sequence = 0;
     conn->is_server = true;
+    conn->codec = CODEC_PCM_S16;
+    conn->sample_rate = AUDIO_DEFAULT_SAMPLE_RATE;
+    conn->channels = AUDIO_DEFAULT_CHANNELS;
     strncpy(conn->group_addr, MULTICAST_TEMP_GROUP, INET_ADDRSTRLEN);
     memset(&conn->other_addr, '\0', INET_ADDRSTRLEN);
+    conn->fanout = NULL;
+    conn->pacer = NULL;
+    conn->uring_audio = NULL;
+    conn->uring_aux = NULL;
+    conn->trace = NULL;
+    memset(&conn->stats, 0, sizeof(connection_stats));
+    return true;
+}
+
+void sc_socket_channel_init(connection_t *conn, const char *group, uint8_t codec, uint32_t sample_rate,
+    uint8_t channels) {
+    // Create socket for sending multicast audio. Channels share their server's aux socket.
+    conn->socket_audio_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    CORE_ASSERT(conn->socket_audio_fd >= 0);
+    conn->socket_aux_fd = SOCKET_CLOSED_FD;
+
+    // Set sequence and flag(s)
+    conn->send_sequence = 0;
+    conn->recv_sequence = 0;
+    conn->is_server = true;
+    conn->codec = codec;
+    conn->sample_rate = sample_rate;
+    conn->channels = channels;
+    strncpy(conn->group_addr, group, INET_ADDRSTRLEN);
+    conn->group_addr[INET_ADDRSTRLEN - 1] = '\0';
+    memset(&conn->other_addr, '\0', INET_ADDRSTRLEN);
+    conn->fanout = NULL;
+    conn->pacer = NULL;
+    conn->uring_audio = NULL;
+    conn->uring_aux = NULL;
+    conn->trace = NULL;
+    memset(&conn->stats, 0, sizeof(connection_stats));
+}
+
+// Open a socket receiving multicast audio on the group port, bound to `bind_addr` and
+// delivering only the groups it joins. Several can share the port, one per subscribed
+// stream: a client's first socket is bound to any address, so unicast sent to the group
+// port (join bursts, fan-out) reaches it alone, and further streams are bound to their
+// group's address, taking only its multicast.
+// Returns the socket if successful, -1 otherwise.
+int32_t _client_audio_socket(in_addr_t bind_addr) {
+    int32_t socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    CORE_ASSERT(socket_fd >= 0);
+
+    int32_t reuse = 1;
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(int32_t)) < 0) {
+        LOG_WARN("Failed to set SO_REUSEADDR on group socket. Errno [%d] %s", errno, strerror(errno));
+    }
+
+    // Bind audio/group socket to multicast port
+    struct sockaddr_in group_addr;
+    memset(&group_addr, 0, sizeof(struct sockaddr_in));
+    group_addr.sin_family = AF_INET;
+    group_addr.sin_addr.s_addr = bind_addr;
+    group_addr.sin_port = htons(MULTICAST_TEMP_PORT);
+    if (bind(socket_fd, (struct sockaddr *) &group_addr, sizeof(struct sockaddr_in)) < 0) {
+        LOG_ERROR("Failed to bind client group socket. Errno [%d] %s", errno, strerror(errno));
+        close(socket_fd);
+        return -1;
+    }
+    LOG_INFO("Client group socket bound");
+
+    // Servers run many groups on the same port: only deliver groups this socket joined
+    int32_t multicast_all = 0;
+    if (setsockopt(socket_fd, IPPROTO_IP, IP_MULTICAST_ALL, &multicast_all, sizeof(int32_t)) < 0) {
+        LOG_WARN("Failed to disable IP_MULTICAST_ALL. Errno [%d] %s", errno, strerror(errno));
+    }
+    return socket_fd;
 }
 
 void sc_socket_client_init(connection_t *conn) {
     // Create socket for receiving multicast audio
-    conn->socket_audio_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    conn->socket_audio_fd = _client_audio_socket(htonl(INADDR_ANY));
     CORE_ASSERT(conn->socket_audio_fd >= 0);
 
     // Create socket for sending and receiving auxiliary messages
@@ -170,21 +331,78 @@ void sc_socket_client_init(connection_t *conn) {
     CORE_ASSERT(bind(conn->socket_aux_fd, (struct sockaddr *) &all_addr, sizeof(struct sockaddr_in)) >= 0);
     LOG_INFO("Client aux socket bound");
 
-    // Bind audio/group socket to multicast port
-    struct sockaddr_in group_addr;
-    memset(&group_addr, 0, sizeof(struct sockaddr_in));
-    group_addr.sin_family = AF_INET;
-    group_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    group_addr.sin_port = htons(MULTICAST_TEMP_PORT);
-    CORE_ASSERT(bind(conn->socket_audio_fd, (struct sockaddr *) &group_addr, sizeof(struct sockaddr_in)) >= 0);
-    LOG_INFO("Client group socket bound");
-
     // Set sequence and flag(s)
     conn->send_sequence = 0;
     conn->recv_sequence = 0;
     conn->is_server = false;
+    conn->codec = CODEC_PCM_S16;
+    conn->sample_rate = AUDIO_DEFAULT_SAMPLE_RATE;
+    conn->channels = AUDIO_DEFAULT_CHANNELS;
     memset(&conn->group_addr, '\0', INET_ADDRSTRLEN);
     memset(&conn->other_addr, '\0', INET_ADDRSTRLEN);
+    conn->fanout = NULL;
+    conn->pacer = NULL;
+    conn->uring_audio = NULL;
+    conn->uring_aux = NULL;
+    conn->trace = NULL;
+    memset(&conn->stats, 0, sizeof(connection_stats));
+}
+
+uint8_t sc_socket_client_stream_init(connection_t *conn, const connection_t *client, const advertisement *ad,
+    uint8_t index) {
+    char group[INET_ADDRSTRLEN];
+    struct sockaddr_in unicast_addr;
+
+    if (index >= ad->channel_count) {
+        LOG_WARN("Advertisement has no channel %d (%d listed)", index, ad->channel_count);
+        return false;
+    }
+    memcpy(group, ad->channels[index].group_addr, INET_ADDRSTRLEN);
+    group[INET_ADDRSTRLEN - 1] = '\0';
+    conn->socket_audio_fd = _client_audio_socket(inet_addr(group));
+    if (conn->socket_audio_fd < 0) {
+        return false;
+    }
+
+    // Unicast socket on a port of its own, for audio sent to this stream alone (e.g. its
+    // join burst) and its requests to the server
+    conn->socket_aux_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&unicast_addr, 0, sizeof(struct sockaddr_in));
+    unicast_addr.sin_family = AF_INET;
+    unicast_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (conn->socket_aux_fd < 0
+        || bind(conn->socket_aux_fd, (struct sockaddr *) &unicast_addr, sizeof(struct sockaddr_in)) < 0) {
+        LOG_ERROR("Failed to open stream unicast socket. Errno [%d] %s", errno, strerror(errno));
+        if (conn->socket_aux_fd >= 0) {
+            close(conn->socket_aux_fd);
+        }
+        close(conn->socket_audio_fd);
+        conn->socket_audio_fd = SOCKET_CLOSED_FD;
+        conn->socket_aux_fd = SOCKET_CLOSED_FD;
+        return false;
+    }
+
+    // Set sequence and flag(s)
+    conn->send_sequence = 0;
+    conn->recv_sequence = 0;
+    conn->is_server = false;
+    conn->codec = CODEC_PCM_S16;
+    conn->sample_rate = AUDIO_DEFAULT_SAMPLE_RATE;
+    conn->channels = AUDIO_DEFAULT_CHANNELS;
+    memset(&conn->group_addr, '\0', INET_ADDRSTRLEN);
+    memcpy(conn->other_addr, client->other_addr, INET_ADDRSTRLEN);
+    conn->fanout = NULL;
+    conn->pacer = NULL;
+    conn->uring_audio = NULL;
+    conn->uring_aux = NULL;
+    conn->trace = NULL;
+    memset(&conn->stats, 0, sizeof(connection_stats));
+
+    if (!sc_socket_client_join_channel(conn, ad, index)) {
+        sc_socket_close(conn);
+        return false;
+    }
+    return true;
 }
 
 uint8_t sc_socket_client_join(connection_t *conn, char multicast_group[INET_ADDRSTRLEN]) {
@@ -209,6 +427,23 @@ uint8_t sc_socket_client_join(connection_t *conn, char multicast_group[INET_ADDR
     return opt_ret == 0;
 }
 
+uint8_t sc_socket_client_join_channel(connection_t *conn, const advertisement *ad, uint8_t index) {
+    if (index >= ad->channel_count) {
+        LOG_WARN("Advertisement has no channel %d (%d listed)", index, ad->channel_count);
+        return false;
+    }
+    char group[INET_ADDRSTRLEN];
+    memcpy(group, ad->channels[index].group_addr, INET_ADDRSTRLEN);
+    group[INET_ADDRSTRLEN - 1] = '\0';
+    if (!sc_socket_client_join(conn, group)) {
+        return false;
+    }
+    conn->codec = ad->channels[index].codec;
+    conn->sample_rate = ad->channels[index].sample_rate;
+    conn->channels = ad->channels[index].channels;
+    return true;
+}
+
 uint8_t sc_socket_client_leave(connection_t *conn) {
     struct ip_mreq mreq;
     int32_t opt_ret;
@@ -231,16 +466,79 @@ uint8_t sc_socket_client_leave(connection_t *conn) {
     return opt_ret == 0;
 }
 
+void _sc_network_ring_close(uring_t **ring) {
+    if (*ring) {
+        sc_uring_close(*ring);
+        free(*ring);
+        *ring = NULL;
+    }
+}
+
+// Give `socket_fd` its own ring in `*ring`.
+// Returns true if successful, false otherwise.
+uint8_t _sc_network_ring_open(connection_t *conn, int32_t socket_fd, uint8_t sqpoll, uring_t **ring) {
+    *ring = malloc(sizeof(uring_t));
+    if (!*ring) {
+        LOG_ERROR("sc_socket_uring_init: allocation failed");
+        return false;
+    }
+    if (!sc_uring_init(*ring, socket_fd, sqpoll, &conn->stats)) {
+        free(*ring);
+        *ring = NULL;
+        return false;
+    }
+    return true;
+}
+
+uint8_t sc_socket_uring_init(connection_t *conn, uint8_t sqpoll) {
+    if (conn->socket_audio_fd != SOCKET_CLOSED_FD
+        && !_sc_network_ring_open(conn, conn->socket_audio_fd, sqpoll, &conn->uring_audio)) {
+        LOG_WARN("io_uring backend unavailable, using sockets");
+        return false;
+    }
+    if (conn->socket_aux_fd != SOCKET_CLOSED_FD
+        && !_sc_network_ring_open(conn, conn->socket_aux_fd, sqpoll, &conn->uring_aux)) {
+        LOG_WARN("io_uring backend unavailable, using sockets");
+        _sc_network_ring_close(&conn->uring_audio);
+        return false;
+    }
+    LOG_INFO("Using io_uring backend");
+    return true;
+}
+
+int32_t sc_network_event_fd(connection_t *conn, uint8_t aux) {
+    uring_t *ring = aux ? conn->uring_aux : conn->uring_audio;
+    if (ring) {
+        return ring->ring_fd;
+    }
+    return aux ? conn->socket_aux_fd : conn->socket_audio_fd;
+}
+
+uint16_t sc_network_unicast_port(connection_t *conn) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(struct sockaddr_in);
+
+    // A socket bound to any address takes unicast on the group port itself
+    if (getsockname(conn->socket_audio_fd, (struct sockaddr *) &addr, &addr_len) == 0
+        && addr.sin_addr.s_addr == htonl(INADDR_ANY)) {
+        return MULTICAST_TEMP_PORT;
+    }
+    addr_len = sizeof(struct sockaddr_in);
+    if (getsockname(conn->socket_aux_fd, (struct sockaddr *) &addr, &addr_len) < 0) {
+        LOG_WARN("sc_network_unicast_port: getsockname failed. Errno [%d] %s", errno, strerror(errno));
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
 void sc_socket_close(connection_t *conn) {
     datagram_t close_notif;
-    struct timeval time;
     uint64_t dgram_size;
 
-    if (conn->is_server && conn->group_addr[0] != '\0') {
-        gettimeofday(&time, NULL);
+    if (conn->is_server && conn->group_addr[0] != '\0' && conn->socket_aux_fd != SOCKET_CLOSED_FD) {
         close_notif.header.kind = SERVER_CLOSE;
         close_notif.header.sequence = conn->send_sequence;
-        close_notif.header.timestamp = time;
+        close_notif.header.timestamp = sc_time_now_ns();
         memcpy(&close_notif.payload.group_addr, conn->group_addr, INET_ADDRSTRLEN);
         LOG_INFO("Broadcasting group close notification");
         // Try broadcasting closure up to 5 times
@@ -249,33 +547,64 @@ void sc_socket_close(connection_t *conn) {
             // empty
         }
     }
-    if (conn->socket_audio_fd > 0 && shutdown(conn->socket_audio_fd, 2) < 0) {
-        LOG_ERROR("sc_socket_close: multi socket shutdown error. errno [%d] %s", errno, strerror(errno));
+    // Rings first: queued sends (e.g. the close above) must go out before shutdown
+    _sc_network_ring_close(&conn->uring_audio);
+    _sc_network_ring_close(&conn->uring_aux);
+
+    // Shutdown wakes any thread blocked receiving. Unconnected UDP sockets report
+    // ENOTCONN but are still shut down.
+    if (conn->socket_audio_fd > 0) {
+        if (shutdown(conn->socket_audio_fd, 2) < 0 && errno != ENOTCONN) {
+            LOG_ERROR("sc_socket_close: multi socket shutdown error. errno [%d] %s", errno, strerror(errno));
+        }
+        close(conn->socket_audio_fd);
     }
-    if (conn->socket_aux_fd > 0 && shutdown(conn->socket_aux_fd, 2) < 0) {
-        LOG_ERROR("sc_socket_close: aux socket shutdown error. errno [%d] %s", errno, strerror(errno));
+    if (conn->socket_aux_fd > 0) {
+        if (shutdown(conn->socket_aux_fd, 2) < 0 && errno != ENOTCONN) {
+            LOG_ERROR("sc_socket_close: aux socket shutdown error. errno [%d] %s", errno, strerror(errno));
+        }
+        close(conn->socket_aux_fd);
     }
     conn->socket_audio_fd = SOCKET_CLOSED_FD;
     conn->socket_aux_fd = SOCKET_CLOSED_FD;
     memset(&conn->group_addr, '\0', INET_ADDRSTRLEN);
     memset(&conn->other_addr, '\0', INET_ADDRSTRLEN);
+    conn->fanout = NULL;
+    conn->pacer = NULL;
+    conn->uring_audio = NULL;
+    conn->uring_aux = NULL;
+    conn->trace = NULL;
 }
 
 uint8_t sc_network_server_advertise(connection_t *conn) {
-    struct timeval time;
-    gettimeofday(&time, NULL);
+    advertised_channel channel;
+    memcpy(channel.group_addr, conn->group_addr, INET_ADDRSTRLEN);
+    channel.codec = conn->codec;
+    channel.sample_rate = conn->sample_rate;
+    channel.channels = conn->channels;
+    return sc_network_advertise_channels(conn, &channel, 1);
+}
 
+uint8_t sc_network_advertise_channels(connection_t *conn, const advertised_channel *channels, uint8_t count) {
+    if (count == 0 || count > ADVERTISEMENT_CHANNELS_MAX) {
+        LOG_WARN("Cannot advertise %d channels (limit %d)", count, ADVERTISEMENT_CHANNELS_MAX);
+        return false;
+    }
     datagram_t datagram = {
         .header = {
             .kind = SERVER_AD,
             .sequence = conn->send_sequence++,
-            .timestamp = time
+            .timestamp = sc_time_now_ns()
         },
-        .payload = { 0 }  // written with below memcpy
+        .payload = { { 0 } }  // written with below memcpy
     };
-    memcpy(datagram.payload.group_addr, conn->group_addr, INET_ADDRSTRLEN);
+    datagram.payload.ad.channel_count = count;
+    memcpy(datagram.payload.ad.channels, channels, count * sizeof(advertised_channel));
+    for (uint8_t i = 0; i < count; i++) {
+        datagram.payload.ad.channels[i].sample_rate = htonl(channels[i].sample_rate);
+    }
 
-    return _broadcast(conn, (uint8_t *) &datagram, sizeof(datagram_header) + INET_ADDRSTRLEN) > 0;
+    return _broadcast(conn, &datagram, sizeof(datagram_header) + ADVERTISEMENT_SIZE(count)) > 0;
 }
 
 uint8_t sc_network_send(connection_t *conn, datagram_t *dgram, uint32_t len) {
@@ -284,15 +613,14 @@ uint8_t sc_network_send(connection_t *conn, datagram_t *dgram, uint32_t len) {
     }
     
     ssize_t bytes_sent = 0;
-    uint8_t *bytes = (uint8_t *) dgram;
     if (conn->is_server) {
-        if (dgram->header.kind == SERVER_AUDIO) {
-            bytes_sent = _multicast(conn, bytes, len);
+        if (_is_group_kind(dgram->header.kind)) {
+            bytes_sent = _multicast(conn, dgram, len);
         } else {
-            bytes_sent = _broadcast(conn, bytes, len);
+            bytes_sent = _broadcast(conn, dgram, len);
         }
     } else {
-        bytes_sent = _unicast(conn, bytes, len);
+        bytes_sent = _unicast(conn, dgram, len);
     }
     if (bytes_sent <= 0) {
         return false;
@@ -301,53 +629,383 @@ uint8_t sc_network_send(connection_t *conn, datagram_t *dgram, uint32_t len) {
     return true;
 }
 
-uint8_t sc_network_receive(connection_t *conn, datagram_t *dest, uint8_t aux) {
-    datagram_t *recv_dgram;
-    uint8_t buffer[sizeof(datagram_t)];
-    struct sockaddr_in src_addr;
-    uint32_t addr_len = sizeof(struct sockaddr_in);
-    char src_ip_buffer[INET_ADDRSTRLEN];
-    int32_t socket_fd = aux ? conn->socket_aux_fd : conn->socket_audio_fd;
-
-    ssize_t bytes_received = recvfrom(
-        socket_fd,
-        buffer,
-        sizeof(datagram_t),
-        0,
-        (struct sockaddr *) &src_addr,
-        &addr_len
-    );
-    if (bytes_received < 0) {
-        LOG_ERROR("sc_network_receive: errno [%d] %s", errno, strerror(errno));
+uint8_t sc_network_send_to(connection_t *conn, datagram_t *dgram, uint32_t len, struct sockaddr_in *addr) {
+    if (len < sizeof(datagram_header) || len > sizeof(datagram_t)) {
+        LOG_WARN("sc_network_send_to: invalid datagram size (%d)", len);
         return false;
     }
-    if (bytes_received == 0) {
-        LOG_ERROR("sc_network_receive: socket has been shutdown");
+    ssize_t bytes_sent = _send_encoded(conn, conn->socket_aux_fd, addr, dgram, len, NULL);
+    if (bytes_sent <= 0) {
+        LOG_ERROR("sc_network_send_to: send failed. Errno [%d] %s", errno, strerror(errno));
+        sc_stats_record_error(&conn->stats, true, errno);
         return false;
     }
-    
-    recv_dgram = (datagram_t *) buffer;
-    if (recv_dgram->header.kind > SERVER_AUDIO) {
+    sc_stats_record_send(&conn->stats, 1, bytes_sent);
+    conn->send_sequence++;
+    return true;
+}
+
+// Validate a received datagram of `len` bytes, arrived at `arrival_ns` on the aux socket
+// if `aux`, and apply its side effects to `conn`, recording it first if tracing.
+// If a SERVER_AD is received, the source IP address `src_addr` is stored in `conn`.
+// Returns true if the datagram is valid, false otherwise.
+uint8_t _sc_network_receive_accept(connection_t *conn, datagram_t *dgram, uint32_t len,
+    struct sockaddr_in *src_addr, uint64_t arrival_ns, uint8_t aux) {
+    char src_ip_buffer[INET_ADDRSTRLEN];
+
+    if (conn->trace) {
+        sc_trace_record(conn->trace, dgram, len, arrival_ns, aux);
+    }
+
+    // Received in wire format: convert the header to host order in place
+    if (!sc_datagram_decode(dgram, len)) {
         LOG_WARN("Invalid header on received datagram");
+        __atomic_fetch_add(&conn->stats.invalid, 1, __ATOMIC_RELAXED);
         return false;
     }
-    // Copy to `dest` datagram
-    dest->header.kind      = recv_dgram->header.kind;
-    dest->header.sequence  = recv_dgram->header.sequence;
-    dest->header.timestamp = recv_dgram->header.timestamp;
-    if (recv_dgram->header.kind == SERVER_AD) {
-        // Advertised multicast group address
-        memcpy(dest->payload.group_addr, recv_dgram->payload.group_addr, INET_ADDRSTRLEN);
-        
+    if (dgram->header.kind == SERVER_AD) {
+        advertisement *ad = &dgram->payload.ad;
+        if (dgram->header.payload_len < ADVERTISEMENT_SIZE(1)
+            || ad->channel_count > ADVERTISEMENT_CHANNELS_MAX
+            || dgram->header.payload_len != ADVERTISEMENT_SIZE(ad->channel_count)) {
+            LOG_WARN("Malformed server advertisement (%d bytes)", dgram->header.payload_len);
+            __atomic_fetch_add(&conn->stats.invalid, 1, __ATOMIC_RELAXED);
+            return false;
+        }
         // Store the source IP address for the received datagram
-        inet_ntop(AF_INET, &src_addr.sin_addr, src_ip_buffer, INET_ADDRSTRLEN);
+        inet_ntop(AF_INET, &src_addr->sin_addr, src_ip_buffer, INET_ADDRSTRLEN);
         memcpy(conn->other_addr, src_ip_buffer, INET_ADDRSTRLEN);
-    }
-    else if (recv_dgram->header.kind == SERVER_AUDIO) {
-        // Sent audio payload
-        memcpy(dest->payload.audio, recv_dgram->payload.audio, DATAGRAM_PAYLOAD_MAX_SIZE);
-    }
 
+        for (uint8_t i = 0; i < ad->channel_count; i++) {
+            ad->channels[i].sample_rate = ntohl(ad->channels[i].sample_rate);
+        }
+
+        // Until a channel is joined, assume the first. Once joined, the client decides
+        // whether to follow changes advertised for its group.
+        if (conn->group_addr[0] == '\0') {
+            conn->codec = ad->channels[0].codec;
+            conn->sample_rate = ad->channels[0].sample_rate;
+            conn->channels = ad->channels[0].channels;
+            if (!sc_codec_get(conn->codec)) {
+                LOG_WARN("Server advertised unsupported codec (%d)", conn->codec);
+            }
+        }
+    }
     conn->recv_sequence++;
+    sc_stats_record_receive(&conn->stats, dgram->header.kind, dgram->header.sequence,
+        dgram->header.timestamp, len, arrival_ns);
     return true;
 }
+
+// Take the next datagram `ring` has received, waiting for one unless the socket or the
+// ring fd (when watched by an event loop) is non-blocking. Waits are bounded by the
+// socket's SO_RCVTIMEO, as a blocking recvmsg would be.
+// Returns the datagram size, 0 if it was malformed, or -1 if none was ready.
+int32_t _sc_network_uring_receive(uring_t *ring, datagram_t *dest, struct sockaddr_in *src_addr,
+    uint64_t *arrival_ns) {
+    int32_t len = sc_uring_receive(ring, dest, src_addr, arrival_ns, 0);
+    if (len < 0 && !((fcntl(ring->ring_fd, F_GETFL) | fcntl(ring->socket_fd, F_GETFL)) & O_NONBLOCK)) {
+        struct timeval timeout = { 0, 0 };
+        socklen_t timeout_len = sizeof(struct timeval);
+        uint64_t timeout_ns = URING_WAIT_FOREVER;
+        if (getsockopt(ring->socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, &timeout_len) == 0
+            && (timeout.tv_sec != 0 || timeout.tv_usec != 0)) {
+            timeout_ns = (uint64_t) timeout.tv_sec * NS_PER_SEC + (uint64_t) timeout.tv_usec * 1000;
+        }
+        len = sc_uring_receive(ring, dest, src_addr, arrival_ns, timeout_ns);
+    }
+    return len;
+}
+
+// Receive one datagram straight into `dest` with no intermediate buffer, storing when it
+// arrived in `arrival_ns`.
+// Returns the number of bytes received if valid, 0 if malformed, -1 if none was received.
+int32_t _sc_network_receive_one(connection_t *conn, datagram_t *dest, uint8_t aux,
+    struct sockaddr_in *src_addr, uint64_t *arrival_ns) {
+    int32_t socket_fd = aux ? conn->socket_aux_fd : conn->socket_audio_fd;
+    uring_t *ring = aux ? conn->uring_aux : conn->uring_audio;
+    uint8_t control[ARRIVAL_CONTROL_SIZE];
+    struct iovec iov = { .iov_base = dest, .iov_len = sizeof(datagram_t) };
+    struct msghdr msg;
+
+    if (ring) {
+        int32_t len = _sc_network_uring_receive(ring, dest, src_addr, arrival_ns);
+        if (len <= 0) {
+            return len;
+        }
+        return _sc_network_receive_accept(conn, dest, len, src_addr, *arrival_ns, aux) ? len : 0;
+    }
+
+    memset(&msg, 0, sizeof(struct msghdr));
+    msg.msg_name = src_addr;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t bytes_received = recvmsg(socket_fd, &msg, 0);
+    if (bytes_received < 0) {
+        // Non-blocking sockets with nothing queued are not errors
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_ERROR("sc_network_receive: errno [%d] %s", errno, strerror(errno));
+            sc_stats_record_error(&conn->stats, false, errno);
+        }
+        return -1;
+    }
+    if (bytes_received == 0) {
+        LOG_ERROR("sc_network_receive: socket has been shutdown");
+        return -1;
+    }
+    *arrival_ns = sc_low_latency_arrival_ns(&msg);
+    if (!_sc_network_receive_accept(conn, dest, bytes_received, src_addr, *arrival_ns, aux)) {
+        return 0;
+    }
+    return (int32_t) bytes_received;
+}
+
+// Receive the next valid datagram as _sc_network_receive_one, skipping malformed ones so
+// callers draining until nothing is received do not stop at one (and, with io_uring,
+// leave the datagrams behind it waiting in the ring with no event to wake them).
+// Returns the number of bytes received if successful, 0 if none was received.
+uint32_t _sc_network_receive_into(connection_t *conn, datagram_t *dest, uint8_t aux,
+    struct sockaddr_in *src_addr, uint64_t *arrival_ns) {
+    int32_t len;
+    do {
+        len = _sc_network_receive_one(conn, dest, aux, src_addr, arrival_ns);
+    } while (len == 0);
+    return len > 0 ? (uint32_t) len : 0;
+}
+
+uint8_t sc_network_receive(connection_t *conn, datagram_t *dest, uint8_t aux) {
+    struct sockaddr_in src_addr;
+    uint64_t arrival_ns;
+    return _sc_network_receive_into(conn, dest, aux, &src_addr, &arrival_ns) > 0;
+}
+
+uint8_t sc_network_receive_from(connection_t *conn, datagram_t *dest, uint8_t aux, struct sockaddr_in *src) {
+    uint64_t arrival_ns;
+    return _sc_network_receive_into(conn, dest, aux, src, &arrival_ns) > 0;
+}
+
+uint8_t sc_network_receive_timed(connection_t *conn, datagram_t *dest, uint8_t aux, struct sockaddr_in *src,
+    uint64_t *arrival_ns) {
+    return _sc_network_receive_into(conn, dest, aux, src, arrival_ns) > 0;
+}
+
+pooled_datagram *sc_network_receive_pooled(connection_t *conn, buffer_pool_t *pool, uint8_t aux) {
+    pooled_datagram *slot = sc_buffer_pool_acquire(pool);
+    if (!slot) {
+        LOG_WARN("sc_network_receive_pooled: buffer pool exhausted");
+        return NULL;
+    }
+    struct sockaddr_in src_addr;
+    uint64_t arrival_ns;
+    slot->len = _sc_network_receive_into(conn, &slot->dgram, aux, &src_addr, &arrival_ns);
+    if (slot->len == 0) {
+        // Kept on this thread for the next receive, releasing is the consumer's side
+        sc_buffer_pool_unacquire(pool, slot);
+        return NULL;
+    }
+    return slot;
+}
+
+// Route used for a datagram sent from `conn`: true if sent on the audio
+// socket (server multicast audio/FEC), false if sent on the aux socket.
+uint8_t _sc_network_send_route(connection_t *conn, datagram_t *dgram) {
+    return conn->is_server && _is_group_kind(dgram->header.kind);
+}
+
+// Send `count` datagrams sharing one route with as few sendmmsg calls as possible.
+// A datagram the kernel rejects is marked failed and the remainder of the run retried.
+uint32_t _sc_network_send_run(connection_t *conn, datagram_t **dgrams, uint32_t *lens,
+    uint8_t *results, uint32_t count) {
+    struct sockaddr_in addr;
+    datagram_header wire_headers[NETWORK_BATCH_MAX];
+    struct iovec iovecs[NETWORK_BATCH_MAX][2];
+    struct mmsghdr msgs[NETWORK_BATCH_MAX];
+    uint8_t controls[NETWORK_BATCH_MAX][PACING_CONTROL_SIZE];
+    uint32_t sent_total = 0;
+    uint64_t bytes_total = 0;
+    int32_t socket_fd;
+    pacer_t *pacer = NULL;
+
+    if (conn->fanout && _sc_network_send_route(conn, dgrams[0])) {
+        sc_fanout_send(conn->fanout, conn->socket_audio_fd, dgrams, lens, count);
+        memset(results, true, count);
+        for (uint32_t i = 0; i < count; i++) {
+            bytes_total += lens[i];
+        }
+        sc_stats_record_send(&conn->stats, count, bytes_total);
+        return count;
+    }
+    if (_sc_network_send_route(conn, dgrams[0])) {
+        _multicast_addr(conn, &addr);
+        socket_fd = conn->socket_audio_fd;
+        pacer = conn->pacer;
+    } else if (conn->is_server) {
+        _broadcast_addr(&addr);
+        socket_fd = conn->socket_aux_fd;
+    } else {
+        _unicast_addr(conn, &addr);
+        socket_fd = conn->socket_aux_fd;
+    }
+
+    uring_t *ring = _sc_network_ring(conn, socket_fd);
+    if (ring && !pacer) {
+        // Queue the whole run and submit it with one syscall
+        for (uint32_t i = 0; i < count; i++) {
+            results[i] = sc_uring_queue_send(ring, dgrams[i], lens[i], &addr);
+            sent_total += results[i];
+            bytes_total += results[i] ? lens[i] : 0;
+        }
+        sc_uring_submit(ring);
+        sc_stats_record_send(&conn->stats, sent_total, bytes_total);
+        return sent_total;
+    }
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * count);
+    for (uint32_t i = 0; i < count; i++) {
+        _encode_iovecs(dgrams[i], lens[i], &wire_headers[i], iovecs[i]);
+        msgs[i].msg_hdr.msg_name = &addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+        if (pacer && pacer->mode == PACING_TXTIME) {
+            sc_pacer_schedule(pacer, &msgs[i].msg_hdr, controls[i]);
+        }
+    }
+
+    uint32_t offset = 0;
+    while (offset < count) {
+        // Paced by sleeping: each datagram is its own send, made when it is due
+        uint32_t burst = count - offset;
+        if (pacer && pacer->mode == PACING_SLEEP) {
+            sc_pacer_schedule(pacer, &msgs[offset].msg_hdr, controls[offset]);
+            burst = 1;
+        }
+        int32_t sent = sendmmsg(socket_fd, &msgs[offset], burst, 0);
+        if (sent <= 0) {
+            // Nothing went out: the datagram at `offset` is the one that failed
+            LOG_ERROR("sc_network_send_batch: sendmmsg failed. errno [%d] %s", errno, strerror(errno));
+            sc_stats_record_error(&conn->stats, true, errno);
+            results[offset++] = false;
+            continue;
+        }
+        for (int32_t i = 0; i < sent; i++) {
+            results[offset + i] = msgs[offset + i].msg_len > 0;
+            sent_total += results[offset + i];
+            bytes_total += msgs[offset + i].msg_len;
+        }
+        offset += sent;
+    }
+    sc_stats_record_send(&conn->stats, sent_total, bytes_total);
+    return sent_total;
+}
+
+uint32_t sc_network_send_batch(connection_t *conn, datagram_t **dgrams, uint32_t *lens,
+    uint8_t *results, uint32_t count) {
+    uint32_t sent_total = 0;
+    uint32_t run_start = 0;
+
+    CORE_ASSERT(count <= NETWORK_BATCH_MAX);
+    while (run_start < count) {
+        if (!_sc_network_send_valid_params(dgrams[run_start], lens[run_start])) {
+            results[run_start++] = false;
+            continue;
+        }
+        // Extend the run while datagrams are valid and share the same route
+        uint8_t route = _sc_network_send_route(conn, dgrams[run_start]);
+        uint32_t run_end = run_start + 1;
+        while (run_end < count
+            && _sc_network_send_route(conn, dgrams[run_end]) == route
+            && _sc_network_send_valid_params(dgrams[run_end], lens[run_end])) {
+            run_end++;
+        }
+        sent_total += _sc_network_send_run(conn, &dgrams[run_start], &lens[run_start],
+            &results[run_start], run_end - run_start);
+        run_start = run_end;
+    }
+    conn->send_sequence += sent_total;
+    return sent_total;
+}
+
+// Validate `count` received datagrams, zeroing the length of any that are invalid.
+// Returns `count`.
+uint32_t _sc_network_receive_accept_batch(connection_t *conn, datagram_t *dests, uint32_t *lens,
+    struct sockaddr_in *src_addrs, uint64_t *arrivals, int32_t count, uint8_t aux) {
+    for (int32_t i = 0; i < count; i++) {
+        if (!_sc_network_receive_accept(conn, &dests[i], lens[i], &src_addrs[i], arrivals[i], aux)) {
+            lens[i] = 0;
+        }
+    }
+    return (uint32_t) count;
+}
+
+uint32_t sc_network_receive_batch(connection_t *conn, datagram_t *dests, uint32_t *lens,
+    uint32_t count, uint8_t aux) {
+    uint64_t arrivals[NETWORK_BATCH_MAX];
+    return sc_network_receive_batch_timed(conn, dests, lens, arrivals, count, aux);
+}
+
+uint32_t sc_network_receive_batch_timed(connection_t *conn, datagram_t *dests, uint32_t *lens,
+    uint64_t *arrivals, uint32_t count, uint8_t aux) {
+    struct sockaddr_in src_addrs[NETWORK_BATCH_MAX];
+    struct iovec iovecs[NETWORK_BATCH_MAX];
+    struct mmsghdr msgs[NETWORK_BATCH_MAX];
+    uint8_t controls[NETWORK_BATCH_MAX][ARRIVAL_CONTROL_SIZE];
+    int32_t socket_fd = aux ? conn->socket_aux_fd : conn->socket_audio_fd;
+    uring_t *ring = aux ? conn->uring_aux : conn->uring_audio;
+    int32_t received = 0;
+
+    CORE_ASSERT(count <= NETWORK_BATCH_MAX);
+    if (ring) {
+        // Wait for the first as recvmmsg would, then take whatever else has completed
+        int32_t len = _sc_network_uring_receive(ring, &dests[0], &src_addrs[0], &arrivals[0]);
+        while (len >= 0) {
+            lens[received++] = (uint32_t) len;
+            if ((uint32_t) received == count) {
+                break;
+            }
+            len = sc_uring_receive(ring, &dests[received], &src_addrs[received], &arrivals[received], 0);
+        }
+        return _sc_network_receive_accept_batch(conn, dests, lens, src_addrs, arrivals, received, aux);
+    }
+    memset(msgs, 0, sizeof(struct mmsghdr) * count);
+    for (uint32_t i = 0; i < count; i++) {
+        iovecs[i].iov_base = &dests[i];
+        iovecs[i].iov_len = sizeof(datagram_t);
+        msgs[i].msg_hdr.msg_name = &src_addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = controls[i];
+        msgs[i].msg_hdr.msg_controllen = ARRIVAL_CONTROL_SIZE;
+    }
+
+    // Block until at least one datagram arrives, then take whatever else is queued
+    received = recvmmsg(socket_fd, msgs, count, MSG_WAITFORONE, NULL);
+    if (received < 0) {
+        // Timeouts and non-blocking sockets with nothing queued are not errors
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_ERROR("sc_network_receive_batch: errno [%d] %s", errno, strerror(errno));
+            sc_stats_record_error(&conn->stats, false, errno);
+        }
+        return 0;
+    }
+
+    for (int32_t i = 0; i < received; i++) {
+        lens[i] = msgs[i].msg_len;
+        arrivals[i] = sc_low_latency_arrival_ns(&msgs[i].msg_hdr);
+    }
+    return _sc_network_receive_accept_batch(conn, dests, lens, src_addrs, arrivals, received, aux);
+}
+
+void sc_connection_stats_snapshot(connection_t *conn, connection_stats *dest) {
+    // Every field before the receiver's tracking state is a 64 bit counter
+    const uint64_t *src_words = (const uint64_t *) &conn->stats;
+    uint64_t *dest_words = (uint64_t *) dest;
+    for (size_t i = 0; i < offsetof(connection_stats, tracking) / sizeof(uint64_t); i++) {
+        dest_words[i] = __atomic_load_n(&src_words[i], __ATOMIC_RELAXED);
+    }
+    memset(&dest->tracking, 0, sizeof(stats_tracking));
+}
@@ -0,0 +1,81 @@
+#define _GNU_SOURCE  // clock_nanosleep(...)
+
+#include "pacing.h"
+
+#include "timing.h"
+#include "logger.h"
+
+#include <stdio.h>              // fopen(...), fgets(...)
+#include <string.h>             // memset(...), memcpy(...), strncmp(...)
+#include <time.h>               // clock_nanosleep(...), CLOCK_MONOTONIC
+#include <errno.h>
+#include <linux/net_tstamp.h>   // struct sock_txtime
+
+// Whether fq is the default qdisc, so interfaces brought up with it honour SO_TXTIME.
+// Other qdiscs (including noqueue on loopback) silently send immediately.
+uint8_t _pacing_fq_default(void) {
+    char qdisc[16] = {0};
+    FILE *file = fopen("/proc/sys/net/core/default_qdisc", "r");
+    if (!file) {
+        return false;
+    }
+    uint8_t fq = fgets(qdisc, sizeof(qdisc), file) && strncmp(qdisc, "fq\n", sizeof(qdisc)) == 0;
+    fclose(file);
+    return fq;
+}
+
+void sc_pacer_init(pacer_t *pacer, int32_t socket_fd, pacing_mode mode, uint64_t gap_ns) {
+    struct sock_txtime txtime = { .clockid = CLOCK_MONOTONIC, .flags = 0 };
+
+    memset(pacer, 0, sizeof(pacer_t));
+    pacer->gap_ns = gap_ns;
+    pacer->mode = PACING_SLEEP;
+    if (mode == PACING_SLEEP || (mode == PACING_AUTO && !_pacing_fq_default())) {
+        return;
+    }
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_TXTIME, &txtime, sizeof(txtime)) < 0) {
+        LOG_WARN("SO_TXTIME unavailable, pacing by sleeping. Errno [%d] %s", errno, strerror(errno));
+        return;
+    }
+    pacer->mode = PACING_TXTIME;
+}
+
+uint64_t sc_pacer_next(pacer_t *pacer) {
+    uint64_t now_ns = sc_time_now_ns();
+    uint64_t release_ns = now_ns;
+
+    if (pacer->next_ns > now_ns) {
+        release_ns = pacer->next_ns;
+        pacer->stats.delayed++;
+    }
+    pacer->next_ns = release_ns + pacer->gap_ns;
+    pacer->stats.paced++;
+    return release_ns;
+}
+
+void sc_pacer_schedule(pacer_t *pacer, struct msghdr *msg, uint8_t *control) {
+    uint64_t release_ns = sc_pacer_next(pacer);
+
+    if (pacer->mode == PACING_TXTIME) {
+        memset(control, 0, PACING_CONTROL_SIZE);
+        msg->msg_control = control;
+        msg->msg_controllen = PACING_CONTROL_SIZE;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_TXTIME;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+        memcpy(CMSG_DATA(cmsg), &release_ns, sizeof(uint64_t));
+        return;
+    }
+    uint64_t now_ns = sc_time_now_ns();
+    if (release_ns <= now_ns) {
+        return;
+    }
+    struct timespec until = {
+        .tv_sec = (time_t) (release_ns / NS_PER_SEC),
+        .tv_nsec = (long) (release_ns % NS_PER_SEC)
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {
+    }
+    pacer->stats.slept_ns += sc_time_now_ns() - now_ns;
+}
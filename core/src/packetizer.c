@@ -0,0 +1,185 @@
+#include "packetizer.h"
+
+#include "timing.h"
+#include "assert.h"
+
+#include <string.h>     // memset(...), memcpy(...)
+#include <arpa/inet.h>  // htonl(...), htons(...), ntohl(...), ntohs(...)
+
+#define FRAGMENTS_MAX 64
+
+// Audio bytes written so far into the fragment being filled
+uint32_t _packetizer_fragment_fill(packetizer_t *pkt) {
+    return pkt->frame_offset % pkt->fragment_size;
+}
+
+void _packetizer_emit(packetizer_t *pkt, uint32_t audio_len) {
+    audio_fragment_header *fragment = (audio_fragment_header *) pkt->dgram.payload.audio;
+    uint8_t index = (uint8_t) ((pkt->frame_offset - 1) / pkt->fragment_size);
+
+    pkt->dgram.header.kind = SERVER_AUDIO;
+    pkt->dgram.header.sequence = pkt->sequence++;
+    pkt->dgram.header.timestamp = pkt->timestamp_ns ? pkt->timestamp_ns : sc_time_now_ns();
+    fragment->frame = htonl(pkt->frame);
+    fragment->fragment = index;
+    fragment->fragment_count = pkt->fragment_count;
+    fragment->fragment_size = htons(pkt->fragment_size);
+
+    pkt->emit(&pkt->dgram,
+        sizeof(datagram_header) + sizeof(audio_fragment_header) + audio_len, pkt->emit_ctx);
+}
+
+void sc_packetizer_init(packetizer_t *pkt, uint32_t frame_bytes, uint32_t packet_size,
+    packetizer_emit_fn emit, void *ctx) {
+    CORE_ASSERT(frame_bytes > 0 && frame_bytes <= AUDIO_FRAME_MAX_BYTES);
+    CORE_ASSERT(packet_size > sizeof(datagram_header) + sizeof(audio_fragment_header));
+    CORE_ASSERT(packet_size <= DATAGRAM_MAX_SIZE);
+
+    memset(pkt, 0, sizeof(packetizer_t));
+    pkt->frame_bytes = frame_bytes;
+    pkt->packet_size = packet_size;
+    pkt->fragment_size = AUDIO_FRAGMENT_CAPACITY(packet_size);
+    uint32_t fragment_count = (frame_bytes + pkt->fragment_size - 1) / pkt->fragment_size;
+    CORE_ASSERT_MSG(fragment_count <= FRAGMENTS_MAX, "packet_size too small for frame_bytes");
+    pkt->fragment_count = (uint8_t) fragment_count;
+    pkt->emit = emit;
+    pkt->emit_ctx = ctx;
+}
+
+void sc_packetizer_reconfigure(packetizer_t *pkt, uint32_t frame_bytes, uint32_t packet_size) {
+    uint32_t frame = pkt->frame;
+    uint32_t sequence = pkt->sequence;
+    uint64_t timestamp_ns = pkt->timestamp_ns;
+
+    CORE_ASSERT(pkt->frame_offset == 0);
+    sc_packetizer_init(pkt, frame_bytes, packet_size, pkt->emit, pkt->emit_ctx);
+    pkt->frame = frame;
+    pkt->sequence = sequence;
+    pkt->timestamp_ns = timestamp_ns;
+}
+
+void sc_packetizer_set_timestamp(packetizer_t *pkt, uint64_t timestamp_ns) {
+    pkt->timestamp_ns = timestamp_ns;
+}
+
+void sc_packetizer_push(packetizer_t *pkt, const uint8_t *pcm, uint32_t len) {
+    uint8_t *audio = pkt->dgram.payload.audio + sizeof(audio_fragment_header);
+
+    while (len > 0) {
+        uint32_t fill = _packetizer_fragment_fill(pkt);
+        uint32_t frame_left = pkt->frame_bytes - pkt->frame_offset;
+        uint32_t fragment_left = pkt->fragment_size - fill;
+        uint32_t take = fragment_left < frame_left ? fragment_left : frame_left;
+        take = take < len ? take : len;
+
+        memcpy(audio + fill, pcm, take);
+        pcm += take;
+        len -= take;
+        pkt->frame_offset += take;
+
+        if (take == fragment_left || take == frame_left) {
+            _packetizer_emit(pkt, fill + take);
+        }
+        if (pkt->frame_offset == pkt->frame_bytes) {
+            pkt->frame++;
+            pkt->frame_offset = 0;
+        }
+    }
+}
+
+void sc_packetizer_flush(packetizer_t *pkt) {
+    uint8_t silence[256];
+
+    memset(silence, 0, sizeof(silence));
+    while (pkt->frame_offset != 0) {
+        uint32_t frame_left = pkt->frame_bytes - pkt->frame_offset;
+        sc_packetizer_push(pkt, silence, frame_left < sizeof(silence) ? frame_left : sizeof(silence));
+    }
+}
+
+void sc_reassembler_init(reassembler_t *ra, uint64_t timeout_ns) {
+    memset(ra, 0, sizeof(reassembler_t));
+    ra->timeout_ns = timeout_ns;
+}
+
+const reassembly_slot *sc_reassembler_push(reassembler_t *ra, const datagram_t *dgram,
+    uint64_t now_ns) {
+    const audio_fragment_header *fragment = (const audio_fragment_header *) dgram->payload.audio;
+    const uint8_t *audio = dgram->payload.audio + sizeof(audio_fragment_header);
+
+    sc_reassembler_expire(ra, now_ns);
+
+    if (dgram->header.kind != SERVER_AUDIO || dgram->header.payload_len < sizeof(audio_fragment_header)) {
+        ra->stats.invalid++;
+        return NULL;
+    }
+    uint32_t frame = ntohl(fragment->frame);
+    uint32_t fragment_size = ntohs(fragment->fragment_size);
+    uint32_t audio_len = dgram->header.payload_len - sizeof(audio_fragment_header);
+    uint32_t offset = fragment->fragment * fragment_size;
+    uint8_t is_last = fragment->fragment + 1 == fragment->fragment_count;
+    if (fragment->fragment_count == 0 || fragment->fragment_count > FRAGMENTS_MAX
+        || fragment->fragment >= fragment->fragment_count
+        || offset + audio_len > AUDIO_FRAME_MAX_BYTES
+        || (!is_last && audio_len != fragment_size)) {
+        ra->stats.invalid++;
+        return NULL;
+    }
+
+    reassembly_slot *slot = &ra->slots[frame & (REASSEMBLER_FRAMES - 1)];
+    // Signed distance handles frame index wrap around
+    int32_t ahead = (int32_t) (frame - slot->frame);
+    if ((slot->in_use || slot->finished) && ahead <= 0 && ahead > -REASSEMBLER_RESYNC_DISTANCE) {
+        if (ahead < 0 || slot->finished) {
+            // A duplicate or late fragment must not reopen a frame already delivered
+            ra->stats.stale++;
+            return NULL;
+        }
+        if (fragment->fragment_count != slot->fragment_count || fragment_size != slot->fragment_size) {
+            ra->stats.invalid++;
+            return NULL;
+        }
+    } else {
+        if (slot->in_use) {
+            // An older frame still occupies the slot and can no longer complete in time
+            ra->stats.incomplete++;
+        }
+        slot->in_use = true;
+        slot->finished = false;
+        slot->frame = frame;
+        slot->fragment_count = fragment->fragment_count;
+        slot->fragment_size = (uint16_t) fragment_size;
+        slot->received_mask = 0;
+        slot->len = 0;
+        slot->first_arrival_ns = now_ns;
+    }
+
+    uint64_t bit = 1ULL << fragment->fragment;
+    if (slot->received_mask & bit) {
+        return NULL;  // Duplicate fragment
+    }
+    memcpy(slot->data + offset, audio, audio_len);
+    slot->received_mask |= bit;
+    slot->len += audio_len;
+
+    uint64_t complete_mask = slot->fragment_count == FRAGMENTS_MAX
+        ? ~0ULL : (1ULL << slot->fragment_count) - 1;
+    if (slot->received_mask != complete_mask) {
+        return NULL;
+    }
+    slot->in_use = false;
+    slot->finished = true;
+    ra->stats.completed++;
+    return slot;
+}
+
+void sc_reassembler_expire(reassembler_t *ra, uint64_t now_ns) {
+    for (uint32_t i = 0; i < REASSEMBLER_FRAMES; i++) {
+        reassembly_slot *slot = &ra->slots[i];
+        if (slot->in_use && now_ns - slot->first_arrival_ns > ra->timeout_ns) {
+            slot->in_use = false;
+            slot->finished = true;
+            ra->stats.incomplete++;
+        }
+    }
+}
@@ -0,0 +1,370 @@
+#define _GNU_SOURCE  // clock_nanosleep(...)
+
+#include "pcm_source.h"
+
+#include "dsp.h"
+#include "timing.h"
+#include "logger.h"
+
+#include <string.h>    // memset(...), memcpy(...), memcmp(...), strcmp(...)
+#include <fcntl.h>     // open(...), fcntl(...)
+#include <unistd.h>    // read(...), close(...)
+#include <time.h>      // clock_nanosleep(...)
+#include <errno.h>
+#include <sys/mman.h>  // mmap(...), munmap(...)
+#include <sys/stat.h>  // fstat(...)
+
+#define WAV_FORMAT_PCM        1
+#define WAV_FORMAT_FLOAT      3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+// Bytes of a "fmt " chunk needed, up to the extensible subformat tag
+#define WAV_FMT_BYTES 26
+
+uint16_t _le16(const uint8_t *src) {
+    return (uint16_t) (src[0] | src[1] << 8);
+}
+
+uint32_t _le32(const uint8_t *src) {
+    return (uint32_t) src[0] | (uint32_t) src[1] << 8 | (uint32_t) src[2] << 16 | (uint32_t) src[3] << 24;
+}
+
+uint32_t _pcm_sample_bytes(pcm_format format) {
+    return format == PCM_FORMAT_S16 ? 2 : format == PCM_FORMAT_S24 ? 3 : 4;
+}
+
+// Take the next `len` header bytes into `dest` (NULL to skip them), from the mapping or,
+// blocking, from the pipe.
+// Returns true if successful, false if the input ended first.
+uint8_t _pcm_take(pcm_source_t *src, uint8_t *dest, uint32_t len) {
+    if (src->map) {
+        if (src->offset + len > src->map_size) {
+            return false;
+        }
+        if (dest) {
+            memcpy(dest, src->map + src->offset, len);
+        }
+        src->offset += len;
+        return true;
+    }
+    uint8_t discard[256];
+    while (len > 0) {
+        uint32_t want = dest ? len : (len < sizeof(discard) ? len : sizeof(discard));
+        ssize_t got = read(src->fd, dest ? dest : discard, want);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        if (dest) {
+            dest += got;
+        }
+        len -= (uint32_t) got;
+    }
+    return true;
+}
+
+// Parse the chunks of a WAV file following its RIFF header, up to the start of the samples.
+// Returns true if successful, false otherwise.
+uint8_t _pcm_parse_wav(pcm_source_t *src) {
+    uint8_t chunk[8];
+    uint8_t fmt[WAV_FMT_BYTES];
+    uint8_t have_fmt = false;
+
+    while (_pcm_take(src, chunk, sizeof(chunk))) {
+        uint32_t size = _le32(chunk + 4);
+        uint32_t padded = size + (size & 1);
+        if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) {
+                break;
+            }
+            src->data_start = src->offset;
+            // Streamed WAVs often carry a placeholder size: trust the mapping instead
+            src->data_end = src->map && src->offset + size <= src->map_size ? src->offset + size : src->map_size;
+            return true;
+        }
+        if (memcmp(chunk, "fmt ", 4) != 0 || size < 16) {
+            if (!_pcm_take(src, NULL, padded)) {
+                break;
+            }
+            continue;
+        }
+        uint32_t keep = size < WAV_FMT_BYTES ? size : WAV_FMT_BYTES;
+        if (!_pcm_take(src, fmt, keep) || !_pcm_take(src, NULL, padded - keep)) {
+            break;
+        }
+        uint16_t tag = _le16(fmt);
+        uint16_t bits = _le16(fmt + 14);
+        if (tag == WAV_FORMAT_EXTENSIBLE && keep >= WAV_FMT_BYTES) {
+            tag = _le16(fmt + 24);
+        }
+        src->params.channels = (uint8_t) _le16(fmt + 2);
+        src->params.sample_rate = _le32(fmt + 4);
+        if (tag == WAV_FORMAT_PCM && bits == 16) {
+            src->params.format = PCM_FORMAT_S16;
+        } else if (tag == WAV_FORMAT_PCM && bits == 24) {
+            src->params.format = PCM_FORMAT_S24;
+        } else if (tag == WAV_FORMAT_FLOAT && bits == 32) {
+            src->params.format = PCM_FORMAT_F32;
+        } else {
+            LOG_ERROR("Unsupported WAV sample format (tag %d, %d bits)", tag, bits);
+            return false;
+        }
+        have_fmt = true;
+    }
+    LOG_ERROR("Malformed WAV header");
+    return false;
+}
+
+uint8_t sc_pcm_source_open(pcm_source_t *src, const char *path, const pcm_params *params, uint8_t loop) {
+    struct stat st;
+    uint8_t riff[12];
+
+    memset(src, 0, sizeof(pcm_source_t));
+    src->params = *params;
+    src->loop = loop;
+    src->fd_flags = -1;
+    src->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (src->fd < 0) {
+        LOG_ERROR("sc_pcm_source_open: cannot open %s. Errno [%d] %s", path, errno, strerror(errno));
+        return false;
+    }
+    // Regular files are mapped and read in place, anything else is read as a stream
+    if (fstat(src->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        src->map_size = (uint64_t) st.st_size;
+        src->map = mmap(NULL, src->map_size, PROT_READ, MAP_PRIVATE, src->fd, 0);
+        if (src->map == MAP_FAILED) {
+            LOG_ERROR("sc_pcm_source_open: cannot map %s. Errno [%d] %s", path, errno, strerror(errno));
+            src->map = NULL;
+            sc_pcm_source_close(src);
+            return false;
+        }
+        madvise((void *) src->map, src->map_size, MADV_SEQUENTIAL);
+        src->data_end = src->map_size;
+    }
+
+    if (!_pcm_take(src, riff, sizeof(riff))) {
+        LOG_ERROR("sc_pcm_source_open: %s is empty", path);
+        sc_pcm_source_close(src);
+        return false;
+    }
+    if (memcmp(riff, "RIFF", 4) == 0 && memcmp(riff + 8, "WAVE", 4) == 0) {
+        if (!_pcm_parse_wav(src)) {
+            sc_pcm_source_close(src);
+            return false;
+        }
+    } else if (src->map) {
+        src->data_start = 0;
+    } else {
+        // Raw samples: the bytes taken while checking for a header are the first of them
+        memcpy(src->buffer, riff, sizeof(riff));
+        src->pending = sizeof(riff);
+    }
+    src->offset = src->data_start;
+
+    if (src->params.channels == 0 || src->params.channels > CODEC_CHANNELS_MAX || src->params.sample_rate == 0) {
+        LOG_ERROR("sc_pcm_source_open: unsupported layout (%d channels at %u Hz)", src->params.channels,
+            src->params.sample_rate);
+        sc_pcm_source_close(src);
+        return false;
+    }
+    src->frame_bytes = _pcm_sample_bytes(src->params.format) * src->params.channels;
+    if (src->map && src->data_end - src->data_start < src->frame_bytes) {
+        LOG_ERROR("sc_pcm_source_open: %s holds no samples", path);
+        sc_pcm_source_close(src);
+        return false;
+    }
+    if (!src->map) {
+        // Reads take what the pipe has, the schedule waits for the rest. The flags belong to
+        // the open file, which stdin shares with the parent, so they are restored on close.
+        src->fd_flags = fcntl(src->fd, F_GETFL);
+        if (src->fd_flags < 0 || fcntl(src->fd, F_SETFL, src->fd_flags | O_NONBLOCK) < 0) {
+            LOG_ERROR("sc_pcm_source_open: cannot make %s non-blocking. Errno [%d] %s", path, errno,
+                strerror(errno));
+            src->fd_flags = -1;
+            sc_pcm_source_close(src);
+            return false;
+        }
+    }
+    LOG_INFO("PCM source %s: %u Hz, %d channels, %u bit%s", path, src->params.sample_rate,
+        src->params.channels, _pcm_sample_bytes(src->params.format) * 8,
+        src->params.format == PCM_FORMAT_F32 ? " float" : "");
+    return true;
+}
+
+void sc_pcm_source_close(pcm_source_t *src) {
+    if (src->map) {
+        munmap((void *) src->map, src->map_size);
+        src->map = NULL;
+    }
+    if (src->fd_flags >= 0) {
+        fcntl(src->fd, F_SETFL, src->fd_flags);
+        src->fd_flags = -1;
+    }
+    if (src->fd != STDIN_FILENO) {
+        close(src->fd);
+    }
+}
+
+void sc_pcm_source_start(pcm_source_t *src, uint64_t now_ns) {
+    src->start_ns = now_ns;
+    src->scheduled = 0;
+}
+
+uint32_t sc_pcm_source_due(pcm_source_t *src, uint64_t now_ns) {
+    uint64_t rate = src->params.sample_rate;
+    if (now_ns < src->start_ns) {
+        return 0;
+    }
+    // Split to keep days of elapsed nanoseconds times the rate within 64 bits
+    uint64_t elapsed = now_ns - src->start_ns;
+    uint64_t frames = elapsed / NS_PER_SEC * rate + elapsed % NS_PER_SEC * rate / NS_PER_SEC;
+    if (frames <= src->scheduled) {
+        return 0;
+    }
+    if (frames - src->scheduled > rate) {
+        sc_pcm_source_start(src, now_ns);
+        src->stats.resyncs++;
+        return 0;
+    }
+    return (uint32_t) (frames - src->scheduled);
+}
+
+uint64_t sc_pcm_source_due_ns(pcm_source_t *src) {
+    uint64_t rate = src->params.sample_rate;
+    return src->start_ns + src->scheduled / rate * NS_PER_SEC + src->scheduled % rate * NS_PER_SEC / rate;
+}
+
+void sc_pcm_source_wait(pcm_source_t *src, uint32_t frames) {
+    uint64_t rate = src->params.sample_rate;
+    uint64_t target = src->scheduled + frames;
+    uint64_t due_ns = src->start_ns + target / rate * NS_PER_SEC + target % rate * NS_PER_SEC / rate;
+    struct timespec due = {
+        .tv_sec = (time_t) (due_ns / NS_PER_SEC),
+        .tv_nsec = (long) (due_ns % NS_PER_SEC)
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {
+    }
+}
+
+// Point `in` at the next `frames` frames of the mapped file, wrapping when looping.
+// Returns the frames available.
+uint32_t _pcm_read_file(pcm_source_t *src, uint32_t frames, const uint8_t **in) {
+    uint32_t need = frames * src->frame_bytes;
+    uint64_t left = (src->data_end - src->offset) / src->frame_bytes * src->frame_bytes;
+
+    if (left >= need) {
+        *in = src->map + src->offset;
+        src->offset += need;
+        return frames;
+    }
+    if (!src->loop) {
+        *in = src->map + src->offset;
+        src->offset += left;
+        src->eof = true;
+        return (uint32_t) (left / src->frame_bytes);
+    }
+    // Join the end of the file to its start
+    uint32_t filled = 0;
+    while (filled < need) {
+        if (left == 0) {
+            src->offset = src->data_start;
+            left = (src->data_end - src->offset) / src->frame_bytes * src->frame_bytes;
+        }
+        uint32_t take = need - filled < left ? need - filled : (uint32_t) left;
+        memcpy(src->buffer + filled, src->map + src->offset, take);
+        src->offset += take;
+        filled += take;
+        left -= take;
+    }
+    *in = src->buffer;
+    return frames;
+}
+
+// Gather the next `frames` frames from the pipe into the buffer.
+// Returns `frames` once all have arrived, what is left at the end of the input, else 0.
+uint32_t _pcm_read_pipe(pcm_source_t *src, uint32_t frames, const uint8_t **in) {
+    uint32_t need = frames * src->frame_bytes;
+
+    while (src->pending < need) {
+        ssize_t got = read(src->fd, src->buffer + src->pending, need - src->pending);
+        if (got > 0) {
+            src->pending += (uint32_t) got;
+            continue;
+        }
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_ERROR("PCM source read failed. Errno [%d] %s", errno, strerror(errno));
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            src->stats.underruns++;
+            return 0;
+        }
+        src->eof = true;
+        frames = src->pending / src->frame_bytes;
+        break;
+    }
+    *in = src->buffer;
+    src->pending = 0;
+    return frames;
+}
+
+uint32_t sc_pcm_source_read(pcm_source_t *src, uint32_t frames, const int16_t **pcm) {
+    const uint8_t *in = NULL;
+
+    if (frames > PCM_SOURCE_FRAMES_MAX) {
+        frames = PCM_SOURCE_FRAMES_MAX;
+    }
+    if (src->eof || frames == 0) {
+        return 0;
+    }
+    frames = src->map ? _pcm_read_file(src, frames, &in) : _pcm_read_pipe(src, frames, &in);
+    if (frames == 0) {
+        return 0;
+    }
+
+    uint32_t samples = frames * src->params.channels;
+    switch (src->params.format) {
+        case PCM_FORMAT_S16:
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            if (((uintptr_t) in & 1) == 0) {
+                *pcm = (const int16_t *) in;
+                src->stats.zero_copy += in != src->buffer;
+                break;
+            }
+            memcpy(src->s16, in, samples * sizeof(int16_t));
+#else
+            for (uint32_t i = 0; i < samples; i++) {
+                src->s16[i] = (int16_t) _le16(in + i * 2);
+            }
+#endif
+            *pcm = src->s16;
+            break;
+        case PCM_FORMAT_S24:
+            sc_dsp_s24_to_f32(in, src->f32, samples);
+            sc_dsp_f32_to_s16(src->f32, src->s16, samples);
+            *pcm = src->s16;
+            break;
+        case PCM_FORMAT_F32:
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            if (((uintptr_t) in & 3) == 0) {
+                sc_dsp_f32_to_s16((const float *) in, src->s16, samples);
+                *pcm = src->s16;
+                break;
+            }
+#endif
+            for (uint32_t i = 0; i < samples; i++) {
+                uint32_t bits = _le32(in + i * 4);
+                memcpy(&src->f32[i], &bits, sizeof(float));
+            }
+            sc_dsp_f32_to_s16(src->f32, src->s16, samples);
+            *pcm = src->s16;
+            break;
+    }
+    src->scheduled += frames;
+    src->stats.frames += frames;
+    return frames;
+}
@@ -0,0 +1,170 @@
+#include "rate_control.h"
+
+#include "timing.h"
+#include "logger.h"
+
+#include <string.h>     // memset(...), strncpy(...), strncmp(...)
+#include <arpa/inet.h>  // htonl(...), ntohl(...)
+
+// Packet size change per step under moderate loss and per relaxing step
+#define PACKET_SIZE_STEP 128
+
+void sc_report_builder_init(report_builder_t *builder) {
+    memset(builder, 0, sizeof(report_builder_t));
+}
+
+uint32_t sc_receiver_report_build(report_builder_t *builder, jitter_buffer_t *jb,
+    const char *group, datagram_t *dest) {
+    receiver_report *report = (receiver_report *) dest->payload.audio;
+    // Everything that arrived over the network, late or not. Duplicates are left out so
+    // they cannot mask losses.
+    uint64_t received = jb->stats.received + jb->stats.late;
+    uint32_t loss_fraction = 0;
+
+    if (builder->started && jb->started) {
+        uint32_t expected = jb->highest_sequence - builder->last_highest;
+        uint64_t arrived = received - builder->last_received;
+        // Across a resync (e.g. the server restarted its sequence) the span between the two
+        // highest sequences means nothing: report no loss and restart the baseline here
+        uint8_t rebased = jb->stats.resyncs != builder->last_resyncs || (int32_t) expected < 0;
+        if (!rebased && expected > 0 && arrived < expected) {
+            loss_fraction = (uint32_t) (((expected - arrived) << 8) / expected);
+        }
+    }
+    if (jb->started) {
+        builder->last_highest = jb->highest_sequence;
+        builder->last_received = received;
+        builder->last_resyncs = jb->stats.resyncs;
+        builder->started = true;
+    }
+
+    dest->header.kind = CLIENT_REPORT;
+    dest->header.sequence = 0;
+    dest->header.timestamp = sc_time_now_ns();
+    memset(report, 0, sizeof(receiver_report));
+    strncpy(report->group_addr, group, INET_ADDRSTRLEN - 1);
+    report->loss_fraction = loss_fraction > 255 ? 255 : (uint8_t) loss_fraction;
+    uint64_t buffer_ms = sc_jitter_buffer_delay_ns(jb) / (NS_PER_SEC / 1000);
+    report->buffer_ms = htons(buffer_ms > UINT16_MAX ? UINT16_MAX : (uint16_t) buffer_ms);
+    report->jitter_us = htonl((uint32_t) (jb->jitter_ns / NS_PER_USEC));
+    report->highest_sequence = htonl(jb->highest_sequence);
+    dest->header.payload_len = sizeof(receiver_report);
+    return sizeof(datagram_header) + sizeof(receiver_report);
+}
+
+void sc_rate_controller_init(rate_controller_t *rc, const char *group, const rate_bounds *bounds,
+    uint64_t report_timeout_ns) {
+    memset(rc, 0, sizeof(rate_controller_t));
+    strncpy(rc->group_addr, group, INET_ADDRSTRLEN - 1);
+    rc->bounds = *bounds;
+    rc->report_timeout_ns = report_timeout_ns;
+    rc->settings.packet_size = bounds->max_packet_size;
+    rc->settings.fec_group = bounds->max_fec_group;
+    rc->settings.codec = bounds->high_codec;
+}
+
+uint8_t sc_rate_controller_handle_report(rate_controller_t *rc, const datagram_t *report,
+    struct sockaddr_in *src, uint64_t now_ns) {
+    const receiver_report *payload = (const receiver_report *) report->payload.audio;
+    receiver_state *receiver = NULL;
+
+    if (report->header.kind != CLIENT_REPORT || report->header.payload_len < sizeof(receiver_report)) {
+        LOG_WARN("sc_rate_controller_handle_report: malformed receiver report");
+        return false;
+    }
+    if (strncmp(payload->group_addr, rc->group_addr, INET_ADDRSTRLEN) != 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < rc->receiver_count; i++) {
+        if (rc->receivers[i].addr == src->sin_addr.s_addr && rc->receivers[i].port == src->sin_port) {
+            receiver = &rc->receivers[i];
+            break;
+        }
+    }
+    if (!receiver) {
+        if (rc->receiver_count == RATE_CONTROL_RECEIVERS_MAX) {
+            return false;
+        }
+        receiver = &rc->receivers[rc->receiver_count++];
+        receiver->addr = src->sin_addr.s_addr;
+        receiver->port = src->sin_port;
+    }
+    receiver->loss_fraction = payload->loss_fraction;
+    receiver->buffer_ms = ntohs(payload->buffer_ms);
+    receiver->jitter_us = ntohl(payload->jitter_us);
+    receiver->received_ns = now_ns;
+    rc->stats.reports++;
+    return true;
+}
+
+uint8_t sc_rate_controller_update(rate_controller_t *rc, uint64_t now_ns) {
+    const rate_bounds *bounds = &rc->bounds;
+    rate_settings before = rc->settings;
+    rate_settings *s = &rc->settings;
+    uint8_t worst_loss = 0;
+    uint32_t worst_jitter_us = 0;
+
+    // Forget silent receivers (packing the array), then take the worst of the rest: one
+    // struggling receiver is enough to need the stream made more robust
+    uint32_t i = 0;
+    while (i < rc->receiver_count) {
+        receiver_state *receiver = &rc->receivers[i];
+        if (now_ns - receiver->received_ns > rc->report_timeout_ns) {
+            *receiver = rc->receivers[--rc->receiver_count];
+            continue;
+        }
+        worst_loss = receiver->loss_fraction > worst_loss ? receiver->loss_fraction : worst_loss;
+        worst_jitter_us = receiver->jitter_us > worst_jitter_us ? receiver->jitter_us : worst_jitter_us;
+        i++;
+    }
+    if (rc->receiver_count == 0) {
+        return false;
+    }
+
+    uint8_t congested = worst_loss >= RATE_CONTROL_LOSS_CONGESTED
+        || (bounds->congested_jitter_us && worst_jitter_us >= bounds->congested_jitter_us);
+    if (congested) {
+        // Multiplicative decrease: lower bitrate and double the protection at once
+        s->codec = bounds->low_codec;
+        s->fec_group = s->fec_group / 2 > bounds->min_fec_group ? s->fec_group / 2 : bounds->min_fec_group;
+        s->packet_size = bounds->min_packet_size;
+        rc->clean_intervals = 0;
+    } else if (worst_loss >= RATE_CONTROL_LOSS_LOSSY) {
+        // Lossy but not congested: each lost packet should cost less audio and be repairable
+        s->fec_group = s->fec_group > bounds->min_fec_group ? s->fec_group - 1 : bounds->min_fec_group;
+        s->packet_size = s->packet_size > bounds->min_packet_size + PACKET_SIZE_STEP
+            ? s->packet_size - PACKET_SIZE_STEP : bounds->min_packet_size;
+        rc->clean_intervals = 0;
+    } else if (worst_loss <= RATE_CONTROL_LOSS_CLEAN) {
+        // Additive increase, one step per run of clean intervals
+        rc->clean_intervals++;
+        if (rc->clean_intervals % RATE_CONTROL_CLEAN_TO_RELAX == 0) {
+            if (s->fec_group < bounds->max_fec_group) {
+                s->fec_group++;
+            } else if (s->packet_size < bounds->max_packet_size) {
+                s->packet_size = s->packet_size + PACKET_SIZE_STEP < bounds->max_packet_size
+                    ? s->packet_size + PACKET_SIZE_STEP : bounds->max_packet_size;
+            }
+        }
+        if (rc->clean_intervals >= RATE_CONTROL_CLEAN_TO_UPGRADE) {
+            s->codec = bounds->high_codec;
+        }
+    }
+
+    uint8_t changed = s->codec != before.codec || s->fec_group != before.fec_group
+        || s->packet_size != before.packet_size;
+    if (changed) {
+        uint8_t decreased = s->codec != before.codec ? s->codec == bounds->low_codec
+            : s->fec_group != before.fec_group ? s->fec_group < before.fec_group
+            : s->packet_size < before.packet_size;
+        if (decreased) {
+            rc->stats.decreases++;
+        } else {
+            rc->stats.increases++;
+        }
+        LOG_INFO("Rate control %.*s: loss %d/256 jitter %u us -> packet %u B, FEC 1/%d, codec %d",
+            INET_ADDRSTRLEN, rc->group_addr, worst_loss, worst_jitter_us,
+            s->packet_size, s->fec_group, s->codec);
+    }
+    return changed;
+}
@@ -0,0 +1,141 @@
+#include "retransmit.h"
+
+#include "networking.h"
+#include "timing.h"
+#include "logger.h"
+
+#include <stddef.h>     // offsetof(...)
+#include <string.h>     // memset(...), memcpy(...), strncpy(...), strncmp(...)
+#include <arpa/inet.h>  // htonl(...), ntohl(...)
+
+#define CACHE_MASK (RETRANSMIT_CACHE_CAPACITY - 1)
+#define TRACKER_MASK (JITTER_BUFFER_CAPACITY - 1)
+
+void sc_retransmit_cache_init(retransmit_cache_t *cache, uint64_t suppress_ns) {
+    memset(cache, 0, sizeof(retransmit_cache_t));
+    cache->suppress_ns = suppress_ns;
+}
+
+void sc_retransmit_cache_store(retransmit_cache_t *cache, const datagram_t *dgram, uint32_t len) {
+    retransmit_entry *entry = &cache->entries[dgram->header.sequence & CACHE_MASK];
+    memcpy(&entry->dgram, dgram, len);
+    entry->len = len;
+    entry->last_repair_ns = 0;
+    if (!cache->stored || (int32_t) (dgram->header.sequence - cache->newest_sequence) > 0) {
+        cache->newest_sequence = dgram->header.sequence;
+        cache->stored = true;
+    }
+}
+
+// Queue `sequence` for repair unless it is unavailable or was just repaired.
+void _retransmit_queue(retransmit_cache_t *cache, uint32_t sequence, uint64_t now_ns,
+    datagram_t **repairs, uint32_t *lens, uint32_t *count) {
+    retransmit_entry *entry = &cache->entries[sequence & CACHE_MASK];
+
+    cache->stats.requested++;
+    if (entry->len == 0 || entry->dgram.header.sequence != sequence) {
+        cache->stats.unavailable++;
+        return;
+    }
+    if (entry->last_repair_ns != 0 && now_ns - entry->last_repair_ns < cache->suppress_ns) {
+        cache->stats.suppressed++;
+        return;
+    }
+    if (*count == NETWORK_BATCH_MAX) {
+        return;  // Anything beyond one batch is left for the client's next NACK
+    }
+    entry->last_repair_ns = now_ns;
+    repairs[*count] = &entry->dgram;
+    lens[*count] = entry->len;
+    (*count)++;
+}
+
+uint32_t sc_retransmit_cache_handle_nack(retransmit_cache_t *cache, connection_t *conn,
+    const datagram_t *nack, uint64_t now_ns) {
+    const nack_payload *payload = (const nack_payload *) nack->payload.audio;
+    datagram_t *repairs[NETWORK_BATCH_MAX];
+    uint32_t lens[NETWORK_BATCH_MAX];
+    uint8_t results[NETWORK_BATCH_MAX];
+    uint32_t count = 0;
+
+    if (nack->header.kind != CLIENT_NACK || nack->header.payload_len < offsetof(nack_payload, entries)
+        || payload->count > NACK_ENTRIES_MAX
+        || nack->header.payload_len < offsetof(nack_payload, entries) + payload->count * sizeof(nack_entry)) {
+        LOG_WARN("sc_retransmit_cache_handle_nack: malformed NACK");
+        return 0;
+    }
+    if (strncmp(payload->group_addr, conn->group_addr, INET_ADDRSTRLEN) != 0) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < payload->count; i++) {
+        uint32_t base = ntohl(payload->entries[i].base_sequence);
+        uint32_t bitmap = ntohl(payload->entries[i].bitmap);
+        _retransmit_queue(cache, base, now_ns, repairs, lens, &count);
+        for (uint32_t bit = 0; bitmap != 0; bit++, bitmap >>= 1) {
+            if (bitmap & 1) {
+                _retransmit_queue(cache, base + 1 + bit, now_ns, repairs, lens, &count);
+            }
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+    // Repairs keep their original sequence so clients slot them straight into place
+    uint32_t sent = sc_network_send_batch(conn, repairs, lens, results, count);
+    cache->stats.repaired += sent;
+    return sent;
+}
+
+void sc_nack_tracker_init(nack_tracker_t *tracker, uint64_t retry_ns) {
+    memset(tracker, 0, sizeof(nack_tracker_t));
+    tracker->retry_ns = retry_ns;
+}
+
+uint32_t sc_nack_build(nack_tracker_t *tracker, jitter_buffer_t *jb, const char *group,
+    datagram_t *dest, uint64_t now_ns) {
+    nack_payload *payload = (nack_payload *) dest->payload.audio;
+    nack_entry *entry = NULL;
+    uint32_t base = 0;
+    uint32_t bitmap = 0;
+    uint32_t len;
+
+    if (!jb->started) {
+        return 0;
+    }
+    payload->count = 0;
+    for (uint32_t sequence = jb->next_sequence; sequence != jb->highest_sequence; sequence++) {
+        if (sc_jitter_buffer_peek(jb, sequence, &len)) {
+            continue;
+        }
+        uint32_t slot = sequence & TRACKER_MASK;
+        if (tracker->sent_ns[slot] != 0 && tracker->sequences[slot] == sequence
+            && now_ns - tracker->sent_ns[slot] < tracker->retry_ns) {
+            continue;
+        }
+        if (entry && sequence - base - 1 < 32) {
+            bitmap |= 1U << (sequence - base - 1);
+            entry->bitmap = htonl(bitmap);
+        } else if (payload->count < NACK_ENTRIES_MAX) {
+            entry = &payload->entries[payload->count++];
+            base = sequence;
+            bitmap = 0;
+            entry->base_sequence = htonl(base);
+            entry->bitmap = 0;
+        } else {
+            break;  // Full: the rest are requested by the next NACK
+        }
+        tracker->sequences[slot] = sequence;
+        tracker->sent_ns[slot] = now_ns;
+    }
+    if (payload->count == 0) {
+        return 0;
+    }
+    memset(payload->group_addr, '\0', INET_ADDRSTRLEN);
+    strncpy(payload->group_addr, group, INET_ADDRSTRLEN - 1);
+    uint32_t payload_len = offsetof(nack_payload, entries) + payload->count * sizeof(nack_entry);
+    dest->header.kind = CLIENT_NACK;
+    dest->header.payload_len = payload_len;
+    dest->header.sequence = jb->next_sequence;
+    dest->header.timestamp = sc_time_now_ns();
+    return sizeof(datagram_header) + payload_len;
+}
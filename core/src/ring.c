@@ -0,0 +1,117 @@
+#define _GNU_SOURCE  // posix_memalign(...)
+
+#include "ring.h"
+
+#include "networking.h"
+#include "logger.h"
+
+#include <stdlib.h>      // posix_memalign(...), free(...)
+#include <string.h>      // memset(...), strerror(...)
+#include <sys/socket.h>  // setsockopt(...)
+#include <sys/time.h>    // struct timeval
+#include <errno.h>
+
+#define SLOT_MASK (RING_CAPACITY - 1)
+
+// How often an idle receiver thread wakes to check whether it should stop
+#define RECEIVER_WAKE_USEC 100000
+
+ring_t *sc_ring_create(void) {
+    void *ring;
+    if (posix_memalign(&ring, CACHE_LINE_SIZE, sizeof(ring_t)) != 0) {
+        LOG_ERROR("sc_ring_create: allocation failed");
+        return NULL;
+    }
+    memset(ring, 0, sizeof(ring_t));
+    return (ring_t *) ring;
+}
+
+void sc_ring_destroy(ring_t *ring) {
+    free(ring);
+}
+
+uint32_t sc_ring_producer_reserve(ring_t *ring, uint32_t *index) {
+    uint32_t head = ring->head;
+    uint32_t free_slots = RING_CAPACITY - (head - ring->cached_tail);
+    if (free_slots == 0) {
+        // Only re-read the consumer's index (and its cache line) when out of known space
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        free_slots = RING_CAPACITY - (head - ring->cached_tail);
+    }
+    // Clamp to the run before the end of the slot array
+    uint32_t until_wrap = RING_CAPACITY - (head & SLOT_MASK);
+    *index = head & SLOT_MASK;
+    return free_slots < until_wrap ? free_slots : until_wrap;
+}
+
+void sc_ring_producer_commit(ring_t *ring, uint32_t count) {
+    __atomic_store_n(&ring->head, ring->head + count, __ATOMIC_RELEASE);
+}
+
+datagram_t *sc_ring_consumer_peek(ring_t *ring, uint32_t *len) {
+    uint32_t tail = ring->tail;
+    if (tail == ring->cached_head) {
+        ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail == ring->cached_head) {
+            return NULL;
+        }
+    }
+    *len = ring->lens[tail & SLOT_MASK];
+    return &ring->dgrams[tail & SLOT_MASK];
+}
+
+void sc_ring_consumer_release(ring_t *ring) {
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+void *_ring_receiver_main(void *arg) {
+    ring_receiver_t *rx = (ring_receiver_t *) arg;
+    datagram_t overflow[NETWORK_BATCH_MAX];
+    uint32_t overflow_lens[NETWORK_BATCH_MAX];
+    uint32_t index;
+
+    while (__atomic_load_n(&rx->running, __ATOMIC_ACQUIRE)) {
+        uint32_t free_slots = sc_ring_producer_reserve(rx->ring, &index);
+        if (free_slots == 0) {
+            // Consumer is behind: keep draining the socket and drop at our end
+            uint32_t received = sc_network_receive_batch(rx->conn, overflow, overflow_lens,
+                NETWORK_BATCH_MAX, false);
+            __atomic_fetch_add(&rx->ring->dropped, received, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (free_slots > NETWORK_BATCH_MAX) {
+            free_slots = NETWORK_BATCH_MAX;
+        }
+        uint32_t received = sc_network_receive_batch(rx->conn, &rx->ring->dgrams[index],
+            &rx->ring->lens[index], free_slots, false);
+        if (received > 0) {
+            sc_ring_producer_commit(rx->ring, received);
+        }
+    }
+    return NULL;
+}
+
+uint8_t sc_ring_receiver_start(ring_receiver_t *rx, connection_t *conn, ring_t *ring) {
+    // Bound blocking receives so the thread notices sc_ring_receiver_stop when idle
+    struct timeval wake = { 0, RECEIVER_WAKE_USEC };
+    if (setsockopt(conn->socket_audio_fd, SOL_SOCKET, SO_RCVTIMEO, &wake, sizeof(struct timeval)) < 0) {
+        LOG_ERROR("sc_ring_receiver_start: failed to set receive timeout. Errno [%d] %s",
+            errno, strerror(errno));
+        return false;
+    }
+    rx->conn = conn;
+    rx->ring = ring;
+    rx->running = true;
+    int32_t ret = pthread_create(&rx->thread, NULL, _ring_receiver_main, rx);
+    if (ret != 0) {
+        LOG_ERROR("sc_ring_receiver_start: pthread_create failed. Errno [%d] %s", ret, strerror(ret));
+        rx->running = false;
+        return false;
+    }
+    return true;
+}
+
+void sc_ring_receiver_stop(ring_receiver_t *rx) {
+    __atomic_store_n(&rx->running, false, __ATOMIC_RELEASE);
+    pthread_join(rx->thread, NULL);
+}
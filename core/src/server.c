@@ -0,0 +1,251 @@
+#define _GNU_SOURCE  // pthread_setaffinity_np(...), CPU_SET(...)
+
+#include "server.h"
+
+#include "networking.h"
+#include "codec.h"
+#include "timing.h"
+#include "logger.h"
+
+#include <stdlib.h>  // malloc(...), free(...)
+#include <string.h>  // memset(...), memcpy(...)
+#include <unistd.h>  // sysconf(...)
+#include <sched.h>   // cpu_set_t
+#include <errno.h>
+
+void _server_channel_tick(void *ctx) {
+    server_channel *channel = (server_channel *) ctx;
+    channel->source(&channel->conn, channel->source_ctx);
+}
+
+void _server_control_readable(void *ctx) {
+    server_t *server = (server_t *) ctx;
+    datagram_t request;
+    struct sockaddr_in src;
+    while (sc_network_receive_from(&server->control, &request, true, &src)) {
+        sc_server_handle_request(server, &request, &src);
+    }
+}
+
+void *_server_worker_main(void *arg) {
+    server_worker *worker = (server_worker *) arg;
+    sc_event_loop_run(&worker->loop);
+    return NULL;
+}
+
+server_t *sc_server_create(uint32_t worker_count) {
+    int64_t cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) {
+        cores = 1;
+    }
+    if (worker_count == 0) {
+        worker_count = (uint32_t) cores;
+    }
+    if (worker_count > SERVER_WORKERS_MAX) {
+        worker_count = SERVER_WORKERS_MAX;
+    }
+
+    server_t *server = malloc(sizeof(server_t));
+    if (!server) {
+        LOG_ERROR("sc_server_create: allocation failed");
+        return NULL;
+    }
+    memset(server, 0, sizeof(server_t));
+    if (!sc_socket_server_init(&server->control)) {
+        free(server);
+        return NULL;
+    }
+    server->worker_count = worker_count;
+    for (uint32_t i = 0; i < worker_count; i++) {
+        server->workers[i].cpu = (int32_t) (i % cores);
+    }
+    return server;
+}
+
+void sc_server_destroy(server_t *server) {
+    datagram_t close_notif;
+
+    if (server->running) {
+        sc_server_stop(server);
+    }
+    close_notif.header.kind = SERVER_CLOSE;
+    for (uint32_t i = 0; i < server->channel_count; i++) {
+        connection_t *channel = &server->channels[i].conn;
+        close_notif.header.sequence = server->control.send_sequence;
+        close_notif.header.timestamp = sc_time_now_ns();
+        memcpy(close_notif.payload.group_addr, channel->group_addr, INET_ADDRSTRLEN);
+        if (!sc_network_send(&server->control, &close_notif, sizeof(datagram_header) + INET_ADDRSTRLEN)) {
+            LOG_WARN("Failed to broadcast close for group %.*s", INET_ADDRSTRLEN, channel->group_addr);
+        }
+        sc_socket_close(channel);
+        if (server->channels[i].fanout) {
+            sc_fanout_destroy(server->channels[i].fanout);
+            free(server->channels[i].fanout);
+        }
+        free(server->channels[i].pacer);
+    }
+    // Channel groups were closed above; the control connection has no group of its own
+    memset(server->control.group_addr, '\0', INET_ADDRSTRLEN);
+    sc_socket_close(&server->control);
+    free(server);
+}
+
+int32_t sc_server_add_channel(server_t *server, const char *group, uint8_t codec, uint32_t sample_rate,
+    uint8_t channels, uint64_t interval_ns, channel_source_fn source, void *ctx) {
+    if (server->running) {
+        LOG_WARN("sc_server_add_channel: server is running");
+        return -1;
+    }
+    if (server->channel_count == SERVER_CHANNELS_MAX) {
+        LOG_WARN("sc_server_add_channel: channel limit (%d) reached", SERVER_CHANNELS_MAX);
+        return -1;
+    }
+    if (channels == 0 || channels > CODEC_CHANNELS_MAX || sample_rate == 0) {
+        LOG_WARN("sc_server_add_channel: unsupported layout (%u Hz, %d channels)", sample_rate, channels);
+        return -1;
+    }
+    int32_t index = (int32_t) server->channel_count++;
+    server_channel *channel = &server->channels[index];
+    sc_socket_channel_init(&channel->conn, group, codec, sample_rate, channels);
+    channel->source = source;
+    channel->source_ctx = ctx;
+    channel->interval_ns = interval_ns;
+    return index;
+}
+
+uint8_t sc_server_enable_fanout(server_t *server, int32_t index, uint64_t expiry_ns) {
+    if (server->running || index < 0 || (uint32_t) index >= server->channel_count) {
+        LOG_WARN("sc_server_enable_fanout: invalid channel (%d) or server running", index);
+        return false;
+    }
+    server_channel *channel = &server->channels[index];
+    if (channel->fanout) {
+        return true;
+    }
+    channel->fanout = malloc(sizeof(fanout_t));
+    if (!channel->fanout) {
+        LOG_ERROR("sc_server_enable_fanout: allocation failed");
+        return false;
+    }
+    if (!sc_fanout_init(channel->fanout, expiry_ns)) {
+        free(channel->fanout);
+        channel->fanout = NULL;
+        return false;
+    }
+    channel->conn.fanout = channel->fanout;
+    return true;
+}
+
+uint8_t sc_server_enable_pacing(server_t *server, int32_t index, pacing_mode mode, uint32_t datagrams_per_interval) {
+    if (server->running || index < 0 || (uint32_t) index >= server->channel_count || datagrams_per_interval == 0) {
+        LOG_WARN("sc_server_enable_pacing: invalid channel (%d) or server running", index);
+        return false;
+    }
+    server_channel *channel = &server->channels[index];
+    if (!channel->pacer) {
+        channel->pacer = malloc(sizeof(pacer_t));
+        if (!channel->pacer) {
+            LOG_ERROR("sc_server_enable_pacing: allocation failed");
+            return false;
+        }
+    }
+    sc_pacer_init(channel->pacer, channel->conn.socket_audio_fd, mode,
+        channel->interval_ns / datagrams_per_interval);
+    channel->conn.pacer = channel->pacer;
+    return true;
+}
+
+uint8_t sc_server_handle_request(server_t *server, const datagram_t *request, struct sockaddr_in *src) {
+    uint8_t kind = request->header.kind;
+    if (kind != CLIENT_SUBSCRIBE && kind != CLIENT_KEEPALIVE && kind != CLIENT_UNSUBSCRIBE) {
+        return false;
+    }
+    if (request->header.payload_len < sizeof(subscription)) {
+        LOG_WARN("sc_server_handle_request: malformed subscription request");
+        return false;
+    }
+    const subscription *sub = (const subscription *) request->payload.audio;
+    for (uint32_t i = 0; i < server->channel_count; i++) {
+        server_channel *channel = &server->channels[i];
+        if (channel->fanout && strncmp(channel->conn.group_addr, sub->group_addr, INET_ADDRSTRLEN) == 0) {
+            return sc_fanout_handle_request(channel->fanout, request, src, sc_time_now_ns());
+        }
+    }
+    LOG_WARN("Subscription for unknown or multicast-only group %.*s", INET_ADDRSTRLEN, sub->group_addr);
+    return false;
+}
+
+uint8_t _server_worker_start(server_t *server, uint32_t index) {
+    server_worker *worker = &server->workers[index];
+    if (!sc_event_loop_init(&worker->loop)) {
+        return false;
+    }
+    for (uint32_t i = index; i < server->channel_count; i += server->worker_count) {
+        server_channel *channel = &server->channels[i];
+        if (sc_event_loop_add_timer(&worker->loop, channel->interval_ns, _server_channel_tick, channel) < 0) {
+            sc_event_loop_close(&worker->loop);
+            return false;
+        }
+    }
+    if (index == 0 && sc_event_loop_add_fd(&worker->loop, server->control.socket_aux_fd,
+            _server_control_readable, server) < 0) {
+        sc_event_loop_close(&worker->loop);
+        return false;
+    }
+    int32_t ret = pthread_create(&worker->thread, NULL, _server_worker_main, worker);
+    if (ret != 0) {
+        LOG_ERROR("sc_server_start: pthread_create failed. Errno [%d] %s", ret, strerror(ret));
+        sc_event_loop_close(&worker->loop);
+        return false;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker->cpu, &cpus);
+    ret = pthread_setaffinity_np(worker->thread, sizeof(cpu_set_t), &cpus);
+    if (ret != 0) {
+        LOG_WARN("sc_server_start: failed to pin worker %d to core %d. Errno [%d] %s",
+            index, worker->cpu, ret, strerror(ret));
+    }
+    worker->started = true;
+    return true;
+}
+
+uint8_t sc_server_start(server_t *server) {
+    if (server->running) {
+        return true;
+    }
+    server->running = true;
+    for (uint32_t i = 0; i < server->worker_count; i++) {
+        if (!_server_worker_start(server, i)) {
+            sc_server_stop(server);
+            return false;
+        }
+    }
+    LOG_INFO("Server started: %d channels on %d workers", server->channel_count, server->worker_count);
+    return true;
+}
+
+void sc_server_stop(server_t *server) {
+    for (uint32_t i = 0; i < server->worker_count; i++) {
+        server_worker *worker = &server->workers[i];
+        if (!worker->started) {
+            continue;
+        }
+        sc_event_loop_stop(&worker->loop);
+        pthread_join(worker->thread, NULL);
+        sc_event_loop_close(&worker->loop);
+        worker->started = false;
+    }
+    server->running = false;
+}
+
+uint8_t sc_server_advertise(server_t *server) {
+    advertised_channel channels[SERVER_CHANNELS_MAX];
+    for (uint32_t i = 0; i < server->channel_count; i++) {
+        memcpy(channels[i].group_addr, server->channels[i].conn.group_addr, INET_ADDRSTRLEN);
+        channels[i].codec = server->channels[i].conn.codec;
+        channels[i].sample_rate = server->channels[i].conn.sample_rate;
+        channels[i].channels = server->channels[i].conn.channels;
+    }
+    return sc_network_advertise_channels(&server->control, channels, (uint8_t) server->channel_count);
+}
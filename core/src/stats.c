@@ -0,0 +1,170 @@
+#include "stats.h"
+
+#include "types.h"
+#include "logger.h"
+
+#define ADD(counter, value) __atomic_fetch_add(&(counter), (value), __ATOMIC_RELAXED)
+
+// Sequences tracked for duplicate detection behind the highest received
+#define TRACKING_WINDOW 64
+
+uint32_t _histogram_index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_COUNT) {
+        return (uint32_t) value;
+    }
+    if (value >> HISTOGRAM_MAX_MAGNITUDE) {
+        value = (1ULL << HISTOGRAM_MAX_MAGNITUDE) - 1;
+    }
+    uint32_t magnitude = 63 - __builtin_clzll(value);
+    uint32_t sub = (uint32_t) (value >> (magnitude - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_COUNT - 1);
+    return (magnitude - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT + sub;
+}
+
+// Smallest value counted in bucket `index`
+uint64_t _histogram_value(uint32_t index) {
+    if (index < HISTOGRAM_SUB_COUNT) {
+        return index;
+    }
+    uint32_t magnitude = index / HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_BITS - 1;
+    uint64_t sub = index % HISTOGRAM_SUB_COUNT;
+    return (HISTOGRAM_SUB_COUNT + sub) << (magnitude - HISTOGRAM_SUB_BITS);
+}
+
+void sc_histogram_record(histogram *h, uint64_t value_ns) {
+    ADD(h->counts[_histogram_index(value_ns)], 1);
+}
+
+uint64_t sc_histogram_count(const histogram *h) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        total += __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+uint64_t sc_histogram_percentile(const histogram *h, double percentile) {
+    uint64_t total = sc_histogram_count(h);
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (percentile / 100.0 * (double) total);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+        if (seen > rank) {
+            return _histogram_value(i);
+        }
+    }
+    return _histogram_value(HISTOGRAM_BUCKETS - 1);
+}
+
+void sc_stats_record_send(connection_stats *stats, uint32_t packets, uint64_t bytes) {
+    ADD(stats->packets_sent, packets);
+    ADD(stats->bytes_sent, bytes);
+}
+
+void sc_stats_record_error(connection_stats *stats, uint8_t send, int32_t err) {
+    if (send) {
+        ADD(stats->send_errors, 1);
+    } else {
+        ADD(stats->receive_errors, 1);
+    }
+    uint32_t slot = err >= 0 && err < STATS_ERRNO_MAX ? (uint32_t) err : STATS_ERRNO_MAX;
+    ADD(stats->errnos[slot], 1);
+}
+
+void sc_stats_record_receive(connection_stats *stats, uint8_t kind, uint32_t sequence,
+    uint64_t timestamp, uint32_t len, uint64_t arrival_ns) {
+    stats_tracking *t = &stats->tracking;
+
+    ADD(stats->packets_received, 1);
+    ADD(stats->bytes_received, len);
+    if (kind != SERVER_AUDIO) {
+        return;
+    }
+
+    int64_t offset = __atomic_load_n(&stats->clock_offset_ns, __ATOMIC_RELAXED);
+    int64_t delay = (int64_t) (arrival_ns + offset - timestamp);
+    sc_histogram_record(&stats->delay, delay > 0 ? (uint64_t) delay : 0);
+
+    if (!t->started) {
+        t->started = true;
+        t->highest_sequence = sequence;
+        t->window = 1;
+        t->span = 1;
+        t->last_arrival_ns = arrival_ns;
+        t->last_timestamp = timestamp;
+        return;
+    }
+    int32_t ahead = (int32_t) (sequence - t->highest_sequence);
+    if (ahead > 0) {
+        if (ahead > 1) {
+            ADD(stats->gaps, (uint64_t) (ahead - 1));
+        }
+        if (ahead < TRACKING_WINDOW) {
+            t->window = (t->window << ahead) | 1;
+            t->span += (uint32_t) ahead;
+            if (t->span > TRACKING_WINDOW) {
+                t->span = TRACKING_WINDOW;
+            }
+        } else {
+            // Every sequence the window covers behind the new highest was just counted a gap
+            t->window = 1;
+            t->span = TRACKING_WINDOW;
+        }
+        t->highest_sequence = sequence;
+
+        // RFC 3550 transit difference between consecutive in-order arrivals
+        int64_t arrival_gap = (int64_t) (arrival_ns - t->last_arrival_ns);
+        int64_t send_gap = (int64_t) (timestamp - t->last_timestamp);
+        int64_t d = arrival_gap - send_gap;
+        sc_histogram_record(&stats->jitter, (uint64_t) (d < 0 ? -d : d));
+        t->last_arrival_ns = arrival_ns;
+        t->last_timestamp = timestamp;
+        return;
+    }
+    uint32_t behind = (uint32_t) -ahead;
+    if (behind < t->span && (t->window >> behind) & 1) {
+        ADD(stats->duplicates, 1);
+        return;
+    }
+    if (behind < t->span) {
+        // Filled an earlier gap
+        t->window |= 1ULL << behind;
+        ADD(stats->gaps, (uint64_t) -1);
+    }
+    ADD(stats->reordered, 1);
+}
+
+void sc_stats_record_late(connection_stats *stats) {
+    ADD(stats->late, 1);
+}
+
+void sc_stats_set_clock_offset(connection_stats *stats, int64_t offset_ns) {
+    __atomic_store_n(&stats->clock_offset_ns, offset_ns, __ATOMIC_RELAXED);
+}
+
+void sc_stats_log(const char *name, const connection_stats *stats) {
+    LOG_INFO("%s: sent %llu pkts/%llu B, received %llu pkts/%llu B, invalid %llu, errors send %llu recv %llu",
+        name,
+        (unsigned long long) stats->packets_sent, (unsigned long long) stats->bytes_sent,
+        (unsigned long long) stats->packets_received, (unsigned long long) stats->bytes_received,
+        (unsigned long long) stats->invalid,
+        (unsigned long long) stats->send_errors, (unsigned long long) stats->receive_errors);
+    LOG_INFO("%s: gaps %llu, dup %llu, reordered %llu, late %llu, jitter p50/p99 %llu/%llu us, "
+        "delay p50/p99/p999 %llu/%llu/%llu us",
+        name,
+        (unsigned long long) stats->gaps, (unsigned long long) stats->duplicates,
+        (unsigned long long) stats->reordered, (unsigned long long) stats->late,
+        (unsigned long long) sc_histogram_percentile(&stats->jitter, 50) / 1000,
+        (unsigned long long) sc_histogram_percentile(&stats->jitter, 99) / 1000,
+        (unsigned long long) sc_histogram_percentile(&stats->delay, 50) / 1000,
+        (unsigned long long) sc_histogram_percentile(&stats->delay, 99) / 1000,
+        (unsigned long long) sc_histogram_percentile(&stats->delay, 99.9) / 1000);
+    for (uint32_t i = 0; i <= STATS_ERRNO_MAX; i++) {
+        if (stats->errnos[i]) {
+            LOG_INFO("%s: errno %d%s x %llu", name, i, i == STATS_ERRNO_MAX ? "+" : "",
+                (unsigned long long) stats->errnos[i]);
+        }
+    }
+}
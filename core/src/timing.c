@@ -0,0 +1,17 @@
+#define _GNU_SOURCE  // clock_gettime(...)
+
+#include "timing.h"
+
+#include <time.h>  // clock_gettime(...), CLOCK_MONOTONIC, CLOCK_REALTIME
+
+uint64_t sc_time_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * NS_PER_SEC + (uint64_t) now.tv_nsec;
+}
+
+uint64_t sc_time_wall_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t) now.tv_sec * NS_PER_SEC + (uint64_t) now.tv_nsec;
+}
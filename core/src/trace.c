@@ -0,0 +1,206 @@
+#define _GNU_SOURCE  // mremap(...), clock_nanosleep(...)
+
+#include "trace.h"
+
+#include "datagram.h"
+#include "timing.h"
+#include "logger.h"
+
+#include <string.h>    // memset(...), memcpy(...), memcmp(...)
+#include <fcntl.h>     // open(...)
+#include <unistd.h>    // ftruncate(...), close(...)
+#include <time.h>      // clock_nanosleep(...)
+#include <errno.h>
+#include <sys/mman.h>  // mmap(...), mremap(...), munmap(...)
+#include <sys/stat.h>  // fstat(...)
+
+// Initial file size; doubled whenever a record does not fit
+#define TRACE_INITIAL_BYTES (1 << 20)
+
+#define RECORD_SIZE(len) (sizeof(trace_record) + (((len) + 7) & ~7U))
+
+uint8_t sc_trace_recorder_open(trace_recorder_t *rec, const char *path) {
+    memset(rec, 0, sizeof(trace_recorder_t));
+    rec->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (rec->fd < 0) {
+        LOG_ERROR("sc_trace_recorder_open: cannot create %s. Errno [%d] %s", path, errno, strerror(errno));
+        return false;
+    }
+    rec->capacity = TRACE_INITIAL_BYTES;
+    if (ftruncate(rec->fd, (off_t) rec->capacity) < 0) {
+        LOG_ERROR("sc_trace_recorder_open: cannot size %s. Errno [%d] %s", path, errno, strerror(errno));
+        close(rec->fd);
+        return false;
+    }
+    rec->map = mmap(NULL, rec->capacity, PROT_READ | PROT_WRITE, MAP_SHARED, rec->fd, 0);
+    if (rec->map == MAP_FAILED) {
+        LOG_ERROR("sc_trace_recorder_open: cannot map %s. Errno [%d] %s", path, errno, strerror(errno));
+        close(rec->fd);
+        return false;
+    }
+    rec->header = (trace_file_header *) rec->map;
+    memcpy(rec->header->magic, TRACE_MAGIC, sizeof(rec->header->magic));
+    rec->header->version = TRACE_VERSION;
+    rec->header->records = 0;
+    rec->header->bytes = sizeof(trace_file_header);
+    pthread_mutex_init(&rec->lock, NULL);
+    return true;
+}
+
+// Grow the file and mapping to at least `needed` bytes. Called locked.
+// Returns true if successful, false otherwise.
+uint8_t _trace_grow(trace_recorder_t *rec, uint64_t needed) {
+    uint64_t capacity = rec->capacity;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    if (ftruncate(rec->fd, (off_t) capacity) < 0) {
+        LOG_ERROR("Trace file cannot grow. Errno [%d] %s", errno, strerror(errno));
+        return false;
+    }
+    void *map = mremap(rec->map, rec->capacity, capacity, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        LOG_ERROR("Trace mapping cannot grow. Errno [%d] %s", errno, strerror(errno));
+        return false;
+    }
+    rec->map = map;
+    rec->header = (trace_file_header *) rec->map;
+    rec->capacity = capacity;
+    return true;
+}
+
+uint8_t sc_trace_record(trace_recorder_t *rec, const void *wire, uint32_t len, uint64_t arrival_ns,
+    uint8_t aux) {
+    trace_record record;
+
+    if (len > sizeof(datagram_t)) {
+        return false;
+    }
+    memset(&record, 0, sizeof(trace_record));
+    record.arrival_ns = arrival_ns;
+    record.len = (uint16_t) len;
+    record.aux = aux;
+
+    pthread_mutex_lock(&rec->lock);
+    uint64_t offset = rec->header->bytes;
+    uint64_t end = offset + RECORD_SIZE(len);
+    if (end > rec->capacity && !_trace_grow(rec, end)) {
+        pthread_mutex_unlock(&rec->lock);
+        return false;
+    }
+    memcpy(rec->map + offset, &record, sizeof(trace_record));
+    memcpy(rec->map + offset + sizeof(trace_record), wire, len);
+    // Publish only the complete record
+    __atomic_store_n(&rec->header->bytes, end, __ATOMIC_RELEASE);
+    __atomic_store_n(&rec->header->records, rec->header->records + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&rec->lock);
+    return true;
+}
+
+void sc_trace_recorder_close(trace_recorder_t *rec) {
+    uint64_t used = rec->header->bytes;
+    munmap(rec->map, rec->capacity);
+    if (ftruncate(rec->fd, (off_t) used) < 0) {
+        LOG_WARN("Trace file not trimmed. Errno [%d] %s", errno, strerror(errno));
+    }
+    close(rec->fd);
+    pthread_mutex_destroy(&rec->lock);
+}
+
+uint8_t sc_trace_reader_open(trace_reader_t *reader, const char *path) {
+    struct stat st;
+
+    memset(reader, 0, sizeof(trace_reader_t));
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0) {
+        LOG_ERROR("sc_trace_reader_open: cannot open %s. Errno [%d] %s", path, errno, strerror(errno));
+        return false;
+    }
+    if (fstat(reader->fd, &st) < 0 || (uint64_t) st.st_size < sizeof(trace_file_header)) {
+        LOG_ERROR("sc_trace_reader_open: %s is not a trace", path);
+        close(reader->fd);
+        return false;
+    }
+    reader->mapped = (uint64_t) st.st_size;
+    reader->map = mmap(NULL, reader->mapped, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+    if (reader->map == MAP_FAILED) {
+        LOG_ERROR("sc_trace_reader_open: cannot map %s. Errno [%d] %s", path, errno, strerror(errno));
+        close(reader->fd);
+        return false;
+    }
+    const trace_file_header *header = (const trace_file_header *) reader->map;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 || header->version != TRACE_VERSION
+        || header->bytes > reader->mapped) {
+        LOG_ERROR("sc_trace_reader_open: %s is not a version %d trace", path, TRACE_VERSION);
+        sc_trace_reader_close(reader);
+        return false;
+    }
+    // Anything past the last complete record (e.g. preallocated space) is ignored
+    reader->size = header->bytes;
+    reader->records = header->records;
+    madvise((void *) reader->map, reader->size, MADV_SEQUENTIAL);
+    sc_trace_reader_rewind(reader);
+    return true;
+}
+
+void sc_trace_reader_close(trace_reader_t *reader) {
+    munmap((void *) reader->map, reader->mapped);
+    close(reader->fd);
+}
+
+void sc_trace_reader_rewind(trace_reader_t *reader) {
+    reader->offset = sizeof(trace_file_header);
+    reader->index = 0;
+}
+
+uint8_t sc_trace_next(trace_reader_t *reader, datagram_t *dest, uint32_t *len, uint64_t *arrival_ns,
+    uint8_t *aux) {
+    trace_record record;
+
+    if (reader->index == reader->records || reader->offset + sizeof(trace_record) > reader->size) {
+        return false;
+    }
+    memcpy(&record, reader->map + reader->offset, sizeof(trace_record));
+    if (record.len > sizeof(datagram_t) || reader->offset + RECORD_SIZE(record.len) > reader->size) {
+        LOG_WARN("Trace record %llu is corrupt", (unsigned long long) reader->index);
+        return false;
+    }
+    memcpy(dest, reader->map + reader->offset + sizeof(trace_record), record.len);
+    *len = record.len;
+    *arrival_ns = record.arrival_ns;
+    *aux = record.aux;
+    reader->offset += RECORD_SIZE(record.len);
+    reader->index++;
+    return true;
+}
+
+uint64_t sc_trace_replay(trace_reader_t *reader, uint8_t realtime, trace_replay_fn fn, void *ctx) {
+    datagram_t dgram;
+    uint32_t len;
+    uint64_t arrival_ns;
+    uint8_t aux;
+    uint64_t first_ns = 0;
+    uint64_t start_ns = sc_time_now_ns();
+    uint64_t delivered = 0;
+
+    while (sc_trace_next(reader, &dgram, &len, &arrival_ns, &aux)) {
+        if (realtime) {
+            if (first_ns == 0) {
+                first_ns = arrival_ns;
+            }
+            arrival_ns = start_ns + (arrival_ns - first_ns);
+            struct timespec due = {
+                .tv_sec = (time_t) (arrival_ns / NS_PER_SEC),
+                .tv_nsec = (long) (arrival_ns % NS_PER_SEC)
+            };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {
+            }
+        }
+        if (!sc_datagram_decode(&dgram, len)) {
+            continue;
+        }
+        fn(ctx, &dgram, len, arrival_ns, aux);
+        delivered++;
+    }
+    return delivered;
+}
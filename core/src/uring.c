@@ -0,0 +1,419 @@
+#define _GNU_SOURCE  // syscall(...)
+
+#include "uring.h"
+
+#include "datagram.h"
+#include "low_latency.h"
+#include "timing.h"
+#include "logger.h"
+
+#include <stdlib.h>         // malloc(...), free(...)
+#include <string.h>         // memset(...), memcpy(...)
+#include <unistd.h>         // syscall(...), close(...)
+#include <errno.h>
+#include <sys/mman.h>       // mmap(...), munmap(...)
+#include <sys/syscall.h>    // __NR_io_uring_*
+#include <linux/io_uring.h>
+
+#define BUFFER_GROUP 0
+#define BUFFER_MASK (URING_RECV_BUFFERS - 1)
+
+// A receive buffer holds the recvmsg header the kernel writes, the source address, the
+// arrival timestamp (if enabled), then the datagram
+#define RECV_BUFFER_SIZE (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) \
+    + ARRIVAL_CONTROL_SIZE + sizeof(datagram_t))
+
+// user_data of each operation: kind in the upper half, send slot in the lower
+#define TAG_RECV   (1ULL << 32)
+#define TAG_SEND   (2ULL << 32)
+#define TAG_CANCEL (3ULL << 32)
+#define TAG_KIND(user_data) ((user_data) & ~0xFFFFFFFFULL)
+
+// How long an idle SQPOLL thread spins before sleeping
+#define SQPOLL_IDLE_MS 1000
+
+// Waits for completions when closing, each bounded by CLOSE_WAIT_NS, before giving up on
+// outstanding operations
+#define CLOSE_WAITS_MAX 16
+#define CLOSE_WAIT_NS (10 * 1000 * 1000ULL)
+
+int32_t _uring_enter(uring_t *ring, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    ring->stats.submits++;
+    return (int32_t) syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+// Submit queued SQEs. With SQPOLL the kernel thread picks them up by itself unless it
+// has gone idle.
+void _uring_flush(uring_t *ring) {
+    if (ring->sq_pending == 0) {
+        return;
+    }
+    if (ring->sqpoll) {
+        // The tail store must be visible before the flags are read (see io_uring_enter(2))
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+            _uring_enter(ring, 0, 0, IORING_ENTER_SQ_WAKEUP);
+        }
+        ring->sq_pending = 0;
+        return;
+    }
+    int32_t submitted = _uring_enter(ring, ring->sq_pending, 0, 0);
+    if (submitted < 0) {
+        // Left queued for the next flush
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            LOG_ERROR("io_uring submit failed. Errno [%d] %s", errno, strerror(errno));
+        }
+        return;
+    }
+    ring->sq_pending -= (uint32_t) submitted < ring->sq_pending ? (uint32_t) submitted : ring->sq_pending;
+}
+
+// Next free SQE, zeroed, or NULL if the submission queue is full even after a flush.
+// Becomes visible to the kernel with _uring_commit.
+struct io_uring_sqe *_uring_sqe(uring_t *ring) {
+    uint32_t tail = *ring->sq_tail;
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == URING_ENTRIES) {
+        _uring_flush(ring);
+        if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == URING_ENTRIES) {
+            return NULL;
+        }
+    }
+    uint32_t index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *) ring->sqes)[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+void _uring_commit(uring_t *ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ring->sq_pending++;
+}
+
+// Queue a multishot receive selecting buffers from the provided-buffer ring.
+void _uring_arm(uring_t *ring) {
+    struct io_uring_sqe *sqe = _uring_sqe(ring);
+    if (!sqe) {
+        return;  // Retried by the next receive
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = ring->socket_fd;
+    sqe->addr = (uint64_t) (uintptr_t) &ring->recv_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = TAG_RECV;
+    _uring_commit(ring);
+    ring->armed = true;
+}
+
+// Hand buffer `bid` back to the kernel.
+void _uring_recycle(uring_t *ring, uint16_t bid) {
+    struct io_uring_buf_ring *buf_ring = (struct io_uring_buf_ring *) ring->buf_ring;
+    struct io_uring_buf *buf = &buf_ring->bufs[ring->buf_tail & BUFFER_MASK];
+    buf->addr = (uint64_t) (uintptr_t) (ring->buffers + (size_t) bid * RECV_BUFFER_SIZE);
+    buf->len = RECV_BUFFER_SIZE;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n(&buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+// Consume every completion: received buffers join the ready queue, finished sends free
+// their slots.
+void _uring_reap(uring_t *ring) {
+    struct io_uring_cqe *cqes = (struct io_uring_cqe *) ring->cqes;
+    uint32_t head = *ring->cq_head;
+    uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &cqes[head & *ring->cq_mask];
+        uint64_t kind = TAG_KIND(cqe->user_data);
+        if (kind == TAG_SEND) {
+            ring->free_slots[ring->free_count++] = (uint32_t) cqe->user_data;
+            if (cqe->res < 0) {
+                LOG_ERROR("io_uring send failed. Errno [%d] %s", -cqe->res, strerror(-cqe->res));
+                sc_stats_record_error(ring->conn_stats, true, -cqe->res);
+            } else {
+                ring->stats.sent++;
+            }
+            continue;
+        }
+        if (kind != TAG_RECV) {
+            continue;
+        }
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            ring->armed = false;
+        }
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            ring->ready_bids[ring->ready_tail++ & BUFFER_MASK] = (uint16_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        } else if (cqe->res == -ENOBUFS) {
+            ring->stats.starved++;
+        } else if (cqe->res < 0 && cqe->res != -ECANCELED) {
+            LOG_ERROR("io_uring receive failed. Errno [%d] %s", -cqe->res, strerror(-cqe->res));
+            sc_stats_record_error(ring->conn_stats, false, -cqe->res);
+        }
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+// Block until at least one completion arrives or `timeout_ns` passes (URING_WAIT_FOREVER
+// for no limit). Called locked; the lock is released while waiting so other threads can
+// queue sends.
+// Returns false if the wait timed out, true otherwise.
+uint8_t _uring_wait(uring_t *ring, uint64_t timeout_ns) {
+    struct __kernel_timespec ts = { (int64_t) (timeout_ns / NS_PER_SEC), (long long) (timeout_ns % NS_PER_SEC) };
+    struct io_uring_getevents_arg arg;
+    uint32_t flags = IORING_ENTER_GETEVENTS;
+    void *argp = NULL;
+    size_t argsz = 0;
+
+    if (timeout_ns != URING_WAIT_FOREVER) {
+        memset(&arg, 0, sizeof(struct io_uring_getevents_arg));
+        arg.ts = (uint64_t) (uintptr_t) &ts;
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(struct io_uring_getevents_arg);
+    }
+    _uring_flush(ring);
+    pthread_mutex_unlock(&ring->lock);
+    int32_t ret = (int32_t) syscall(__NR_io_uring_enter, ring->ring_fd, 0, 1, flags, argp, argsz);
+    int32_t wait_errno = errno;
+    pthread_mutex_lock(&ring->lock);
+    ring->stats.submits++;
+    if (ret < 0 && wait_errno != EINTR && wait_errno != ETIME) {
+        LOG_ERROR("io_uring wait failed. Errno [%d] %s", wait_errno, strerror(wait_errno));
+    }
+    _uring_reap(ring);
+    return ret >= 0 || wait_errno != ETIME;
+}
+
+uint8_t sc_uring_init(uring_t *ring, int32_t socket_fd, uint8_t sqpoll, connection_stats *conn_stats) {
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(uring_t));
+    pthread_mutex_init(&ring->lock, NULL);
+    ring->socket_fd = socket_fd;
+    ring->sqpoll = sqpoll;
+    ring->conn_stats = conn_stats;
+
+    memset(&params, 0, sizeof(struct io_uring_params));
+    params.flags = IORING_SETUP_SUBMIT_ALL;
+    if (sqpoll) {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = SQPOLL_IDLE_MS;
+    }
+    ring->ring_fd = (int32_t) syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (ring->ring_fd < 0) {
+        LOG_WARN("io_uring unavailable. Errno [%d] %s", errno, strerror(errno));
+        pthread_mutex_destroy(&ring->lock);
+        return false;
+    }
+
+    // Map the rings (one mapping serves both when the kernel supports it)
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = 0;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring->ring_fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = ring->cq_ring_size == 0 ? ring->sq_ring
+        : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring->ring_fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, URING_ENTRIES * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    ring->buf_ring = mmap(NULL, URING_RECV_BUFFERS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ring->buffers = malloc(URING_RECV_BUFFERS * RECV_BUFFER_SIZE);
+    ring->slots = malloc(URING_SEND_SLOTS * sizeof(uring_send_slot));
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED
+        || ring->buf_ring == MAP_FAILED || !ring->buffers || !ring->slots) {
+        LOG_ERROR("sc_uring_init: failed to map rings. Errno [%d] %s", errno, strerror(errno));
+        sc_uring_close(ring);
+        return false;
+    }
+    uint8_t *sq = (uint8_t *) ring->sq_ring;
+    uint8_t *cq = (uint8_t *) ring->cq_ring;
+    ring->sq_head = (uint32_t *) (sq + params.sq_off.head);
+    ring->sq_tail = (uint32_t *) (sq + params.sq_off.tail);
+    ring->sq_mask = (uint32_t *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t *) (sq + params.sq_off.array);
+    ring->sq_flags = (uint32_t *) (sq + params.sq_off.flags);
+    ring->cq_head = (uint32_t *) (cq + params.cq_off.head);
+    ring->cq_tail = (uint32_t *) (cq + params.cq_off.tail);
+    ring->cq_mask = (uint32_t *) (cq + params.cq_off.ring_mask);
+    ring->cqes = cq + params.cq_off.cqes;
+    for (uint32_t i = 0; i < URING_SEND_SLOTS; i++) {
+        ring->free_slots[i] = URING_SEND_SLOTS - 1 - i;
+    }
+    ring->free_count = URING_SEND_SLOTS;
+
+    // Register the provided-buffer ring and fill it
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(struct io_uring_buf_reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) ring->buf_ring;
+    reg.ring_entries = URING_RECV_BUFFERS;
+    reg.bgid = BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        LOG_WARN("io_uring provided buffers unavailable. Errno [%d] %s", errno, strerror(errno));
+        sc_uring_close(ring);
+        return false;
+    }
+    for (uint16_t bid = 0; bid < URING_RECV_BUFFERS; bid++) {
+        _uring_recycle(ring, bid);
+    }
+
+    ring->recv_msg.msg_namelen = sizeof(struct sockaddr_in);
+    ring->recv_msg.msg_controllen = ARRIVAL_CONTROL_SIZE;
+    _uring_arm(ring);
+    _uring_flush(ring);
+    return true;
+}
+
+void sc_uring_close(uring_t *ring) {
+    if (ring->ring_fd < 0) {
+        return;
+    }
+    uint8_t idle = true;
+    if (ring->sq_head) {
+        // The kernel may still write into receive buffers or read send slots: cancel the
+        // receive and let in-flight sends finish before freeing them
+        pthread_mutex_lock(&ring->lock);
+        struct io_uring_sqe *sqe = ring->armed ? _uring_sqe(ring) : NULL;
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = TAG_RECV;
+            sqe->user_data = TAG_CANCEL;
+            _uring_commit(ring);
+        }
+        _uring_reap(ring);
+        for (uint32_t i = 0; i < CLOSE_WAITS_MAX && (ring->armed || ring->free_count < URING_SEND_SLOTS); i++) {
+            _uring_wait(ring, CLOSE_WAIT_NS);
+        }
+        idle = !ring->armed && ring->free_count == URING_SEND_SLOTS;
+        pthread_mutex_unlock(&ring->lock);
+    }
+    close(ring->ring_fd);
+    ring->ring_fd = -1;
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->cq_ring_size != 0 && ring->cq_ring && ring->cq_ring != MAP_FAILED) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sqes && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, URING_ENTRIES * sizeof(struct io_uring_sqe));
+    }
+    if (!idle) {
+        // Still owned by operations that never completed: leaking them is safer than
+        // letting the kernel write into freed memory
+        LOG_WARN("sc_uring_close: operations still in flight, leaking their buffers");
+        pthread_mutex_destroy(&ring->lock);
+        return;
+    }
+    if (ring->buf_ring && ring->buf_ring != MAP_FAILED) {
+        munmap(ring->buf_ring, URING_RECV_BUFFERS * sizeof(struct io_uring_buf));
+    }
+    free(ring->buffers);
+    free(ring->slots);
+    pthread_mutex_destroy(&ring->lock);
+}
+
+uint8_t sc_uring_queue_send(uring_t *ring, const datagram_t *dgram, uint32_t len,
+    const struct sockaddr_in *addr) {
+    uint32_t payload_len = len - sizeof(datagram_header);
+
+    pthread_mutex_lock(&ring->lock);
+    if (ring->free_count == 0) {
+        _uring_reap(ring);
+    }
+    while (ring->free_count == 0) {
+        _uring_wait(ring, URING_WAIT_FOREVER);
+    }
+    struct io_uring_sqe *sqe = _uring_sqe(ring);
+    if (!sqe) {
+        pthread_mutex_unlock(&ring->lock);
+        LOG_WARN("sc_uring_queue_send: submission queue full");
+        return false;
+    }
+    uint32_t index = ring->free_slots[--ring->free_count];
+    uring_send_slot *slot = &ring->slots[index];
+    sc_datagram_header_encode(&dgram->header, payload_len, (datagram_header *) slot->data);
+    memcpy(slot->data + sizeof(datagram_header), &dgram->payload, payload_len);
+    slot->addr = *addr;
+    slot->iov.iov_base = slot->data;
+    slot->iov.iov_len = len;
+    memset(&slot->msg, 0, sizeof(struct msghdr));
+    slot->msg.msg_name = &slot->addr;
+    slot->msg.msg_namelen = sizeof(struct sockaddr_in);
+    slot->msg.msg_iov = &slot->iov;
+    slot->msg.msg_iovlen = 1;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = ring->socket_fd;
+    sqe->addr = (uint64_t) (uintptr_t) &slot->msg;
+    sqe->len = 1;
+    sqe->user_data = TAG_SEND | index;
+    _uring_commit(ring);
+    pthread_mutex_unlock(&ring->lock);
+    return true;
+}
+
+void sc_uring_submit(uring_t *ring) {
+    pthread_mutex_lock(&ring->lock);
+    _uring_flush(ring);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+int32_t sc_uring_receive(uring_t *ring, datagram_t *dest, struct sockaddr_in *src, uint64_t *arrival_ns,
+    uint64_t timeout_ns) {
+    uint64_t deadline_ns = timeout_ns == URING_WAIT_FOREVER || timeout_ns == 0 ? 0 : sc_time_now_ns() + timeout_ns;
+
+    pthread_mutex_lock(&ring->lock);
+    _uring_reap(ring);
+    while (ring->ready_head == ring->ready_tail) {
+        if (!ring->armed) {
+            _uring_arm(ring);
+            ring->stats.rearms++;
+        }
+        // Send completions also end a wait, so the remaining time is recomputed each time
+        uint64_t now_ns = deadline_ns == 0 ? 0 : sc_time_now_ns();
+        if (timeout_ns == 0 || (deadline_ns != 0 && now_ns >= deadline_ns)) {
+            _uring_flush(ring);
+            pthread_mutex_unlock(&ring->lock);
+            return -1;
+        }
+        _uring_wait(ring, deadline_ns == 0 ? URING_WAIT_FOREVER : deadline_ns - now_ns);
+    }
+
+    uint16_t bid = ring->ready_bids[ring->ready_head++ & BUFFER_MASK];
+    uint8_t *buffer = ring->buffers + (size_t) bid * RECV_BUFFER_SIZE;
+    struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *) buffer;
+    int32_t len = 0;
+    uint8_t *name = buffer + sizeof(struct io_uring_recvmsg_out);
+    uint8_t *control = name + ring->recv_msg.msg_namelen;
+    if (!(out->flags & MSG_TRUNC) && out->payloadlen <= sizeof(datagram_t)) {
+        struct msghdr arrival_msg;
+        memset(&arrival_msg, 0, sizeof(struct msghdr));
+        arrival_msg.msg_control = control;
+        arrival_msg.msg_controllen = out->controllen;
+        *arrival_ns = sc_low_latency_arrival_ns(&arrival_msg);
+        memcpy(src, name, sizeof(struct sockaddr_in));
+        memcpy(dest, control + ring->recv_msg.msg_controllen, out->payloadlen);
+        len = (int32_t) out->payloadlen;
+        ring->stats.received++;
+    }
+    _uring_recycle(ring, bid);
+    if (!ring->armed) {
+        // Ended for lack of buffers: one is free again
+        _uring_arm(ring);
+        ring->stats.rearms++;
+        _uring_flush(ring);
+    }
+    pthread_mutex_unlock(&ring->lock);
+    return len;
+}